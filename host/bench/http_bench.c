@@ -0,0 +1,842 @@
+// Load and latency benchmark for http_server.c. The server runs in-process on the host
+// build with a live TelemetryState; client threads hit it over loopback and the result is
+// printed as one JSON object.
+
+#define _GNU_SOURCE // memmem, mallinfo2
+
+#include <switch.h>
+
+#include "host_sim.h"
+#include "http_server.h"
+#include "telemetry.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <malloc.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DEFAULT_PORT 16030
+#define BENCH_MAX_CLIENTS 256
+#define BENCH_RESPONSE_MAX 8192
+#define BENCH_IO_TIMEOUT_SEC 5
+#define BENCH_SLOW_CONNECT_US 900000ULL // a dropped SYN costs a ~1 s retransmit
+#define BENCH_HEAP_SAMPLE_US 5000
+#define BENCH_APP_PROGRAM_ID 0x0100000000010000ULL
+
+// Log-linear latency histogram in microseconds: exact below 128 us, then 64 buckets per
+// power of two (~1.5 % resolution). Fixed size, so recording never allocates.
+#define LAT_LINEAR 128
+#define LAT_SUB_BITS 6
+#define LAT_BUCKETS (LAT_LINEAR + (64 - 7) * (1 << LAT_SUB_BITS))
+
+typedef enum {
+    BenchKind_State = 0,
+    BenchKind_StateBin,
+    BenchKind_StateDelta,
+    BenchKind_Debug,
+    BenchKind_NotFound,
+    BenchKind_Count,
+} BenchKind;
+
+typedef enum {
+    BenchMode_KeepAlive = 0,
+    BenchMode_Close,
+    BenchMode_Burst,
+} BenchMode;
+
+typedef struct {
+    u64 counts[LAT_BUCKETS];
+    u64 total;
+    u64 sum_us;
+    u64 max_us;
+} LatencyHistogram;
+
+typedef struct {
+    u32 index;
+    u64 rng;
+    pthread_t thread;
+    LatencyHistogram latency;
+    u64 requests[BenchKind_Count];
+    u64 connects;
+    u64 connect_errors;
+    u64 slow_connects;
+    u64 rejected_503;
+    u64 bad_status;
+    u64 io_errors;
+    u64 timeouts;
+    u64 server_closes;
+    u64 bytes_in;
+} BenchClient;
+
+typedef struct {
+    pthread_t thread;
+    u64 connects;
+    u64 evictions;
+} BenchSlowClient;
+
+static const char* const k_kind_names[BenchKind_Count] = { "state", "bin", "delta", "debug", "404" };
+static const char* const k_kind_paths[BenchKind_Count] = {
+    "/state", "/state.bin", "/state?since=1", "/debug", "/missing",
+};
+static const char* const k_mode_names[] = { "keepalive", "close", "burst" };
+
+static struct {
+    unsigned short port;
+    u32 clients;
+    u32 slow_clients;
+    u32 duration_ms;
+    u32 warmup_ms;
+    u32 burst_interval_ms;
+    u32 slow_interval_ms;
+    u32 update_interval_ms;
+    BenchMode mode;
+    u32 mix[BenchKind_Count];
+    u32 mix_total;
+    const char* label;
+} g_opt;
+
+static HttpServer g_server;
+static TelemetryState g_telemetry;
+static BenchClient* g_clients;
+static BenchSlowClient g_slow[BENCH_MAX_CLIENTS];
+static pthread_barrier_t g_burst_barrier;
+static volatile bool g_measuring;
+static volatile bool g_stop;
+static volatile size_t g_heap_peak;
+
+static u64 now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000ULL + (u64)ts.tv_nsec / 1000ULL;
+}
+
+static void sleep_us(u64 us) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(us / 1000000ULL);
+    ts.tv_nsec = (long)(us % 1000000ULL) * 1000L;
+    nanosleep(&ts, NULL);
+}
+
+static u32 lat_bucket(u64 us) {
+    u32 exp;
+
+    if (us < LAT_LINEAR) {
+        return (u32)us;
+    }
+    exp = 63 - (u32)__builtin_clzll(us);
+    return LAT_LINEAR + (exp - 7) * (1u << LAT_SUB_BITS) +
+        (u32)((us >> (exp - LAT_SUB_BITS)) & ((1u << LAT_SUB_BITS) - 1));
+}
+
+// Upper edge of a bucket, so reported percentiles never understate.
+static u64 lat_bucket_value(u32 bucket) {
+    u32 exp;
+    u64 sub;
+
+    if (bucket < LAT_LINEAR) {
+        return bucket;
+    }
+    exp = 7 + (bucket - LAT_LINEAR) / (1u << LAT_SUB_BITS);
+    sub = (bucket - LAT_LINEAR) % (1u << LAT_SUB_BITS);
+    return ((1ULL << exp) | ((sub + 1) << (exp - LAT_SUB_BITS))) - 1;
+}
+
+static void lat_record(LatencyHistogram* h, u64 us) {
+    h->counts[lat_bucket(us)]++;
+    h->total++;
+    h->sum_us += us;
+    if (us > h->max_us) {
+        h->max_us = us;
+    }
+}
+
+static void lat_merge(LatencyHistogram* into, const LatencyHistogram* from) {
+    u32 i;
+
+    for (i = 0; i < LAT_BUCKETS; i++) {
+        into->counts[i] += from->counts[i];
+    }
+    into->total += from->total;
+    into->sum_us += from->sum_us;
+    if (from->max_us > into->max_us) {
+        into->max_us = from->max_us;
+    }
+}
+
+static u64 lat_percentile(const LatencyHistogram* h, double p) {
+    const u64 rank = (u64)(p * (double)h->total + 0.5);
+    u64 seen = 0;
+    u32 i;
+
+    if (h->total == 0) {
+        return 0;
+    }
+    for (i = 0; i < LAT_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank && seen > 0) {
+            const u64 value = lat_bucket_value(i);
+            return value < h->max_us ? value : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+static u64 xorshift64(u64* state) {
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static BenchKind pick_kind(BenchClient* client) {
+    u32 roll = (u32)(xorshift64(&client->rng) % g_opt.mix_total);
+    u32 i;
+
+    for (i = 0; i < BenchKind_Count; i++) {
+        if (roll < g_opt.mix[i]) {
+            return (BenchKind)i;
+        }
+        roll -= g_opt.mix[i];
+    }
+    return BenchKind_State;
+}
+
+static int bench_connect(u64* connect_us) {
+    struct sockaddr_in addr;
+    struct timeval tv;
+    const u64 start = now_us();
+    int one = 1;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    tv.tv_sec = BENCH_IO_TIMEOUT_SEC;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(g_opt.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    *connect_us = now_us() - start;
+    return fd;
+}
+
+static const char* find_header_value(const char* head, size_t head_len, const char* name) {
+    const size_t name_len = strlen(name);
+    const char* p = head;
+    const char* end = head + head_len;
+
+    while (p < end) {
+        const char* line_end = memchr(p, '\n', (size_t)(end - p));
+        if (!line_end) {
+            break;
+        }
+        if ((size_t)(line_end - p) > name_len + 1 && strncasecmp(p, name, name_len) == 0 && p[name_len] == ':') {
+            p += name_len + 1;
+            while (*p == ' ') {
+                p++;
+            }
+            return p;
+        }
+        p = line_end + 1;
+    }
+    return NULL;
+}
+
+typedef enum {
+    BenchResult_Ok = 0,
+    BenchResult_IoError,
+    BenchResult_Timeout,
+} BenchResult;
+
+// Reads one response. Sets *status and *server_close; the connection is only reusable when
+// the result is Ok and the server did not ask to close.
+static BenchResult read_response(int fd, int* status, bool* server_close, u64* bytes) {
+    static __thread char buf[BENCH_RESPONSE_MAX];
+    size_t used = 0;
+    size_t head_len = 0;
+    size_t body_len = 0;
+    bool have_head = false;
+
+    *status = 0;
+    *server_close = false;
+    while (1) {
+        ssize_t got;
+
+        if (have_head && used >= head_len + body_len) {
+            *bytes += used;
+            return BenchResult_Ok;
+        }
+        if (used == sizeof(buf)) {
+            return BenchResult_IoError;
+        }
+        got = recv(fd, buf + used, sizeof(buf) - used, 0);
+        if (got < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? BenchResult_Timeout : BenchResult_IoError;
+        }
+        if (got == 0) {
+            // A Content-Length-less response ends at EOF.
+            if (have_head) {
+                *bytes += used;
+                *server_close = true;
+                return BenchResult_Ok;
+            }
+            return BenchResult_IoError;
+        }
+        used += (size_t)got;
+
+        if (!have_head) {
+            const char* head_end;
+            const char* value;
+
+            head_end = memmem(buf, used, "\r\n\r\n", 4);
+            if (!head_end) {
+                continue;
+            }
+            have_head = true;
+            head_len = (size_t)(head_end - buf) + 4;
+            *status = (int)strtol(buf + 9, NULL, 10);
+            value = find_header_value(buf, head_len, "Content-Length");
+            body_len = value ? strtoul(value, NULL, 10) : (size_t)-1 / 2;
+            value = find_header_value(buf, head_len, "Connection");
+            *server_close = value && strncasecmp(value, "close", 5) == 0;
+        }
+    }
+}
+
+static bool client_request(BenchClient* client, int* fd, bool close_after) {
+    char request[192];
+    const BenchKind kind = pick_kind(client);
+    const int expected = kind == BenchKind_NotFound ? 404 : 200;
+    u64 start;
+    u64 connect_us = 0;
+    int req_len;
+    int status;
+    bool server_close;
+    BenchResult result;
+
+    start = now_us();
+    if (*fd < 0) {
+        *fd = bench_connect(&connect_us);
+        if (*fd < 0) {
+            if (g_measuring) client->connect_errors++;
+            return false;
+        }
+        if (g_measuring) {
+            client->connects++;
+            if (connect_us >= BENCH_SLOW_CONNECT_US) client->slow_connects++;
+        }
+    }
+
+    req_len = snprintf(
+        request,
+        sizeof(request),
+        "GET %s HTTP/1.1\r\nHost: bench\r\nUser-Agent: http_bench\r\n%s\r\n",
+        k_kind_paths[kind],
+        close_after ? "Connection: close\r\n" : ""
+    );
+    if (send(*fd, request, (size_t)req_len, MSG_NOSIGNAL) != req_len) {
+        close(*fd);
+        *fd = -1;
+        if (g_measuring) client->io_errors++;
+        return false;
+    }
+
+    result = read_response(*fd, &status, &server_close, &client->bytes_in);
+    if (result != BenchResult_Ok || server_close || close_after) {
+        close(*fd);
+        *fd = -1;
+    }
+    if (!g_measuring) {
+        return result == BenchResult_Ok;
+    }
+
+    if (result == BenchResult_Timeout) {
+        client->timeouts++;
+        return false;
+    }
+    if (result != BenchResult_Ok) {
+        client->io_errors++;
+        return false;
+    }
+    if (server_close && !close_after) {
+        client->server_closes++;
+    }
+    if (status == 503) {
+        client->rejected_503++;
+        return false;
+    }
+    if (status != expected) {
+        client->bad_status++;
+        return false;
+    }
+
+    client->requests[kind]++;
+    lat_record(&client->latency, now_us() - start);
+    return true;
+}
+
+static void* client_thread(void* arg) {
+    BenchClient* client = (BenchClient*)arg;
+    int fd = -1;
+
+    while (!g_stop) {
+        if (g_opt.mode == BenchMode_Burst) {
+            // Every client reconnects at once, as after a Wi-Fi drop.
+            pthread_barrier_wait(&g_burst_barrier);
+            if (g_stop) {
+                break;
+            }
+            client_request(client, &fd, true);
+            pthread_barrier_wait(&g_burst_barrier);
+            if (client->index == 0) {
+                sleep_us((u64)g_opt.burst_interval_ms * 1000ULL);
+            }
+        } else if (!client_request(client, &fd, g_opt.mode == BenchMode_Close)) {
+            sleep_us(1000);
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+// Holds a slot with a request that never completes, one header byte at a time.
+static void* slow_client_thread(void* arg) {
+    BenchSlowClient* slow = (BenchSlowClient*)arg;
+    static const char prefix[] = "GET /state HTTP/1.1\r\nX-Slow: ";
+    char probe[256];
+    u64 connect_us;
+    int fd = -1;
+
+    while (!g_stop) {
+        if (fd < 0) {
+            fd = bench_connect(&connect_us);
+            if (fd < 0) {
+                sleep_us(100000);
+                continue;
+            }
+            slow->connects++;
+            if (send(fd, prefix, sizeof(prefix) - 1, MSG_NOSIGNAL) < 0) {
+                close(fd);
+                fd = -1;
+                continue;
+            }
+        }
+        sleep_us((u64)g_opt.slow_interval_ms * 1000ULL);
+        // The server closing on us (a timeout or a 408) shows up as EOF or a reset.
+        if (recv(fd, probe, sizeof(probe), MSG_DONTWAIT) >= 0 ||
+            (errno != EAGAIN && errno != EWOULDBLOCK) ||
+            send(fd, "a", 1, MSG_NOSIGNAL) != 1) {
+            slow->evictions++;
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+// Keeps /state changing the way the main loop does: battery drains, the title flips.
+static void* telemetry_thread(void* arg) {
+    u32 tick = 0;
+
+    (void)arg;
+    while (!g_stop) {
+        host_world_lock();
+        g_host_world.battery_percent = 100 - (tick % 50);
+        host_world_unlock();
+        telemetry_request_query(&g_telemetry);
+        telemetry_update(&g_telemetry, true, true, true);
+        tick++;
+        sleep_us((u64)g_opt.update_interval_ms * 1000ULL);
+    }
+    return NULL;
+}
+
+static size_t heap_in_use(void) {
+    const struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+static void* heap_thread(void* arg) {
+    (void)arg;
+    while (!g_stop) {
+        const size_t used = heap_in_use();
+        if (used > g_heap_peak) {
+            g_heap_peak = used;
+        }
+        sleep_us(BENCH_HEAP_SAMPLE_US);
+    }
+    return NULL;
+}
+
+// Kernel-wide TcpExt counters; other traffic on the machine adds noise.
+static bool read_listen_overflows(u64* overflows, u64* drops) {
+    char names[4096];
+    char values[4096];
+    FILE* f = fopen("/proc/net/netstat", "r");
+    bool found = false;
+
+    if (!f) {
+        return false;
+    }
+    while (fgets(names, sizeof(names), f) && fgets(values, sizeof(values), f)) {
+        char* name_save = NULL;
+        char* value_save = NULL;
+        char* name;
+        char* value;
+
+        if (strncmp(names, "TcpExt:", 7) != 0) {
+            continue;
+        }
+        name = strtok_r(names, " \n", &name_save);
+        value = strtok_r(values, " \n", &value_save);
+        while (name && value) {
+            if (strcmp(name, "ListenOverflows") == 0) {
+                *overflows = strtoull(value, NULL, 10);
+                found = true;
+            } else if (strcmp(name, "ListenDrops") == 0) {
+                *drops = strtoull(value, NULL, 10);
+            }
+            name = strtok_r(NULL, " \n", &name_save);
+            value = strtok_r(NULL, " \n", &value_save);
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+static bool parse_mix(const char* text) {
+    char copy[128];
+    char* save = NULL;
+    char* item;
+    u32 i;
+
+    memset(g_opt.mix, 0, sizeof(g_opt.mix));
+    snprintf(copy, sizeof(copy), "%s", text);
+    for (item = strtok_r(copy, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char* eq = strchr(item, '=');
+        bool known = false;
+
+        if (!eq) {
+            return false;
+        }
+        *eq = '\0';
+        for (i = 0; i < BenchKind_Count; i++) {
+            if (strcmp(item, k_kind_names[i]) == 0) {
+                g_opt.mix[i] = (u32)strtoul(eq + 1, NULL, 10);
+                known = true;
+            }
+        }
+        if (!known) {
+            return false;
+        }
+    }
+
+    g_opt.mix_total = 0;
+    for (i = 0; i < BenchKind_Count; i++) {
+        g_opt.mix_total += g_opt.mix[i];
+    }
+    return g_opt.mix_total > 0;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --clients N          concurrent request loops (default 4, max %d)\n"
+        "  --mode M             keepalive | close | burst (default keepalive)\n"
+        "  --mix LIST           request weights, e.g. state=80,bin=10,delta=0,debug=5,404=5\n"
+        "  --duration MS        measured time (default 5000)\n"
+        "  --warmup MS          unmeasured time first (default 500)\n"
+        "  --slowloris N        extra clients that trickle one header byte per interval\n"
+        "  --slow-interval MS   slowloris byte interval (default 1000)\n"
+        "  --burst-interval MS  pause between burst rounds (default 200)\n"
+        "  --update-interval MS telemetry refresh period (default 250)\n"
+        "  --port N             loopback port (default %d)\n"
+        "  --label TEXT         copied into the JSON output\n",
+        argv0, BENCH_MAX_CLIENTS, BENCH_DEFAULT_PORT);
+}
+
+static bool parse_args(int argc, char* argv[]) {
+    int i;
+
+    g_opt.port = BENCH_DEFAULT_PORT;
+    g_opt.clients = 4;
+    g_opt.duration_ms = 5000;
+    g_opt.warmup_ms = 500;
+    g_opt.burst_interval_ms = 200;
+    g_opt.slow_interval_ms = 1000;
+    g_opt.update_interval_ms = 250;
+    g_opt.mode = BenchMode_KeepAlive;
+    g_opt.label = "";
+    parse_mix("state=80,bin=10,debug=5,404=5");
+
+    for (i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!value) {
+            return false;
+        }
+        i++;
+        if (strcmp(arg, "--clients") == 0) {
+            g_opt.clients = (u32)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--mode") == 0) {
+            if (strcmp(value, "keepalive") == 0) g_opt.mode = BenchMode_KeepAlive;
+            else if (strcmp(value, "close") == 0) g_opt.mode = BenchMode_Close;
+            else if (strcmp(value, "burst") == 0) g_opt.mode = BenchMode_Burst;
+            else return false;
+        } else if (strcmp(arg, "--mix") == 0) {
+            if (!parse_mix(value)) return false;
+        } else if (strcmp(arg, "--duration") == 0) {
+            g_opt.duration_ms = (u32)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--warmup") == 0) {
+            g_opt.warmup_ms = (u32)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--slowloris") == 0) {
+            g_opt.slow_clients = (u32)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--slow-interval") == 0) {
+            g_opt.slow_interval_ms = (u32)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--burst-interval") == 0) {
+            g_opt.burst_interval_ms = (u32)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--update-interval") == 0) {
+            g_opt.update_interval_ms = (u32)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--port") == 0) {
+            g_opt.port = (unsigned short)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--label") == 0) {
+            g_opt.label = value;
+        } else {
+            return false;
+        }
+    }
+    return g_opt.clients >= 1 && g_opt.clients <= BENCH_MAX_CLIENTS &&
+        g_opt.slow_clients <= BENCH_MAX_CLIENTS && g_opt.update_interval_ms > 0;
+}
+
+static void print_result(
+    const BenchClient* total,
+    const LatencyHistogram* latency,
+    u64 elapsed_us,
+    u64 slow_connects,
+    u64 slow_evictions,
+    bool have_overflows,
+    u64 overflows,
+    u64 drops,
+    size_t heap_base,
+    size_t stack_peak
+) {
+    u64 requests = 0;
+    u32 i;
+
+    for (i = 0; i < BenchKind_Count; i++) {
+        requests += total->requests[i];
+    }
+
+    printf("{\"schema\":1,\"label\":\"%s\",\"mode\":\"%s\",\"clients\":%u,\"slowloris\":%u,"
+           "\"duration_ms\":%llu,\"mix\":{",
+        g_opt.label, k_mode_names[g_opt.mode], g_opt.clients, g_opt.slow_clients,
+        (unsigned long long)(elapsed_us / 1000ULL));
+    for (i = 0; i < BenchKind_Count; i++) {
+        printf("%s\"%s\":%u", i ? "," : "", k_kind_names[i], g_opt.mix[i]);
+    }
+    printf("},\"requests\":%llu,\"requests_per_sec\":%.1f,\"by_kind\":{",
+        (unsigned long long)requests, elapsed_us ? (double)requests * 1e6 / (double)elapsed_us : 0.0);
+    for (i = 0; i < BenchKind_Count; i++) {
+        printf("%s\"%s\":%llu", i ? "," : "", k_kind_names[i], (unsigned long long)total->requests[i]);
+    }
+    printf("},\"latency_us\":{\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu,\"mean\":%.1f},",
+        (unsigned long long)lat_percentile(latency, 0.50),
+        (unsigned long long)lat_percentile(latency, 0.99),
+        (unsigned long long)lat_percentile(latency, 0.999),
+        (unsigned long long)latency->max_us,
+        latency->total ? (double)latency->sum_us / (double)latency->total : 0.0);
+    printf("\"errors\":{\"connect\":%llu,\"rejected_503\":%llu,\"bad_status\":%llu,\"io\":%llu,"
+           "\"timeouts\":%llu,\"server_closes\":%llu},",
+        (unsigned long long)total->connect_errors,
+        (unsigned long long)total->rejected_503,
+        (unsigned long long)total->bad_status,
+        (unsigned long long)total->io_errors,
+        (unsigned long long)total->timeouts,
+        (unsigned long long)total->server_closes);
+    printf("\"accept_queue\":{\"server_rejected\":%llu,\"slow_connects\":%llu,",
+        (unsigned long long)g_server.rejected_count, (unsigned long long)slow_connects);
+    if (have_overflows) {
+        printf("\"listen_overflows\":%llu,\"listen_drops\":%llu},",
+            (unsigned long long)overflows, (unsigned long long)drops);
+    } else {
+        printf("\"listen_overflows\":null,\"listen_drops\":null},");
+    }
+    printf("\"server\":{\"accepted\":%llu,\"requests\":%llu,\"timeouts\":%llu,\"peak_connections\":%u,"
+           "\"state_cache_hits\":%llu,\"connects\":%llu,\"slowloris_evictions\":%llu,"
+           "\"head_timeouts\":%llu,\"reclaimed\":%llu},",
+        (unsigned long long)g_server.accepted_count,
+        (unsigned long long)g_server.request_count,
+        (unsigned long long)g_server.timeout_count,
+        g_server.peak_connections,
+        (unsigned long long)g_server.state_cache_hits,
+        (unsigned long long)total->connects,
+        (unsigned long long)slow_evictions,
+        (unsigned long long)g_server.head_timeout_count,
+        (unsigned long long)g_server.reclaimed_count);
+    printf("\"memory\":{\"http_stack_size\":%zu,\"http_stack_peak\":%zu,\"heap_peak_delta\":%zu,"
+           "\"bytes_in\":%llu}}\n",
+        g_server.thread.stack_sz, stack_peak,
+        g_heap_peak > heap_base ? g_heap_peak - heap_base : 0,
+        (unsigned long long)total->bytes_in);
+}
+
+int main(int argc, char* argv[]) {
+    static LatencyHistogram latency;
+    static BenchClient total;
+    pthread_t updater;
+    pthread_t heap_sampler;
+    u64 overflows_before = 0, drops_before = 0, overflows_after = 0, drops_after = 0;
+    u64 slow_connects = 0;
+    u64 slow_evictions = 0;
+    u64 start_us;
+    u64 elapsed_us;
+    size_t heap_base;
+    size_t stack_peak;
+    bool have_overflows;
+    u32 i, k;
+
+    if (!parse_args(argc, argv)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    host_world_init();
+    host_clock_release(); // the benchmark runs on wall time
+    host_thread_set_app_stacks(true);
+
+    host_world_lock();
+    g_host_world.docked = true;
+    g_host_world.charger = PsmChargerType_EnoughPower;
+    g_host_world.app_pid = g_host_world.next_pid++;
+    host_world_add_process(g_host_world.app_pid, BENCH_APP_PROGRAM_ID);
+    host_world_unlock();
+
+    telemetry_init(&g_telemetry);
+    telemetry_set_firmware(&g_telemetry, g_host_world.firmware);
+    telemetry_update(&g_telemetry, true, true, true);
+
+    g_clients = calloc(g_opt.clients, sizeof(*g_clients));
+    if (!g_clients) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    if (g_opt.mode == BenchMode_Burst) {
+        pthread_barrier_init(&g_burst_barrier, NULL, g_opt.clients);
+    }
+
+    if (!http_server_start(&g_server, &g_telemetry, g_opt.port)) {
+        fprintf(stderr, "http_server_start failed\n");
+        return 1;
+    }
+    for (i = 0; i < 200 && !g_server.listening; i++) {
+        sleep_us(5000);
+    }
+    if (!g_server.listening) {
+        fprintf(stderr, "server did not start listening (stage %d errno %d)\n", g_server.stage, g_server.last_errno);
+        return 1;
+    }
+
+    heap_base = heap_in_use();
+    g_heap_peak = heap_base;
+    pthread_create(&heap_sampler, NULL, heap_thread, NULL);
+    pthread_create(&updater, NULL, telemetry_thread, NULL);
+    for (i = 0; i < g_opt.slow_clients; i++) {
+        pthread_create(&g_slow[i].thread, NULL, slow_client_thread, &g_slow[i]);
+    }
+    for (i = 0; i < g_opt.clients; i++) {
+        g_clients[i].index = i;
+        g_clients[i].rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+        pthread_create(&g_clients[i].thread, NULL, client_thread, &g_clients[i]);
+    }
+
+    sleep_us((u64)g_opt.warmup_ms * 1000ULL);
+    have_overflows = read_listen_overflows(&overflows_before, &drops_before);
+    start_us = now_us();
+    g_measuring = true;
+    sleep_us((u64)g_opt.duration_ms * 1000ULL);
+    g_measuring = false;
+    elapsed_us = now_us() - start_us;
+    have_overflows = have_overflows && read_listen_overflows(&overflows_after, &drops_after);
+
+    g_stop = true;
+    if (g_opt.mode == BenchMode_Burst) {
+        // Release anyone parked at the barrier; the stop flag ends their loops.
+        for (i = 0; i < g_opt.clients; i++) {
+            pthread_detach(g_clients[i].thread);
+        }
+    } else {
+        for (i = 0; i < g_opt.clients; i++) {
+            pthread_join(g_clients[i].thread, NULL);
+        }
+    }
+    for (i = 0; i < g_opt.slow_clients; i++) {
+        pthread_join(g_slow[i].thread, NULL);
+        slow_evictions += g_slow[i].evictions;
+    }
+    pthread_join(updater, NULL);
+    pthread_join(heap_sampler, NULL);
+    http_server_stop(&g_server);
+    stack_peak = host_thread_stack_peak(&g_server.thread);
+
+    for (i = 0; i < g_opt.clients; i++) {
+        const BenchClient* c = &g_clients[i];
+
+        lat_merge(&latency, &c->latency);
+        for (k = 0; k < BenchKind_Count; k++) {
+            total.requests[k] += c->requests[k];
+        }
+        total.connects += c->connects;
+        total.connect_errors += c->connect_errors;
+        total.rejected_503 += c->rejected_503;
+        total.bad_status += c->bad_status;
+        total.io_errors += c->io_errors;
+        total.timeouts += c->timeouts;
+        total.server_closes += c->server_closes;
+        total.bytes_in += c->bytes_in;
+        slow_connects += c->slow_connects;
+    }
+
+    print_result(
+        &total,
+        &latency,
+        elapsed_us,
+        slow_connects,
+        slow_evictions,
+        have_overflows,
+        overflows_after - overflows_before,
+        drops_after - drops_before,
+        heap_base,
+        stack_peak
+    );
+    // Burst clients may still be parked at the barrier.
+    fflush(stdout);
+    _exit(0);
+}
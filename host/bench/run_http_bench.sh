@@ -0,0 +1,15 @@
+#!/bin/sh
+# Runs the standard http_bench matrix and prints one JSON object per line.
+# Usage: run_http_bench.sh BINARY [extra http_bench options]
+set -eu
+
+bin="$1"
+shift
+
+"$bin" --label single-poller --clients 1 --mode keepalive "$@"
+"$bin" --label pollers-8 --clients 8 --mode keepalive "$@"
+"$bin" --label pollers-16-overflow --clients 16 --mode keepalive "$@"
+"$bin" --label close-4 --clients 4 --mode close "$@"
+"$bin" --label mixed-404-debug --clients 4 --mix state=40,bin=20,delta=10,debug=15,404=15 "$@"
+"$bin" --label slowloris-8 --clients 2 --slowloris 8 --duration 8000 "$@"
+"$bin" --label reconnect-burst-24 --clients 24 --mode burst "$@"
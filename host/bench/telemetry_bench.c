@@ -0,0 +1,291 @@
+// Microbenchmarks for the telemetry hot paths: telemetry_update (with a synthetic IPC
+// latency on every service call) and the /state serializers. telemetry.c is compiled into
+// this file so its static helpers can be reached directly. Linked with
+// --wrap=snprintf,--wrap=vsnprintf to count formatter calls. One JSON line per case.
+
+#include "../../source/telemetry.c"
+
+#include "host_sim.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_MAX_SAMPLES 200000
+#define BENCH_OUT_SIZE 4096
+#define BENCH_PM_NOT_FOUND MAKERESULT(15, 1)
+
+typedef struct {
+    u64 snprintf_calls;
+    u64 vsnprintf_calls;
+    u64 bytes;
+} FormatCounters;
+
+typedef struct {
+    const char* name;
+    void (*setup)(void);
+    size_t (*op)(u32 iteration); // returns bytes produced, if any
+} BenchCase;
+
+int __real_vsnprintf(char* out, size_t size, const char* fmt, va_list args);
+
+static FormatCounters g_fmt;
+static TelemetryState g_state;
+static char g_out[BENCH_OUT_SIZE];
+static u64 g_samples[BENCH_MAX_SAMPLES];
+static u32 g_ipc_us = 15;
+static u32 g_case_ms = 300;
+static u64 g_app_pid;
+
+static void count_format(int len, size_t size) {
+    if (len > 0) {
+        g_fmt.bytes += size == 0 ? 0 : ((size_t)len < size ? (size_t)len : size - 1);
+    }
+}
+
+int __wrap_snprintf(char* out, size_t size, const char* fmt, ...) {
+    va_list args;
+    int len;
+
+    g_fmt.snprintf_calls++;
+    va_start(args, fmt);
+    len = __real_vsnprintf(out, size, fmt, args);
+    va_end(args);
+    count_format(len, size);
+    return len;
+}
+
+int __wrap_vsnprintf(char* out, size_t size, const char* fmt, va_list args) {
+    const int len = __real_vsnprintf(out, size, fmt, args);
+
+    g_fmt.vsnprintf_calls++;
+    count_format(len, size);
+    return len;
+}
+
+static u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    const u64 x = *(const u64*)a;
+    const u64 y = *(const u64*)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void set_ipc_latency(u64 ns) {
+    u32 i;
+
+    host_world_lock();
+    for (i = 0; i < HostService_Count; i++) {
+        g_host_world.call_latency_ns[i] = ns;
+    }
+    host_world_unlock();
+}
+
+static void set_pmshell_result(Result rc) {
+    host_world_lock();
+    g_host_world.call_result[HostService_Pmshell] = rc;
+    host_world_unlock();
+}
+
+// Makes only the requested work due on the next telemetry_update.
+static void make_due(bool power, bool query) {
+    g_state.next_power_ms = power ? 0 : UINT64_MAX;
+    g_state.next_query_ms = query ? 0 : UINT64_MAX;
+}
+
+static void flip_battery(u32 iteration) {
+    host_world_lock();
+    g_host_world.battery_percent = 50 + (iteration & 1);
+    host_world_unlock();
+}
+
+static void setup_default(void) {
+    set_pmshell_result(0);
+    host_world_lock();
+    g_host_world.battery_percent = 80;
+    host_world_unlock();
+}
+
+static void setup_scan(void) {
+    set_pmshell_result(BENCH_PM_NOT_FOUND);
+}
+
+static size_t op_update_idle(u32 iteration) {
+    (void)iteration;
+    make_due(false, false);
+    telemetry_update(&g_state, true, true, true);
+    return 0;
+}
+
+static size_t op_update_power_steady(u32 iteration) {
+    (void)iteration;
+    make_due(true, false);
+    telemetry_update(&g_state, true, true, true);
+    return 0;
+}
+
+static size_t op_update_power_changed(u32 iteration) {
+    flip_battery(iteration);
+    make_due(true, false);
+    telemetry_update(&g_state, true, true, true);
+    return 0;
+}
+
+static size_t op_update_query(u32 iteration) {
+    (void)iteration;
+    make_due(false, true);
+    telemetry_update(&g_state, true, true, true);
+    return 0;
+}
+
+static size_t op_update_full_changed(u32 iteration) {
+    flip_battery(iteration);
+    make_due(true, true);
+    telemetry_update(&g_state, true, true, true);
+    return 0;
+}
+
+static size_t op_build_json(u32 iteration) {
+    (void)iteration;
+    telemetry_build_json(&g_state, g_out, sizeof(g_out));
+    return strlen(g_out);
+}
+
+static size_t op_build_json_delta(u32 iteration) {
+    (void)iteration;
+    telemetry_build_json_since(&g_state, g_state.power_seq, g_out, sizeof(g_out), NULL);
+    return strlen(g_out);
+}
+
+static size_t op_copy_state_response(u32 iteration) {
+    (void)iteration;
+    return telemetry_copy_state_response(&g_state, "Connection: keep-alive\r\n", g_out, sizeof(g_out), NULL);
+}
+
+static size_t op_build_frame(u32 iteration) {
+    (void)iteration;
+    return telemetry_build_frame(&g_state, (u8*)g_out, sizeof(g_out));
+}
+
+static size_t op_json_string(u32 iteration) {
+    static const char name[] =
+        "The Legend of Zelda: \"Tears of the Kingdom\" \\ Collector's Edition";
+    JsonWriter w;
+
+    (void)iteration;
+    json_writer_init(&w, g_out, 256);
+    json_string(&w, name);
+    json_writer_finish(&w);
+    return w.len;
+}
+
+static const BenchCase k_cases[] = {
+    { "update_idle", setup_default, op_update_idle },
+    { "update_power_steady", setup_default, op_update_power_steady },
+    { "update_power_changed", setup_default, op_update_power_changed },
+    { "update_query_pm", setup_default, op_update_query },
+    { "update_query_scan", setup_scan, op_update_query },
+    { "update_full_changed", setup_default, op_update_full_changed },
+    { "build_json", setup_default, op_build_json },
+    { "build_json_delta", setup_default, op_build_json_delta },
+    { "copy_state_response", setup_default, op_copy_state_response },
+    { "build_frame", setup_default, op_build_frame },
+    { "json_string", setup_default, op_json_string },
+};
+
+static void run_case(const BenchCase* c) {
+    const u64 budget_ns = (u64)g_case_ms * 1000000ULL;
+    HostLockStats locks;
+    FormatCounters fmt;
+    u64 bytes = 0;
+    u64 total_ns = 0;
+    u64 start;
+    u32 n = 0;
+    u32 i;
+
+    c->setup();
+    for (i = 0; i < 64; i++) {
+        c->op(i); // warm caches and the PID cache
+    }
+
+    host_lock_stats_reset();
+    memset(&g_fmt, 0, sizeof(g_fmt));
+    start = now_ns();
+    while (n < BENCH_MAX_SAMPLES && now_ns() - start < budget_ns) {
+        const u64 t0 = now_ns();
+        bytes += c->op(n);
+        g_samples[n] = now_ns() - t0;
+        total_ns += g_samples[n];
+        n++;
+    }
+    fmt = g_fmt;
+    host_lock_stats_get(&locks);
+
+    qsort(g_samples, n, sizeof(g_samples[0]), compare_u64);
+    printf("{\"schema\":1,\"case\":\"%s\",\"ipc_us\":%u,\"ops\":%u,\"ns_per_op\":%.0f,"
+           "\"p50_ns\":%llu,\"p99_ns\":%llu,\"lock_acquisitions_per_op\":%.2f,"
+           "\"lock_hold_ns_per_op\":%.0f,\"lock_max_hold_ns\":%llu,\"snprintf_per_op\":%.2f,"
+           "\"vsnprintf_per_op\":%.2f,\"format_bytes_per_op\":%.1f,\"output_bytes_per_op\":%.1f}\n",
+        c->name,
+        g_ipc_us,
+        n,
+        n ? (double)total_ns / n : 0.0,
+        (unsigned long long)(n ? g_samples[n / 2] : 0),
+        (unsigned long long)(n ? g_samples[(u64)n * 99 / 100] : 0),
+        n ? (double)locks.acquisitions / n : 0.0,
+        n ? (double)locks.total_hold_ns / n : 0.0,
+        (unsigned long long)locks.max_hold_ns,
+        n ? (double)fmt.snprintf_calls / n : 0.0,
+        n ? (double)fmt.vsnprintf_calls / n : 0.0,
+        n ? (double)fmt.bytes / n : 0.0,
+        n ? (double)bytes / n : 0.0);
+}
+
+int main(int argc, char* argv[]) {
+    const char* only = NULL;
+    size_t i;
+    int a;
+
+    for (a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--ipc-us") == 0 && a + 1 < argc) {
+            g_ipc_us = (u32)strtoul(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--case-ms") == 0 && a + 1 < argc) {
+            g_case_ms = (u32)strtoul(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--case") == 0 && a + 1 < argc) {
+            only = argv[++a];
+        } else {
+            fprintf(stderr, "usage: %s [--ipc-us N] [--case-ms MS] [--case NAME]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    host_world_init();
+    host_clock_release(); // wall time, so schedules and timestamps behave as on hardware
+    host_world_lock();
+    g_app_pid = g_host_world.next_pid++;
+    g_host_world.app_pid = g_app_pid;
+    host_world_add_process(g_app_pid, 0x0100000000010000ULL);
+    g_host_world.docked = true;
+    g_host_world.charger = PsmChargerType_EnoughPower;
+    host_world_unlock();
+
+    telemetry_init(&g_state);
+    telemetry_set_firmware(&g_state, "19.0.1");
+    for (i = 0; i < 4; i++) {
+        make_due(true, true);
+        telemetry_update(&g_state, true, true, true);
+    }
+
+    set_ipc_latency((u64)g_ipc_us * 1000ULL);
+    host_lock_stats_enable(true);
+    for (i = 0; i < sizeof(k_cases) / sizeof(k_cases[0]); i++) {
+        if (!only || strcmp(only, k_cases[i].name) == 0) {
+            run_case(&k_cases[i]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+#---------------------------------------------------------------------------------
+# Host build: the sysmodule's sources against host/libnx_shim.c, for running scripted
+# scenarios on a desktop. Included by the Makefile for the host* goals only.
+#---------------------------------------------------------------------------------
+HOST_CC		?=	cc
+HOST_BUILD	:=	build-host
+HOST_TARGET	:=	$(HOST_BUILD)/richnx-host
+HOST_PORT	?=	16029
+HOST_CFLAGS	:=	-g -O2 -Wall -std=gnu11 -pthread -Ihost/include -Iinclude -DHTTP_PORT=$(HOST_PORT)
+HOST_LDFLAGS	:=	-pthread
+
+HOST_APP_SRCS	:=	$(filter-out source/main.c,$(wildcard source/*.c))
+HOST_SIM_SRCS	:=	host/host_sim.c host/host_world.c host/libnx_shim.c
+HOST_OBJS	:=	$(patsubst %.c,$(HOST_BUILD)/%.o,$(HOST_APP_SRCS) $(HOST_SIM_SRCS)) \
+			$(HOST_BUILD)/source/main.o
+
+HOST_BENCH_TARGET	:=	$(HOST_BUILD)/http-bench
+HOST_BENCH_OBJS	:=	$(patsubst %.c,$(HOST_BUILD)/%.o,$(HOST_APP_SRCS) host/host_world.c host/libnx_shim.c \
+			host/bench/http_bench.c)
+
+# telemetry.c is #included by the microbenchmark, so it is not linked separately.
+HOST_MICROBENCH_TARGET	:=	$(HOST_BUILD)/telemetry-bench
+HOST_MICROBENCH_OBJS	:=	$(patsubst %.c,$(HOST_BUILD)/%.o,source/json_writer.c source/power_history.c source/title_icons.c source/title_names.c source/titledb_index.c host/host_world.c host/libnx_shim.c \
+			host/bench/telemetry_bench.c)
+HOST_MICROBENCH_LDFLAGS	:=	-Wl,--wrap=snprintf,--wrap=vsnprintf
+
+HOST_LOG_DECODE_TARGET	:=	$(HOST_BUILD)/log-decode
+HOST_LOG_DECODE_OBJS	:=	$(patsubst %.c,$(HOST_BUILD)/%.o,source/log_events.c host/tools/log_decode.c)
+
+HOST_TITLEDB_TARGET	:=	$(HOST_BUILD)/titledb-build
+HOST_TITLEDB_OBJS	:=	$(patsubst %.c,$(HOST_BUILD)/%.o,source/titledb_index.c host/tools/titledb_build.c)
+
+.PHONY: host host-scenarios host-bench host-microbench host-log-decode host-titledb host-clean
+
+host: $(HOST_TARGET)
+
+$(HOST_TARGET): $(HOST_OBJS)
+	$(HOST_CC) $(HOST_LDFLAGS) -o $@ $^
+
+# main() belongs to the simulator; the sysmodule's entry point is renamed.
+$(HOST_BUILD)/source/main.o: source/main.c
+	@mkdir -p $(dir $@)
+	$(HOST_CC) $(HOST_CFLAGS) -Dmain=richnx_main -MMD -c $< -o $@
+
+$(HOST_BUILD)/%.o: %.c
+	@mkdir -p $(dir $@)
+	$(HOST_CC) $(HOST_CFLAGS) -MMD -c $< -o $@
+
+host-scenarios: $(HOST_TARGET)
+	@host/run_scenarios.sh $(HOST_TARGET) host/scenarios/*.txt
+
+host-bench: $(HOST_BENCH_TARGET)
+	@host/bench/run_http_bench.sh $(HOST_BENCH_TARGET)
+
+$(HOST_BENCH_TARGET): $(HOST_BENCH_OBJS)
+	$(HOST_CC) $(HOST_LDFLAGS) -o $@ $^
+
+host-microbench: $(HOST_MICROBENCH_TARGET)
+	@$(HOST_MICROBENCH_TARGET)
+
+$(HOST_MICROBENCH_TARGET): $(HOST_MICROBENCH_OBJS)
+	$(HOST_CC) $(HOST_LDFLAGS) $(HOST_MICROBENCH_LDFLAGS) -o $@ $^
+
+host-log-decode: $(HOST_LOG_DECODE_TARGET)
+
+$(HOST_LOG_DECODE_TARGET): $(HOST_LOG_DECODE_OBJS)
+	$(HOST_CC) $(HOST_LDFLAGS) -o $@ $^
+
+host-titledb: $(HOST_TITLEDB_TARGET)
+
+$(HOST_TITLEDB_TARGET): $(HOST_TITLEDB_OBJS)
+	$(HOST_CC) $(HOST_LDFLAGS) -o $@ $^
+
+host-clean:
+	@rm -fr $(HOST_BUILD)
+
+-include $(HOST_OBJS:.o=.d) $(HOST_BENCH_OBJS:.o=.d) $(HOST_MICROBENCH_OBJS:.o=.d) $(HOST_LOG_DECODE_OBJS:.o=.d) $(HOST_TITLEDB_OBJS:.o=.d)
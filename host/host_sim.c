@@ -0,0 +1,630 @@
+#include <switch.h>
+
+#include "host_sim.h"
+#include "telemetry.h"
+#include "udp_sender.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef HTTP_PORT
+#define HTTP_PORT 6029
+#endif
+
+#define HOST_SCENARIO_MAX_EVENTS 256
+#define HOST_SCENARIO_LINE_MAX 256
+#define HOST_EVENT_CLEAR_NS (1ULL * 1000000ULL)
+#define HOST_EXPECT_TIMEOUT_SEC 2
+#define HOST_EXPECT_RESPONSE_MAX 8192
+#define HOST_UDP_CONFIG_DIR "sdmc:/switch/switch-dcrpc"
+
+int richnx_main(int argc, char* argv[]);
+void __libnx_initheap(void);
+void __appInit(void);
+void __appExit(void);
+
+typedef enum {
+    ScenarioOp_Battery,
+    ScenarioOp_Charger,
+    ScenarioOp_Dock,
+    ScenarioOp_Launch,
+    ScenarioOp_Title,
+    ScenarioOp_Exit,
+    ScenarioOp_Fail,
+    ScenarioOp_Recover,
+    ScenarioOp_Expect,
+    ScenarioOp_Log,
+    ScenarioOp_Udp,
+    ScenarioOp_End,
+} ScenarioOp;
+
+typedef struct {
+    u64 at_ns;
+    u32 line;
+    ScenarioOp op;
+    u64 value;
+    bool init_only;
+    HostService service;
+    char path[64];
+    char key[64];
+    char text[128];
+} ScenarioEvent;
+
+static ScenarioEvent g_events[HOST_SCENARIO_MAX_EVENTS];
+static u32 g_event_count;
+static u32 g_event_next;
+static u32 g_expect_count;
+static u32 g_failures;
+static int g_udp_fd = -1;
+
+static void scenario_log(const ScenarioEvent* ev, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void scenario_log(const ScenarioEvent* ev, const char* fmt, ...) {
+    const u64 now = host_clock_now_ns();
+    va_list args;
+
+    printf("[%5llu.%03llus] line %u: ", (unsigned long long)(now / 1000000000ULL),
+        (unsigned long long)((now / 1000000ULL) % 1000ULL), ev->line);
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+    printf("\n");
+    fflush(stdout);
+}
+
+static void host_signal_process_event(void) {
+    g_host_world.process_event_signaled = true;
+    g_host_world.process_event_signal_count++;
+    g_host_world.process_event_clear_ns = host_clock_now_ns() + HOST_EVENT_CLEAR_NS;
+}
+
+// Fetches path from the sysmodule's HTTP server over loopback. Returns the body length,
+// or -1 on a connection failure.
+static int host_http_get(const char* path, char* out, size_t out_size) {
+    struct sockaddr_in addr;
+    struct timeval tv;
+    char request[160];
+    size_t used = 0;
+    int fd;
+    int req_len;
+    char* body;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    tv.tv_sec = HOST_EXPECT_TIMEOUT_SEC;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(HTTP_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    req_len = snprintf(request, sizeof(request), "GET %s HTTP/1.0\r\nHost: localhost\r\n\r\n", path);
+    if (send(fd, request, (size_t)req_len, 0) != req_len) {
+        close(fd);
+        return -1;
+    }
+
+    while (used + 1 < out_size) {
+        const ssize_t got = recv(fd, out + used, out_size - 1 - used, 0);
+        if (got <= 0) {
+            break;
+        }
+        used += (size_t)got;
+    }
+    close(fd);
+    out[used] = '\0';
+
+    body = strstr(out, "\r\n\r\n");
+    if (!body) {
+        return -1;
+    }
+    body += 4;
+    memmove(out, body, strlen(body) + 1);
+    return (int)strlen(out);
+}
+
+// Extracts the raw JSON token after "key": — padding spaces in the fixed-width counter
+// slots are skipped.
+static bool host_json_token(const char* json, const char* key, char* out, size_t out_size) {
+    char needle[80];
+    const char* p;
+    size_t len = 0;
+
+    snprintf(needle, sizeof(needle), "\"%s\":", key);
+    p = strstr(json, needle);
+    if (!p) {
+        return false;
+    }
+    p += strlen(needle);
+    while (*p == ' ') {
+        p++;
+    }
+
+    if (*p == '"') {
+        const char* end = strchr(p + 1, '"');
+        if (!end) {
+            return false;
+        }
+        len = (size_t)(end - p) + 1;
+    } else {
+        while (p[len] && p[len] != ',' && p[len] != '}' && p[len] != ' ') {
+            len++;
+        }
+    }
+    if (len >= out_size) {
+        len = out_size - 1;
+    }
+    memcpy(out, p, len);
+    out[len] = '\0';
+    return true;
+}
+
+// Writes udp.txt before the sysmodule starts and listens on the target's port on every
+// interface, so a broadcast reaches it as well as a unicast to loopback.
+static bool host_udp_setup(const ScenarioEvent* ev) {
+    struct sockaddr_in addr;
+    struct timeval tv;
+    const int yes = 1;
+    FILE* f;
+
+    mkdir("sdmc:", 0777);
+    mkdir("sdmc:/switch", 0777);
+    mkdir(HOST_UDP_CONFIG_DIR, 0777);
+    f = fopen(HOST_UDP_CONFIG_DIR "/udp.txt", "w");
+    if (!f) {
+        fprintf(stderr, "cannot write udp.txt: %s\n", strerror(errno));
+        return false;
+    }
+    fprintf(f, "%s\n", ev->key);
+    fclose(f);
+
+    g_udp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (g_udp_fd < 0) {
+        return false;
+    }
+    setsockopt(g_udp_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    tv.tv_sec = HOST_EXPECT_TIMEOUT_SEC;
+    tv.tv_usec = 0;
+    setsockopt(g_udp_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)ev->value);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(g_udp_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "cannot listen on udp port %llu: %s\n", (unsigned long long)ev->value, strerror(errno));
+        close(g_udp_fd);
+        g_udp_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+static u64 frame_get_le(const u8* p, int bytes) {
+    u64 value = 0;
+    int i;
+
+    for (i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static const char* frame_tristate(u8 flags, u8 valid_bit, u8 value_bit) {
+    if (!(flags & valid_bit)) return "null";
+    return (flags & value_bit) ? "true" : "false";
+}
+
+// Decodes a /state.bin frame (layout in telemetry.h) into flat JSON for host_json_token;
+// "valid" is false when the magic, schema or length do not check out.
+static void host_decode_frame(const u8* frame, size_t len, char* out, size_t out_size) {
+    char firmware[256];
+    char game[256];
+    char battery[8];
+    const u8* p = frame + TELEMETRY_FRAME_FIXED_SIZE;
+    const u8* end = frame + len;
+    u8 flags;
+
+    if (len < TELEMETRY_FRAME_FIXED_SIZE + 2 ||
+        frame_get_le(frame, 4) != TELEMETRY_FRAME_MAGIC ||
+        frame_get_le(frame + 4, 2) != TELEMETRY_FRAME_SCHEMA_ID ||
+        frame_get_le(frame + 6, 2) != len) {
+        snprintf(out, out_size, "{\"valid\":false,\"length\":%zu}", len);
+        return;
+    }
+    if (p + 1 + *p >= end || p + 1 + *p + 1 + p[1 + *p] > end) {
+        snprintf(out, out_size, "{\"valid\":false,\"length\":%zu}", len);
+        return;
+    }
+    snprintf(firmware, sizeof(firmware), "%.*s", (int)*p, (const char*)p + 1);
+    p += 1 + *p;
+    snprintf(game, sizeof(game), "%.*s", (int)*p, (const char*)p + 1);
+
+    flags = frame[49];
+    if (flags & TelemetryFrameFlag_BatteryValid) {
+        snprintf(battery, sizeof(battery), "%u", (unsigned int)frame[48]);
+    } else {
+        snprintf(battery, sizeof(battery), "null");
+    }
+    snprintf(out, out_size,
+        "{\"valid\":true,\"length\":%zu,\"seq\":%llu,\"change_seq\":%llu,"
+        "\"active_program_id\":\"0x%016llX\",\"battery_percent\":%s,"
+        "\"is_charging\":%s,\"is_docked\":%s,\"firmware\":\"%s\",\"active_game\":\"%s\"}",
+        len,
+        (unsigned long long)frame_get_le(frame + 8, 8),
+        (unsigned long long)frame_get_le(frame + 16, 8),
+        (unsigned long long)frame_get_le(frame + 40, 8),
+        battery,
+        frame_tristate(flags, TelemetryFrameFlag_ChargingValid, TelemetryFrameFlag_Charging),
+        frame_tristate(flags, TelemetryFrameFlag_DockedValid, TelemetryFrameFlag_Docked),
+        firmware,
+        game);
+}
+
+// The newest datagram received so far, decoded. Several expectations can check the same
+// frame; only before the first one has arrived does this wait.
+static int host_udp_receive(char* out, size_t out_size) {
+    static u8 frame[TELEMETRY_FRAME_MAX];
+    static ssize_t frame_len = -1;
+    u8 next[TELEMETRY_FRAME_MAX];
+    ssize_t got;
+
+    if (g_udp_fd < 0) {
+        return -1;
+    }
+    if (frame_len < 0) {
+        frame_len = recv(g_udp_fd, frame, sizeof(frame), 0);
+        if (frame_len < 0) {
+            return -1;
+        }
+    }
+    while ((got = recv(g_udp_fd, next, sizeof(next), MSG_DONTWAIT)) >= 0) {
+        memcpy(frame, next, (size_t)got);
+        frame_len = got;
+    }
+    host_decode_frame(frame, (size_t)frame_len, out, out_size);
+    return (int)strlen(out);
+}
+
+static void host_run_expect(const ScenarioEvent* ev) {
+    static char response[HOST_EXPECT_RESPONSE_MAX];
+    char actual[128];
+    int got;
+
+    g_expect_count++;
+    // "udp" reads the sysmodule's datagrams instead of an HTTP path.
+    got = strcmp(ev->path, "udp") == 0 ?
+        host_udp_receive(response, sizeof(response)) :
+        host_http_get(ev->path, response, sizeof(response));
+    if (got < 0) {
+        g_failures++;
+        scenario_log(ev, "FAIL expect %s %s == %s (request failed)", ev->path, ev->key, ev->text);
+        return;
+    }
+    if (!host_json_token(response, ev->key, actual, sizeof(actual))) {
+        g_failures++;
+        scenario_log(ev, "FAIL expect %s %s == %s (key missing)", ev->path, ev->key, ev->text);
+        return;
+    }
+    if (strcmp(actual, ev->text) != 0) {
+        g_failures++;
+        scenario_log(ev, "FAIL expect %s %s == %s (got %s)", ev->path, ev->key, ev->text, actual);
+        return;
+    }
+    scenario_log(ev, "ok   expect %s %s == %s", ev->path, ev->key, ev->text);
+}
+
+static void host_scenario_end(const ScenarioEvent* ev) {
+    scenario_log(ev, "end: %u expectation(s), %u failure(s)", g_expect_count, g_failures);
+    host_clock_release();
+    __appExit();
+    exit(g_failures ? 1 : 0);
+}
+
+static void host_apply_event(const ScenarioEvent* ev) {
+    switch (ev->op) {
+        case ScenarioOp_Expect:
+            host_run_expect(ev);
+            return;
+        case ScenarioOp_Log:
+        case ScenarioOp_Udp:
+            scenario_log(ev, "%s", ev->text);
+            return;
+        case ScenarioOp_End:
+            host_scenario_end(ev);
+            return;
+        default:
+            break;
+    }
+
+    host_world_lock();
+    switch (ev->op) {
+        case ScenarioOp_Battery:
+            g_host_world.battery_percent = (u32)ev->value;
+            break;
+        case ScenarioOp_Charger:
+            g_host_world.charger = (PsmChargerType)ev->value;
+            break;
+        case ScenarioOp_Dock:
+            g_host_world.docked = ev->value != 0;
+            break;
+        case ScenarioOp_Launch:
+            if (g_host_world.app_pid != 0) {
+                host_world_remove_process(g_host_world.app_pid);
+            }
+            g_host_world.app_pid = g_host_world.next_pid++;
+            host_world_add_process(g_host_world.app_pid, ev->value);
+            host_signal_process_event();
+            break;
+        case ScenarioOp_Title:
+            host_world_add_title(ev->value, ev->key);
+            break;
+        case ScenarioOp_Exit:
+            if (g_host_world.app_pid != 0) {
+                host_world_remove_process(g_host_world.app_pid);
+                g_host_world.app_pid = 0;
+                host_signal_process_event();
+            }
+            break;
+        case ScenarioOp_Fail:
+            g_host_world.init_result[ev->service] = (Result)ev->value;
+            if (!ev->init_only) {
+                g_host_world.call_result[ev->service] = (Result)ev->value;
+            }
+            break;
+        case ScenarioOp_Recover:
+            g_host_world.init_result[ev->service] = 0;
+            g_host_world.call_result[ev->service] = 0;
+            break;
+        default:
+            break;
+    }
+    host_world_unlock();
+
+    scenario_log(ev, "%s", ev->text);
+}
+
+static u64 host_scenario_next_ns(void) {
+    return g_event_next < g_event_count ? g_events[g_event_next].at_ns : UINT64_MAX;
+}
+
+static void host_scenario_run_until(u64 now_ns) {
+    while (g_event_next < g_event_count && g_events[g_event_next].at_ns <= now_ns) {
+        const ScenarioEvent* ev = &g_events[g_event_next++];
+        host_apply_event(ev);
+    }
+}
+
+// "12", "12s", "+500", "+2s": milliseconds unless suffixed, relative to the previous line.
+static bool parse_time(const char* token, u64 previous_ns, u64* out_ns) {
+    const bool relative = token[0] == '+';
+    char* end;
+    unsigned long long value = strtoull(relative ? token + 1 : token, &end, 10);
+    u64 ns;
+
+    if (end == token || (*end != '\0' && strcmp(end, "s") != 0 && strcmp(end, "ms") != 0)) {
+        return false;
+    }
+    ns = strcmp(end, "s") == 0 ? value * 1000000000ULL : value * 1000000ULL;
+    *out_ns = relative ? previous_ns + ns : ns;
+    return true;
+}
+
+static bool parse_event(char* line, u32 line_no, u64* previous_ns, ScenarioEvent* ev) {
+    char* save = NULL;
+    char* when = strtok_r(line, " \t", &save);
+    char* cmd = strtok_r(NULL, " \t", &save);
+    char* a = strtok_r(NULL, " \t", &save);
+    char* b = strtok_r(NULL, " \t", &save);
+    char* c = strtok_r(NULL, "", &save);
+
+    memset(ev, 0, sizeof(*ev));
+    ev->line = line_no;
+    if (!when || !cmd || !parse_time(when, *previous_ns, &ev->at_ns)) {
+        return false;
+    }
+    if (ev->at_ns < *previous_ns) {
+        fprintf(stderr, "scenario line %u: events must be in time order\n", line_no);
+        return false;
+    }
+    *previous_ns = ev->at_ns;
+
+    if (strcmp(cmd, "battery") == 0 && a) {
+        ev->op = ScenarioOp_Battery;
+        ev->value = strtoull(a, NULL, 10);
+        snprintf(ev->text, sizeof(ev->text), "battery %s%%", a);
+    } else if (strcmp(cmd, "charger") == 0 && a) {
+        ev->op = ScenarioOp_Charger;
+        if (strcmp(a, "none") == 0) {
+            ev->value = PsmChargerType_Unconnected;
+        } else if (strcmp(a, "enough") == 0) {
+            ev->value = PsmChargerType_EnoughPower;
+        } else if (strcmp(a, "low") == 0) {
+            ev->value = PsmChargerType_LowPower;
+        } else {
+            return false;
+        }
+        snprintf(ev->text, sizeof(ev->text), "charger %s", a);
+    } else if (strcmp(cmd, "dock") == 0 && a) {
+        ev->op = ScenarioOp_Dock;
+        if (strcmp(a, "docked") == 0) {
+            ev->value = 1;
+        } else if (strcmp(a, "handheld") != 0) {
+            return false;
+        }
+        snprintf(ev->text, sizeof(ev->text), "dock %s", a);
+    } else if (strcmp(cmd, "launch") == 0 && a) {
+        ev->op = ScenarioOp_Launch;
+        ev->value = strtoull(a, NULL, 16);
+        snprintf(ev->text, sizeof(ev->text), "launch 0x%016llX", (unsigned long long)ev->value);
+    } else if (strcmp(cmd, "title") == 0 && a && b) {
+        ev->op = ScenarioOp_Title;
+        ev->value = strtoull(a, NULL, 16);
+        snprintf(ev->key, sizeof(ev->key), "%s%s%s", b, c ? " " : "", c ? c : "");
+        snprintf(ev->text, sizeof(ev->text), "title 0x%016llX \"%s%s%s\"", (unsigned long long)ev->value,
+            b, c ? " " : "", c ? c : "");
+    } else if (strcmp(cmd, "exit") == 0) {
+        ev->op = ScenarioOp_Exit;
+        snprintf(ev->text, sizeof(ev->text), "exit application");
+    } else if (strcmp(cmd, "fail") == 0 && a && b && host_service_from_name(a, &ev->service)) {
+        ev->op = ScenarioOp_Fail;
+        ev->value = strtoull(b, NULL, 16);
+        ev->init_only = c && strcmp(c, "init") == 0;
+        snprintf(ev->text, sizeof(ev->text), "fail %s rc=0x%08llX%s", a,
+            (unsigned long long)ev->value, ev->init_only ? " (init only)" : "");
+    } else if (strcmp(cmd, "recover") == 0 && a && host_service_from_name(a, &ev->service)) {
+        ev->op = ScenarioOp_Recover;
+        snprintf(ev->text, sizeof(ev->text), "recover %s", a);
+    } else if (strcmp(cmd, "expect") == 0 && a && b && c) {
+        ev->op = ScenarioOp_Expect;
+        snprintf(ev->path, sizeof(ev->path), "%s", a);
+        snprintf(ev->key, sizeof(ev->key), "%s", b);
+        snprintf(ev->text, sizeof(ev->text), "%s", c);
+    } else if (strcmp(cmd, "log") == 0) {
+        ev->op = ScenarioOp_Log;
+        snprintf(ev->text, sizeof(ev->text), "%s%s%s%s%s", a ? a : "", b ? " " : "", b ? b : "",
+            c ? " " : "", c ? c : "");
+    } else if (strcmp(cmd, "udp") == 0 && a) {
+        // Sets up udp.txt and the receiver before the sysmodule starts, so only at 0s.
+        const char* colon = strchr(a, ':');
+
+        if (ev->at_ns != 0) {
+            fprintf(stderr, "scenario line %u: udp must come at 0s\n", line_no);
+            return false;
+        }
+        ev->op = ScenarioOp_Udp;
+        ev->value = colon ? strtoull(colon + 1, NULL, 10) : UDP_SENDER_DEFAULT_PORT;
+        snprintf(ev->key, sizeof(ev->key), "%s", a);
+        snprintf(ev->text, sizeof(ev->text), "udp target %s", a);
+    } else if (strcmp(cmd, "end") == 0) {
+        ev->op = ScenarioOp_End;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool load_scenario(const char* path) {
+    char line[HOST_SCENARIO_LINE_MAX];
+    u64 previous_ns = 0;
+    u32 line_no = 0;
+    bool has_end = false;
+    FILE* f = fopen(path, "r");
+
+    if (!f) {
+        fprintf(stderr, "cannot open scenario %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        char* p = line;
+        size_t len;
+
+        line_no++;
+        len = strlen(line);
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' || line[len - 1] == ' ')) {
+            line[--len] = '\0';
+        }
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '\0' || *p == '#') {
+            continue;
+        }
+        if (g_event_count >= HOST_SCENARIO_MAX_EVENTS) {
+            fprintf(stderr, "scenario %s: too many events\n", path);
+            fclose(f);
+            return false;
+        }
+        if (!parse_event(p, line_no, &previous_ns, &g_events[g_event_count])) {
+            fprintf(stderr, "scenario %s line %u: cannot parse \"%s\"\n", path, line_no, p);
+            fclose(f);
+            return false;
+        }
+        has_end = has_end || g_events[g_event_count].op == ScenarioOp_End;
+        g_event_count++;
+    }
+    fclose(f);
+
+    if (!has_end) {
+        fprintf(stderr, "scenario %s: missing \"end\"\n", path);
+        return false;
+    }
+    return true;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "usage: %s [--scenario FILE] [--speed N] [--workdir DIR]\n"
+        "  --scenario FILE  drive the simulated console from FILE and exit with its result\n"
+        "  --speed N        virtual seconds per real second (0 = as fast as possible)\n"
+        "  --workdir DIR    directory that stands in for the SD card root (default .)\n",
+        argv0);
+}
+
+int main(int argc, char* argv[]) {
+    const char* scenario = NULL;
+    const char* workdir = ".";
+    long speed = -1;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+            scenario = argv[++i];
+        } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--workdir") == 0 && i + 1 < argc) {
+            workdir = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    host_world_init();
+    if (scenario && !load_scenario(scenario)) {
+        return 2;
+    }
+    if (mkdir(workdir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "cannot create %s: %s\n", workdir, strerror(errno));
+        return 2;
+    }
+    if (chdir(workdir) != 0) {
+        fprintf(stderr, "cannot enter %s: %s\n", workdir, strerror(errno));
+        return 2;
+    }
+
+    for (i = 0; i < (int)g_event_count; i++) {
+        if (g_events[i].op == ScenarioOp_Udp && !host_udp_setup(&g_events[i])) {
+            return 2;
+        }
+    }
+
+    // Interactive runs follow the wall clock; scripted runs go as fast as they can.
+    host_clock_set_speed(speed >= 0 ? (u32)speed : (scenario ? 0 : 1));
+    host_clock_set_driver();
+    host_clock_set_event_source(host_scenario_next_ns, host_scenario_run_until);
+
+    __libnx_initheap();
+    __appInit();
+    return richnx_main(argc, argv);
+}
@@ -0,0 +1,241 @@
+#include <switch.h>
+
+#include "host_sim.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define HOST_SETTLE_REAL_NS (2ULL * 1000000ULL)
+#define HOST_FIRST_APP_PID 0x51
+#define HOST_QLAUNCH_PROGRAM_ID 0x0100000000001000ULL
+#define HOST_SYSMODULE_PROGRAM_ID 0x00FF0000A1B2C3D4ULL
+
+HostWorld g_host_world;
+
+static pthread_mutex_t g_world_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_mutex_t g_clock_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_clock_cond = PTHREAD_COND_INITIALIZER;
+static volatile u64 g_clock_ns;
+static volatile u64 g_clock_epoch;
+static u32 g_clock_speed;
+static volatile bool g_clock_released;
+static struct timespec g_clock_release_real;
+static u64 g_clock_release_ns;
+static pthread_t g_driver;
+static bool g_driver_set;
+static u64 (*g_next_event_ns)(void);
+static void (*g_run_events_until)(u64 now_ns);
+
+static const char* const k_service_names[HostService_Count] = {
+    "sm", "fs", "setsys", "nifm", "applet", "psm", "pmshell", "pminfo", "ns", "socket",
+};
+
+static u64 real_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+static void real_sleep_ns(u64 ns) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    nanosleep(&ts, NULL);
+}
+
+void host_world_lock(void) {
+    pthread_mutex_lock(&g_world_lock);
+}
+
+void host_world_unlock(void) {
+    pthread_mutex_unlock(&g_world_lock);
+}
+
+const char* host_service_name(HostService service) {
+    return service < HostService_Count ? k_service_names[service] : "?";
+}
+
+bool host_service_from_name(const char* name, HostService* out) {
+    u32 i;
+
+    for (i = 0; i < HostService_Count; i++) {
+        if (strcmp(name, k_service_names[i]) == 0) {
+            *out = (HostService)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void host_world_add_process(u64 pid, u64 program_id) {
+    if (g_host_world.process_count < HOST_MAX_PROCESSES) {
+        g_host_world.processes[g_host_world.process_count].pid = pid;
+        g_host_world.processes[g_host_world.process_count].program_id = program_id;
+        g_host_world.process_count++;
+    }
+}
+
+void host_world_add_title(u64 program_id, const char* name) {
+    HostTitle* title = NULL;
+    u32 i;
+
+    for (i = 0; i < g_host_world.title_count; i++) {
+        if (g_host_world.titles[i].program_id == program_id) {
+            title = &g_host_world.titles[i];
+        }
+    }
+    if (!title && g_host_world.title_count < HOST_MAX_TITLES) {
+        title = &g_host_world.titles[g_host_world.title_count++];
+    }
+    if (title) {
+        title->program_id = program_id;
+        snprintf(title->name, sizeof(title->name), "%s", name);
+    }
+}
+
+void host_world_remove_process(u64 pid) {
+    u32 i;
+
+    for (i = 0; i < g_host_world.process_count; i++) {
+        if (g_host_world.processes[i].pid == pid) {
+            g_host_world.processes[i] = g_host_world.processes[g_host_world.process_count - 1];
+            g_host_world.process_count--;
+            return;
+        }
+    }
+}
+
+// A boot-time process list: built-in system modules, qlaunch and one homebrew sysmodule,
+// the same shape the PID cache sees on hardware.
+void host_world_init(void) {
+    u64 pid;
+
+    memset(&g_host_world, 0, sizeof(g_host_world));
+    g_host_world.battery_percent = 100;
+    g_host_world.charger = PsmChargerType_Unconnected;
+    snprintf(g_host_world.firmware, sizeof(g_host_world.firmware), "19.0.1");
+
+    for (pid = 1; pid <= 0x30; pid++) {
+        host_world_add_process(pid, 0x0100000000000000ULL + pid);
+    }
+    host_world_add_process(0x31, HOST_QLAUNCH_PROGRAM_ID);
+    host_world_add_process(0x32, HOST_SYSMODULE_PROGRAM_ID);
+    g_host_world.next_pid = HOST_FIRST_APP_PID;
+}
+
+void host_clock_set_driver(void) {
+    g_driver = pthread_self();
+    g_driver_set = true;
+}
+
+bool host_clock_is_driver(void) {
+    return g_driver_set && !g_clock_released && pthread_equal(g_driver, pthread_self());
+}
+
+u64 host_clock_now_ns(void) {
+    if (g_clock_released) {
+        return g_clock_release_ns + real_now_ns() -
+            ((u64)g_clock_release_real.tv_sec * 1000000000ULL + (u64)g_clock_release_real.tv_nsec);
+    }
+    return __atomic_load_n(&g_clock_ns, __ATOMIC_ACQUIRE);
+}
+
+void host_clock_set_event_source(u64 (*next_event_ns)(void), void (*run_until)(u64 now_ns)) {
+    g_next_event_ns = next_event_ns;
+    g_run_events_until = run_until;
+}
+
+void host_clock_set_speed(u32 speed) {
+    g_clock_speed = speed;
+}
+
+u64 host_clock_epoch(void) {
+    return __atomic_load_n(&g_clock_epoch, __ATOMIC_ACQUIRE);
+}
+
+void host_clock_broadcast(void) {
+    pthread_mutex_lock(&g_clock_lock);
+    __atomic_store_n(&g_clock_epoch, g_clock_epoch + 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&g_clock_cond);
+    pthread_mutex_unlock(&g_clock_lock);
+}
+
+// From here on the clock follows real time; used while shutting down so joins and
+// timeouts in other threads finish on their own.
+void host_clock_release(void) {
+    g_clock_release_ns = host_clock_now_ns();
+    clock_gettime(CLOCK_MONOTONIC, &g_clock_release_real);
+    g_clock_released = true;
+    host_clock_broadcast();
+}
+
+static void host_clock_set(u64 now_ns) {
+    __atomic_store_n(&g_clock_ns, now_ns, __ATOMIC_RELEASE);
+    host_clock_broadcast();
+}
+
+// Due scenario events are applied at their exact virtual time, then the other threads
+// get a short real-time window to react before time moves on.
+void host_clock_advance(u64 ns) {
+    const u64 target = host_clock_now_ns() + ns;
+
+    if (g_clock_released) {
+        real_sleep_ns(ns);
+        return;
+    }
+
+    while (g_next_event_ns && g_next_event_ns() <= target) {
+        const u64 at = g_next_event_ns();
+
+        if (at > host_clock_now_ns()) {
+            host_clock_set(at);
+        }
+        g_run_events_until(at);
+        host_clock_broadcast();
+        real_sleep_ns(HOST_SETTLE_REAL_NS);
+    }
+
+    host_clock_set(target);
+    if (g_clock_speed > 0) {
+        real_sleep_ns(ns / g_clock_speed);
+    } else {
+        sched_yield();
+    }
+}
+
+void host_clock_wait_until(u64 deadline_ns, u64 real_cap_ns) {
+    const u64 real_deadline = real_now_ns() + real_cap_ns;
+    struct timespec ts;
+
+    pthread_mutex_lock(&g_clock_lock);
+    while (host_clock_now_ns() < deadline_ns && real_now_ns() < real_deadline) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_clock_cond, &g_clock_lock, &ts);
+    }
+    pthread_mutex_unlock(&g_clock_lock);
+}
+
+void host_clock_wait_change(u64 epoch, u64 deadline_ns, u64 real_cap_ns) {
+    const u64 real_deadline = real_now_ns() + real_cap_ns;
+    struct timespec ts;
+
+    pthread_mutex_lock(&g_clock_lock);
+    while (g_clock_epoch == epoch && host_clock_now_ns() < deadline_ns && real_now_ns() < real_deadline) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&g_clock_cond, &g_clock_lock, &ts);
+    }
+    pthread_mutex_unlock(&g_clock_lock);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdbool.h>
+#include <switch.h>
+
+#define HOST_MAX_PROCESSES 64
+#define HOST_MAX_TITLES 16
+#define HOST_TITLE_NAME_MAX 64
+
+typedef enum {
+    HostService_Sm = 0,
+    HostService_Fs,
+    HostService_Setsys,
+    HostService_Nifm,
+    HostService_Applet,
+    HostService_Psm,
+    HostService_Pmshell,
+    HostService_Pminfo,
+    HostService_Ns,
+    HostService_Socket,
+    HostService_Count,
+} HostService;
+
+typedef struct {
+    u64 pid;
+    u64 program_id;
+} HostProcess;
+
+// An installed title ns has control data (a NACP name) for.
+typedef struct {
+    u64 program_id;
+    char name[HOST_TITLE_NAME_MAX];
+} HostTitle;
+
+// What the fake services report. Only the driver thread mutates it (scenario events),
+// under host_world_lock; service calls copy out under the same lock.
+typedef struct {
+    u32 battery_percent;
+    PsmChargerType charger;
+    bool docked;
+    char firmware[16];
+    u64 app_pid; // 0 = no application running
+    HostProcess processes[HOST_MAX_PROCESSES];
+    u32 process_count;
+    u64 next_pid;
+    HostTitle titles[HOST_MAX_TITLES];
+    u32 title_count;
+    Result init_result[HostService_Count]; // returned by *Initialize
+    Result call_result[HostService_Count]; // returned by every other call of that service
+    u64 call_latency_ns[HostService_Count]; // each call spins this long, standing in for IPC
+    bool process_event_signaled;
+    u64 process_event_signal_count; // lets a waiter see a signal that was cleared again
+    u64 process_event_clear_ns; // the fake ns drains the event at this time
+    u64 service_calls[HostService_Count];
+} HostWorld;
+
+extern HostWorld g_host_world;
+
+void host_world_init(void);
+void host_world_add_process(u64 pid, u64 program_id);
+void host_world_remove_process(u64 pid);
+void host_world_add_title(u64 program_id, const char* name);
+void host_world_lock(void);
+void host_world_unlock(void);
+const char* host_service_name(HostService service);
+bool host_service_from_name(const char* name, HostService* out);
+
+// Run threads on the static stacks the sysmodule passes to threadCreate, painted so
+// host_thread_stack_peak can report the deepest use. Off by default: the host's libc and
+// the thread descriptor glibc places at the stack top need more room than the Switch.
+void host_thread_set_app_stacks(bool enabled);
+size_t host_thread_stack_peak(const Thread* t);
+
+// Hold times of every RMutex, outermost lock to matching unlock, in real nanoseconds.
+typedef struct {
+    u64 acquisitions;
+    u64 total_hold_ns;
+    u64 max_hold_ns;
+} HostLockStats;
+
+void host_lock_stats_enable(bool enabled);
+void host_lock_stats_reset(void);
+void host_lock_stats_get(HostLockStats* out);
+
+// Virtual clock. Only the driver thread (the one running richnx_main) moves it.
+void host_clock_set_driver(void);
+bool host_clock_is_driver(void);
+u64 host_clock_now_ns(void);
+void host_clock_advance(u64 ns);
+void host_clock_set_speed(u32 speed);
+void host_clock_release(void);
+void host_clock_wait_until(u64 deadline_ns, u64 real_cap_ns);
+// Counts broadcasts. Waiters read it before checking their condition and pass it to
+// host_clock_wait_change, which returns once another broadcast has happened.
+u64 host_clock_epoch(void);
+void host_clock_wait_change(u64 epoch, u64 deadline_ns, u64 real_cap_ns);
+void host_clock_broadcast(void);
+// The clock stops at each time next_event_ns reports and calls run_until before moving on.
+void host_clock_set_event_source(u64 (*next_event_ns)(void), void (*run_until)(u64 now_ns));
@@ -0,0 +1,185 @@
+#pragma once
+
+// Host stand-in for the subset of libnx the sysmodule uses. Services read a scriptable
+// world (host_sim.h), threads and locks are pthreads, sockets are the host's own, and
+// time is a virtual clock advanced by the driver thread's sleeps.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef u32 Result;
+typedef u32 Handle;
+
+#define MAKERESULT(module, description) ((((module) & 0x1FF)) | ((description) & 0x1FFF) << 9)
+#define R_SUCCEEDED(res) ((res) == 0)
+#define R_FAILED(res) ((res) != 0)
+#define R_VALUE(res) ((res) & 0x3FFFFF)
+#define R_MODULE(res) ((res) & 0x1FF)
+#define R_DESCRIPTION(res) (((res) >> 9) & 0x1FFF)
+
+#define Module_Kernel 1
+#define KernelError_TimedOut 117
+#define KERNELRESULT(desc) MAKERESULT(Module_Kernel, KernelError_##desc)
+#define Module_Libnx 345
+#define LibnxError_OutOfMemory 2
+#define LibnxError_NotFound 9
+
+// Ticks are nanoseconds on the host.
+u64 armGetSystemTick(void);
+static inline u64 armTicksToNs(u64 tick) {
+    return tick;
+}
+
+void svcSleepThread(s64 nano);
+Result svcGetProcessList(s32* num_out, u64* pids_out, u32 max_pids);
+
+typedef void (*ThreadFunc)(void*);
+
+typedef struct {
+    pthread_t handle;
+    ThreadFunc entry;
+    void* arg;
+    void* stack_mem;
+    size_t stack_sz;
+    bool painted; // ran on stack_mem, which was filled with a pattern first
+    bool started;
+} Thread;
+
+Result threadCreate(Thread* t, ThreadFunc entry, void* arg, void* stack_mem, size_t stack_sz, int prio, int cpuid);
+Result threadStart(Thread* t);
+Result threadWaitForExit(Thread* t);
+Result threadClose(Thread* t);
+
+typedef pthread_mutex_t Mutex;
+
+typedef struct {
+    pthread_mutex_t lock;
+    u32 depth;
+    u64 acquired_ns; // real time of the outermost acquisition, for host_lock_stats
+} RMutex;
+
+typedef struct {
+    pthread_cond_t cond;
+    u64 wake_epoch; // bumped by condvarWakeAll so a stepping driver notices missed wakes
+} CondVar;
+
+void mutexInit(Mutex* m);
+void mutexLock(Mutex* m);
+void mutexUnlock(Mutex* m);
+void rmutexInit(RMutex* m);
+void rmutexLock(RMutex* m);
+void rmutexUnlock(RMutex* m);
+void condvarInit(CondVar* c);
+Result condvarWaitTimeout(CondVar* c, Mutex* m, u64 timeout);
+Result condvarWakeAll(CondVar* c);
+
+typedef struct {
+    u32 id;
+    bool autoclear;
+} Event;
+
+Result eventWait(Event* t, u64 timeout);
+void eventClose(Event* t);
+
+typedef enum {
+    AppletType_None = -2,
+    AppletType_Default = -1,
+    AppletType_Application = 0,
+} AppletType;
+
+typedef enum {
+    AppletOperationMode_Handheld = 0,
+    AppletOperationMode_Console = 1,
+} AppletOperationMode;
+
+typedef enum {
+    PsmChargerType_Unconnected = 0,
+    PsmChargerType_EnoughPower = 1,
+    PsmChargerType_LowPower = 2,
+    PsmChargerType_NotSupported = 3,
+} PsmChargerType;
+
+typedef enum {
+    NifmServiceType_User = 0,
+    NifmServiceType_System = 1,
+    NifmServiceType_Admin = 2,
+} NifmServiceType;
+
+typedef struct {
+    u8 major;
+    u8 minor;
+    u8 micro;
+    u8 padding1;
+    u8 revision_major;
+    u8 revision_minor;
+    u8 padding2[2];
+    u32 platform;
+    char version_hash[0x40];
+    char display_version[0x18];
+    char display_title[0x80];
+} SetSysFirmwareVersion;
+
+typedef struct {
+    char name[0x200];
+    char author[0x100];
+} NacpLanguageEntry;
+
+// Only the language entries are modelled; the rest of the 0x4000-byte NACP is opaque.
+typedef struct {
+    NacpLanguageEntry lang[16];
+    u8 rest[0x4000 - 16 * sizeof(NacpLanguageEntry)];
+} NacpStruct;
+
+typedef struct {
+    NacpStruct nacp;
+    u8 icon[0x20000];
+} NsApplicationControlData;
+
+typedef enum {
+    NsApplicationControlSource_CacheOnly = 0,
+    NsApplicationControlSource_Storage = 1,
+    NsApplicationControlSource_StorageOnly = 2,
+} NsApplicationControlSource;
+
+Result smInitialize(void);
+void smExit(void);
+Result fsInitialize(void);
+void fsExit(void);
+Result fsdevMountSdmc(void);
+int fsdevUnmountAll(void);
+Result setsysInitialize(void);
+void setsysExit(void);
+Result setsysGetFirmwareVersion(SetSysFirmwareVersion* out);
+Result nifmInitialize(NifmServiceType service_type);
+void nifmExit(void);
+Result appletInitialize(void);
+void appletExit(void);
+AppletOperationMode appletGetOperationMode(void);
+Result appletGetOperationModeSystemInfo(u32* info);
+Result psmInitialize(void);
+void psmExit(void);
+Result psmGetBatteryChargePercentage(u32* out);
+Result psmGetChargerType(PsmChargerType* out);
+Result pmshellInitialize(void);
+void pmshellExit(void);
+Result pmshellGetApplicationProcessIdForShell(u64* pid_out);
+Result pmshellGetProcessEventHandle(Event* out);
+Result pminfoInitialize(void);
+void pminfoExit(void);
+Result pminfoGetProgramId(u64* program_id_out, u64 pid);
+Result nsInitialize(void);
+void nsExit(void);
+Result nsGetApplicationControlData(NsApplicationControlSource source, u64 application_id, NsApplicationControlData* buffer, size_t size, u64* actual_size);
+Result nacpGetLanguageEntry(NacpStruct* nacp, NacpLanguageEntry** langentry);
+Result socketInitializeDefault(void);
+void socketExit(void);
@@ -0,0 +1,574 @@
+#include <switch.h>
+
+#include "host_sim.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HOST_DRIVER_WAIT_STEP_NS (5ULL * 1000000ULL)
+#define HOST_DRIVER_POLL_REAL_NS 20000ULL
+#define HOST_OTHER_WAIT_REAL_NS (10ULL * 1000000ULL)
+#define PM_RESULT_PROCESS_NOT_FOUND MAKERESULT(15, 1)
+#define NS_RESULT_NO_CONTROL_DATA MAKERESULT(16, 1) // stand-in for "title not installed"
+#define HOST_STACK_PAINT 0xA5
+
+// libnx's allocator hooks, set by __libnx_initheap in main.c; unused on the host.
+void* fake_heap_start;
+void* fake_heap_end;
+
+static bool g_app_stacks;
+static bool g_lock_stats;
+static HostLockStats g_lock_totals;
+
+static u64 real_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+// Busy, like a thread blocked in an IPC round trip that the benchmark should see.
+static void host_spin_ns(u64 ns) {
+    const u64 until = real_now_ns() + ns;
+
+    while (real_now_ns() < until) {
+    }
+}
+
+static void real_deadline_after(struct timespec* ts, u64 ns) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += (time_t)(ns / 1000000000ULL);
+    ts->tv_nsec += (long)(ns % 1000000000ULL);
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static Result host_service_enter(HostService service) {
+    Result rc;
+    u64 latency_ns;
+
+    host_world_lock();
+    g_host_world.service_calls[service]++;
+    rc = g_host_world.call_result[service];
+    latency_ns = g_host_world.call_latency_ns[service];
+    host_world_unlock();
+    if (latency_ns != 0) {
+        host_spin_ns(latency_ns);
+    }
+    return rc;
+}
+
+static Result host_service_init(HostService service) {
+    Result rc;
+
+    host_world_lock();
+    g_host_world.service_calls[service]++;
+    rc = g_host_world.init_result[service];
+    host_world_unlock();
+    return rc;
+}
+
+u64 armGetSystemTick(void) {
+    return host_clock_now_ns();
+}
+
+void svcSleepThread(s64 nano) {
+    if (nano <= 0) {
+        sched_yield();
+        return;
+    }
+    if (host_clock_is_driver()) {
+        host_clock_advance((u64)nano);
+    } else {
+        host_clock_wait_until(host_clock_now_ns() + (u64)nano, (u64)nano);
+    }
+}
+
+Result svcGetProcessList(s32* num_out, u64* pids_out, u32 max_pids) {
+    u32 i;
+
+    host_world_lock();
+    for (i = 0; i < g_host_world.process_count && i < max_pids; i++) {
+        pids_out[i] = g_host_world.processes[i].pid;
+    }
+    *num_out = (s32)i;
+    host_world_unlock();
+    return 0;
+}
+
+static void* host_thread_trampoline(void* arg) {
+    Thread* t = (Thread*)arg;
+    t->entry(t->arg);
+    return NULL;
+}
+
+Result threadCreate(Thread* t, ThreadFunc entry, void* arg, void* stack_mem, size_t stack_sz, int prio, int cpuid) {
+    (void)stack_mem;
+    (void)stack_sz;
+    (void)prio;
+    (void)cpuid;
+
+    memset(t, 0, sizeof(*t));
+    t->entry = entry;
+    t->arg = arg;
+    t->stack_mem = stack_mem;
+    t->stack_sz = stack_sz;
+    return 0;
+}
+
+void host_thread_set_app_stacks(bool enabled) {
+    g_app_stacks = enabled;
+}
+
+Result threadStart(Thread* t) {
+    pthread_attr_t attr;
+    int err;
+
+    pthread_attr_init(&attr);
+    t->painted = false;
+    if (g_app_stacks && t->stack_mem && t->stack_sz >= (size_t)sysconf(_SC_THREAD_STACK_MIN)) {
+        memset(t->stack_mem, HOST_STACK_PAINT, t->stack_sz);
+        t->painted = pthread_attr_setstack(&attr, t->stack_mem, t->stack_sz) == 0;
+    }
+    err = pthread_create(&t->handle, &attr, host_thread_trampoline, t);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        return MAKERESULT(1, 1);
+    }
+    t->started = true;
+    return 0;
+}
+
+// Stacks grow down, so the untouched paint is at the low end.
+size_t host_thread_stack_peak(const Thread* t) {
+    const u8* stack = (const u8*)t->stack_mem;
+    size_t untouched = 0;
+
+    if (!t->painted) {
+        return 0;
+    }
+    while (untouched < t->stack_sz && stack[untouched] == HOST_STACK_PAINT) {
+        untouched++;
+    }
+    return t->stack_sz - untouched;
+}
+
+Result threadWaitForExit(Thread* t) {
+    if (t->started) {
+        pthread_join(t->handle, NULL);
+        t->started = false;
+    }
+    return 0;
+}
+
+// Closing a running thread (stop_detection_worker does) detaches it instead of joining.
+Result threadClose(Thread* t) {
+    if (t->started) {
+        pthread_detach(t->handle);
+        t->started = false;
+    }
+    return 0;
+}
+
+void mutexInit(Mutex* m) {
+    pthread_mutex_init(m, NULL);
+}
+
+void mutexLock(Mutex* m) {
+    pthread_mutex_lock(m);
+}
+
+void mutexUnlock(Mutex* m) {
+    pthread_mutex_unlock(m);
+}
+
+void rmutexInit(RMutex* m) {
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&m->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    m->depth = 0;
+    m->acquired_ns = 0;
+}
+
+void rmutexLock(RMutex* m) {
+    pthread_mutex_lock(&m->lock);
+    if (m->depth++ == 0 && g_lock_stats) {
+        m->acquired_ns = real_now_ns();
+    }
+}
+
+void rmutexUnlock(RMutex* m) {
+    if (--m->depth == 0 && g_lock_stats && m->acquired_ns != 0) {
+        const u64 held = real_now_ns() - m->acquired_ns;
+
+        __atomic_fetch_add(&g_lock_totals.acquisitions, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&g_lock_totals.total_hold_ns, held, __ATOMIC_RELAXED);
+        if (held > __atomic_load_n(&g_lock_totals.max_hold_ns, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&g_lock_totals.max_hold_ns, held, __ATOMIC_RELAXED);
+        }
+        m->acquired_ns = 0;
+    }
+    pthread_mutex_unlock(&m->lock);
+}
+
+void host_lock_stats_enable(bool enabled) {
+    g_lock_stats = enabled;
+}
+
+void host_lock_stats_reset(void) {
+    memset(&g_lock_totals, 0, sizeof(g_lock_totals));
+}
+
+void host_lock_stats_get(HostLockStats* out) {
+    out->acquisitions = __atomic_load_n(&g_lock_totals.acquisitions, __ATOMIC_RELAXED);
+    out->total_hold_ns = __atomic_load_n(&g_lock_totals.total_hold_ns, __ATOMIC_RELAXED);
+    out->max_hold_ns = __atomic_load_n(&g_lock_totals.max_hold_ns, __ATOMIC_RELAXED);
+}
+
+void condvarInit(CondVar* c) {
+    pthread_cond_init(&c->cond, NULL);
+    c->wake_epoch = 0;
+}
+
+// The driver owns the clock, so its timed waits step virtual time forward and return as
+// soon as a wake arrives. Other threads wait in short real slices; every caller re-checks
+// its predicate and its virtual deadline.
+Result condvarWaitTimeout(CondVar* c, Mutex* m, u64 timeout) {
+    struct timespec ts;
+
+    if (host_clock_is_driver()) {
+        const u64 start_epoch = c->wake_epoch;
+        u64 remaining = timeout;
+
+        while (remaining > 0) {
+            const u64 step = remaining < HOST_DRIVER_WAIT_STEP_NS ? remaining : HOST_DRIVER_WAIT_STEP_NS;
+
+            real_deadline_after(&ts, HOST_DRIVER_POLL_REAL_NS);
+            pthread_cond_timedwait(&c->cond, m, &ts);
+            if (c->wake_epoch != start_epoch) {
+                return 0;
+            }
+            pthread_mutex_unlock(m);
+            host_clock_advance(step);
+            pthread_mutex_lock(m);
+            remaining -= step;
+        }
+        return c->wake_epoch != start_epoch ? 0 : KERNELRESULT(TimedOut);
+    }
+
+    real_deadline_after(&ts, timeout < HOST_OTHER_WAIT_REAL_NS ? timeout : HOST_OTHER_WAIT_REAL_NS);
+    return pthread_cond_timedwait(&c->cond, m, &ts) == 0 ? 0 : KERNELRESULT(TimedOut);
+}
+
+Result condvarWakeAll(CondVar* c) {
+    c->wake_epoch++;
+    pthread_cond_broadcast(&c->cond);
+    return 0;
+}
+
+// Signaled now, or signaled and cleared again since the wait began: the kernel wakes
+// waiters on the signal even if ns drains the event right after.
+static bool host_process_event_signaled(u64 since_count) {
+    bool signaled;
+
+    host_world_lock();
+    signaled = g_host_world.process_event_signal_count != since_count ||
+        (g_host_world.process_event_signaled && host_clock_now_ns() < g_host_world.process_event_clear_ns);
+    host_world_unlock();
+    return signaled;
+}
+
+// Only pm's process event exists on the host.
+Result eventWait(Event* t, u64 timeout) {
+    const u64 deadline = host_clock_now_ns() + timeout;
+    struct timespec real_start;
+    struct timespec real_now;
+    u64 signal_count;
+
+    (void)t;
+    host_world_lock();
+    signal_count = g_host_world.process_event_signal_count;
+    host_world_unlock();
+
+    clock_gettime(CLOCK_MONOTONIC, &real_start);
+    while (1) {
+        // Sampled before the check so a signal applied in between still ends the wait.
+        const u64 epoch = host_clock_epoch();
+        u64 real_elapsed;
+
+        if (host_process_event_signaled(signal_count)) {
+            return 0;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &real_now);
+        real_elapsed = (u64)(real_now.tv_sec - real_start.tv_sec) * 1000000000ULL +
+            (u64)(real_now.tv_nsec - real_start.tv_nsec);
+        if (host_clock_now_ns() >= deadline || real_elapsed >= timeout) {
+            return KERNELRESULT(TimedOut);
+        }
+        host_clock_wait_change(epoch, deadline, HOST_OTHER_WAIT_REAL_NS);
+    }
+}
+
+void eventClose(Event* t) {
+    (void)t;
+}
+
+Result smInitialize(void) {
+    return host_service_init(HostService_Sm);
+}
+
+void smExit(void) {
+}
+
+Result fsInitialize(void) {
+    return host_service_init(HostService_Fs);
+}
+
+void fsExit(void) {
+}
+
+// sdmc:/ paths resolve relative to the working directory, so "sdmc:" is just a directory.
+Result fsdevMountSdmc(void) {
+    if (mkdir("sdmc:", 0777) != 0 && errno != EEXIST) {
+        return MAKERESULT(2, 1);
+    }
+    return 0;
+}
+
+int fsdevUnmountAll(void) {
+    return 0;
+}
+
+Result setsysInitialize(void) {
+    return host_service_init(HostService_Setsys);
+}
+
+void setsysExit(void) {
+}
+
+Result setsysGetFirmwareVersion(SetSysFirmwareVersion* out) {
+    const Result rc = host_service_enter(HostService_Setsys);
+    unsigned int major = 0, minor = 0, micro = 0;
+
+    if (R_FAILED(rc)) {
+        return rc;
+    }
+
+    memset(out, 0, sizeof(*out));
+    host_world_lock();
+    sscanf(g_host_world.firmware, "%u.%u.%u", &major, &minor, &micro);
+    snprintf(out->display_version, sizeof(out->display_version), "%s", g_host_world.firmware);
+    host_world_unlock();
+    out->major = (u8)major;
+    out->minor = (u8)minor;
+    out->micro = (u8)micro;
+    return 0;
+}
+
+Result nifmInitialize(NifmServiceType service_type) {
+    (void)service_type;
+    return host_service_init(HostService_Nifm);
+}
+
+void nifmExit(void) {
+}
+
+Result appletInitialize(void) {
+    return host_service_init(HostService_Applet);
+}
+
+void appletExit(void) {
+}
+
+AppletOperationMode appletGetOperationMode(void) {
+    AppletOperationMode mode;
+
+    host_world_lock();
+    mode = g_host_world.docked ? AppletOperationMode_Console : AppletOperationMode_Handheld;
+    host_world_unlock();
+    return mode;
+}
+
+Result appletGetOperationModeSystemInfo(u32* info) {
+    *info = 0;
+    return host_service_enter(HostService_Applet);
+}
+
+Result psmInitialize(void) {
+    return host_service_init(HostService_Psm);
+}
+
+void psmExit(void) {
+}
+
+Result psmGetBatteryChargePercentage(u32* out) {
+    const Result rc = host_service_enter(HostService_Psm);
+
+    if (R_SUCCEEDED(rc)) {
+        host_world_lock();
+        *out = g_host_world.battery_percent;
+        host_world_unlock();
+    }
+    return rc;
+}
+
+Result psmGetChargerType(PsmChargerType* out) {
+    const Result rc = host_service_enter(HostService_Psm);
+
+    if (R_SUCCEEDED(rc)) {
+        host_world_lock();
+        *out = g_host_world.charger;
+        host_world_unlock();
+    }
+    return rc;
+}
+
+Result pmshellInitialize(void) {
+    return host_service_init(HostService_Pmshell);
+}
+
+void pmshellExit(void) {
+}
+
+Result pmshellGetApplicationProcessIdForShell(u64* pid_out) {
+    Result rc = host_service_enter(HostService_Pmshell);
+
+    if (R_FAILED(rc)) {
+        return rc;
+    }
+
+    host_world_lock();
+    if (g_host_world.app_pid == 0) {
+        rc = PM_RESULT_PROCESS_NOT_FOUND;
+    } else {
+        *pid_out = g_host_world.app_pid;
+    }
+    host_world_unlock();
+    return rc;
+}
+
+Result pmshellGetProcessEventHandle(Event* out) {
+    const Result rc = host_service_enter(HostService_Pmshell);
+
+    if (R_SUCCEEDED(rc)) {
+        out->id = 1;
+        out->autoclear = false;
+    }
+    return rc;
+}
+
+Result pminfoInitialize(void) {
+    return host_service_init(HostService_Pminfo);
+}
+
+void pminfoExit(void) {
+}
+
+Result pminfoGetProgramId(u64* program_id_out, u64 pid) {
+    Result rc = host_service_enter(HostService_Pminfo);
+    u32 i;
+
+    if (R_FAILED(rc)) {
+        return rc;
+    }
+
+    rc = PM_RESULT_PROCESS_NOT_FOUND;
+    host_world_lock();
+    for (i = 0; i < g_host_world.process_count; i++) {
+        if (g_host_world.processes[i].pid == pid) {
+            *program_id_out = g_host_world.processes[i].program_id;
+            rc = 0;
+            break;
+        }
+    }
+    host_world_unlock();
+    return rc;
+}
+
+Result nsInitialize(void) {
+    return host_service_init(HostService_Ns);
+}
+
+void nsExit(void) {
+}
+
+// Stand-in icon: a JPEG start marker then bytes derived from the id, larger than one HTTP
+// send buffer so /icon has to stream it.
+#define HOST_ICON_SIZE 6000
+
+static void host_fill_icon(u8* icon, u64 application_id) {
+    static const u8 soi[] = { 0xFF, 0xD8, 0xFF, 0xE0 };
+    u64 x = application_id | 1;
+    size_t i;
+
+    memcpy(icon, soi, sizeof(soi));
+    for (i = sizeof(soi); i < HOST_ICON_SIZE; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        icon[i] = (u8)x;
+    }
+}
+
+Result nsGetApplicationControlData(NsApplicationControlSource source, u64 application_id, NsApplicationControlData* buffer, size_t size, u64* actual_size) {
+    Result rc = host_service_enter(HostService_Ns);
+    u32 i;
+
+    (void)source;
+    if (R_FAILED(rc)) {
+        return rc;
+    }
+    if (size < sizeof(NacpStruct)) {
+        return NS_RESULT_NO_CONTROL_DATA;
+    }
+
+    rc = NS_RESULT_NO_CONTROL_DATA;
+    host_world_lock();
+    for (i = 0; i < g_host_world.title_count; i++) {
+        if (g_host_world.titles[i].program_id == application_id) {
+            memset(&buffer->nacp, 0, sizeof(buffer->nacp));
+            snprintf(buffer->nacp.lang[0].name, sizeof(buffer->nacp.lang[0].name), "%s", g_host_world.titles[i].name);
+            *actual_size = sizeof(NacpStruct);
+            if (size >= sizeof(NacpStruct) + HOST_ICON_SIZE) {
+                host_fill_icon(buffer->icon, application_id);
+                *actual_size += HOST_ICON_SIZE;
+            }
+            rc = 0;
+            break;
+        }
+    }
+    host_world_unlock();
+    return rc;
+}
+
+// libnx picks the system language and falls back to the first non-empty entry; the host
+// has no system language, so only the fallback applies.
+Result nacpGetLanguageEntry(NacpStruct* nacp, NacpLanguageEntry** langentry) {
+    u32 i;
+
+    for (i = 0; i < 16; i++) {
+        if (nacp->lang[i].name[0] != '\0') {
+            *langentry = &nacp->lang[i];
+            return 0;
+        }
+    }
+    *langentry = NULL;
+    return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+}
+
+Result socketInitializeDefault(void) {
+    return host_service_init(HostService_Socket);
+}
+
+void socketExit(void) {
+}
@@ -0,0 +1,24 @@
+#!/bin/sh
+# Runs each scenario against a fresh simulated SD card. Usage: run_scenarios.sh BINARY SCENARIO...
+set -u
+
+bin="$1"
+shift
+failed=0
+
+for scenario in "$@"; do
+    workdir=$(mktemp -d)
+    echo "== $(basename "$scenario")"
+    if ! "$bin" --scenario "$scenario" --workdir "$workdir"; then
+        failed=$((failed + 1))
+        echo "-- log: $workdir/sdmc:/switch/switch-dcrpc/log.log"
+    else
+        rm -rf "$workdir"
+    fi
+done
+
+if [ "$failed" -ne 0 ]; then
+    echo "$failed scenario(s) failed"
+    exit 1
+fi
+echo "all scenarios passed"
@@ -0,0 +1,81 @@
+// Turns binary log segments (log.bin, log.1.bin, ...) back into the text log format. Files
+// are decoded in the order given, so pass the oldest segment first:
+//   log-decode log.3.bin log.2.bin log.1.bin log.bin
+
+#include "log_events.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define DECODE_PAYLOAD_MAX 65535
+
+static char g_payload[DECODE_PAYLOAD_MAX + 1];
+
+static void decode_record(const LogRecordHeader* header) {
+    const LogEventDesc* desc = log_event_desc(header->event);
+    char line[4096];
+
+    printf("[%llu s] [line=%lu] ", (unsigned long long)(header->time_ms / 1000ULL), (unsigned long)header->line);
+    if (header->event == LogEvent_Text) {
+        g_payload[header->payload_size] = '\0';
+        printf("%s\n", g_payload);
+    } else if (desc) {
+        u64 args[LOG_EVENT_MAX_ARGS];
+        u32 count = header->payload_size / sizeof(u64);
+
+        if (count > LOG_EVENT_MAX_ARGS) {
+            count = LOG_EVENT_MAX_ARGS;
+        }
+        memcpy(args, g_payload, count * sizeof(u64));
+        log_event_format(desc, args, count, line, sizeof(line));
+        printf("%s\n", line);
+    } else {
+        printf("log-decode: unknown event %u (%u bytes)\n", header->event, header->payload_size);
+    }
+}
+
+static int decode_file(const char* path) {
+    LogFileHeader file_header;
+    LogRecordHeader header;
+    FILE* f;
+    int result = 0;
+
+    f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "log-decode: cannot open %s\n", path);
+        return 1;
+    }
+    if (fread(&file_header, sizeof(file_header), 1, f) != 1 ||
+        file_header.magic != LOG_FILE_MAGIC ||
+        file_header.version != LOG_FILE_VERSION ||
+        file_header.record_header_size != sizeof(LogRecordHeader)) {
+        fprintf(stderr, "log-decode: %s is not a version %d RichNX binary log\n", path, LOG_FILE_VERSION);
+        fclose(f);
+        return 1;
+    }
+
+    while (fread(&header, sizeof(header), 1, f) == 1) {
+        if (fread(g_payload, 1, header.payload_size, f) != header.payload_size) {
+            fprintf(stderr, "log-decode: %s: truncated record at line %lu\n", path, (unsigned long)header.line);
+            result = 1;
+            break;
+        }
+        decode_record(&header);
+    }
+    fclose(f);
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    int result = 0;
+    int i;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s SEGMENT... (oldest first)\n", argv[0]);
+        return 2;
+    }
+    for (i = 1; i < argc; i++) {
+        result |= decode_file(argv[i]);
+    }
+    return result;
+}
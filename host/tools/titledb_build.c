@@ -0,0 +1,595 @@
+// Compiles TitleDB JSON packs (blawar/titledb, e.g. US.en.json) into the binary index read by
+// source/titledb_index.c. Packs are read in the order given; when several name the same
+// title, the first one wins:
+//   titledb-build titledb.bin US.en.json DE.de.json JP.ja.json
+// Looks a title up in a built index the way the sysmodule does:
+//   titledb-build --find titledb.bin 0100000000010000
+//
+// Like the Windows client's pack parser, any object carrying a title id and a name counts,
+// wherever it sits: "titleId", "title_id", "titleid", "tid" or "id" for the id, "name",
+// "title", "game" or "Name" for the name, and "iconUrl", "icon_url", "icon", "IconUrl",
+// "frontBoxArt" or "bannerUrl" for the icon. An object keyed by title id counts as well.
+// Only full 16-digit hex ids are accepted, so pack keys that are nsuIds are ignored.
+
+#include "titledb_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_DEPTH 64
+#define MAX_STRING_LEN 0xFFFF
+
+typedef struct {
+    u64 title_id;
+    u32 order; // insertion order, so the first pack wins after sorting
+    u32 name_offset;
+    u32 icon_offset;
+    u16 name_len;
+    u16 icon_len;
+} BuildEntry;
+
+// What one JSON object says about itself; the ranks pick the preferred key when several
+// are present (lower is better).
+typedef struct {
+    char* id;
+    char* name;
+    char* icon;
+    int id_rank;
+    int name_rank;
+    int icon_rank;
+} ObjectFields;
+
+typedef struct {
+    const char* path;
+    const char* start;
+    const char* p;
+    const char* end;
+    bool failed;
+} Parser;
+
+static const char* const k_id_keys[] = {"titleId", "title_id", "titleid", "tid", "id", NULL};
+static const char* const k_name_keys[] = {"name", "title", "game", "Name", NULL};
+static const char* const k_icon_keys[] = {"iconUrl", "icon_url", "icon", "IconUrl", "frontBoxArt", "bannerUrl", NULL};
+
+static BuildEntry* g_entries;
+static size_t g_entry_count;
+static size_t g_entry_cap;
+static char* g_pool;
+static size_t g_pool_size;
+static size_t g_pool_cap;
+
+static void* xrealloc(void* p, size_t size) {
+    p = realloc(p, size);
+    if (!p) {
+        fprintf(stderr, "titledb-build: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static bool parse_title_id(const char* text, u64* out) {
+    u64 value = 0;
+    int digits = 0;
+
+    if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        text += 2;
+    }
+    for (; *text; text++, digits++) {
+        const char c = *text;
+        u32 nibble;
+
+        if (c >= '0' && c <= '9') {
+            nibble = (u32)(c - '0');
+        } else if (c >= 'a' && c <= 'f') {
+            nibble = (u32)(c - 'a' + 10);
+        } else if (c >= 'A' && c <= 'F') {
+            nibble = (u32)(c - 'A' + 10);
+        } else {
+            return false;
+        }
+        value = (value << 4) | nibble;
+    }
+    if (digits != 16 || value == 0) {
+        return false;
+    }
+    *out = value;
+    return true;
+}
+
+static u32 pool_add(const char* s, size_t len) {
+    const u32 offset = (u32)g_pool_size;
+
+    if (g_pool_size + len > g_pool_cap) {
+        g_pool_cap = (g_pool_size + len) * 2;
+        g_pool = xrealloc(g_pool, g_pool_cap);
+    }
+    memcpy(g_pool + g_pool_size, s, len);
+    g_pool_size += len;
+    return offset;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static void add_entry(u64 title_id, const char* name, const char* icon) {
+    BuildEntry* e;
+    size_t name_len;
+
+    while (is_space(*name)) name++;
+    name_len = strlen(name);
+    while (name_len > 0 && is_space(name[name_len - 1])) name_len--;
+    if (name_len == 0) {
+        return;
+    }
+    while (icon && is_space(*icon)) icon++;
+
+    if (g_entry_count == g_entry_cap) {
+        g_entry_cap = g_entry_cap ? g_entry_cap * 2 : 4096;
+        g_entries = xrealloc(g_entries, g_entry_cap * sizeof(*g_entries));
+    }
+    e = &g_entries[g_entry_count];
+    memset(e, 0, sizeof(*e));
+    e->title_id = title_id;
+    e->order = (u32)g_entry_count;
+    g_entry_count++;
+    e->name_len = (u16)(name_len > MAX_STRING_LEN ? MAX_STRING_LEN : name_len);
+    e->name_offset = pool_add(name, e->name_len);
+    if (icon && *icon) {
+        const size_t icon_len = strlen(icon);
+
+        e->icon_len = (u16)(icon_len > MAX_STRING_LEN ? MAX_STRING_LEN : icon_len);
+        e->icon_offset = pool_add(icon, e->icon_len);
+    }
+}
+
+static void fields_free(ObjectFields* f) {
+    free(f->id);
+    free(f->name);
+    free(f->icon);
+}
+
+static int key_rank(const char* const* keys, const char* key) {
+    int i;
+
+    for (i = 0; keys[i]; i++) {
+        if (strcmp(keys[i], key) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Keeps value in *slot if key ranks better than what is there; frees it otherwise.
+static bool fields_offer(const char* const* keys, const char* key, char** value, char** slot, int* slot_rank) {
+    const int rank = key_rank(keys, key);
+
+    if (rank < 0 || (*slot && *slot_rank <= rank)) {
+        return false;
+    }
+    free(*slot);
+    *slot = *value;
+    *slot_rank = rank;
+    *value = NULL;
+    return true;
+}
+
+static void parse_fail(Parser* ps, const char* what) {
+    if (!ps->failed) {
+        fprintf(stderr, "titledb-build: %s: %s at byte %ld\n", ps->path, what, (long)(ps->p - ps->start));
+        ps->failed = true;
+    }
+    ps->p = ps->end;
+}
+
+static void skip_ws(Parser* ps) {
+    while (ps->p < ps->end && is_space(*ps->p)) {
+        ps->p++;
+    }
+}
+
+static char* buf_put(char* buf, size_t* len, size_t* cap, const char* bytes, size_t n) {
+    if (*len + n + 1 > *cap) {
+        *cap = (*len + n + 1) * 2;
+        buf = xrealloc(buf, *cap);
+    }
+    memcpy(buf + *len, bytes, n);
+    *len += n;
+    buf[*len] = '\0';
+    return buf;
+}
+
+static bool parse_hex4(Parser* ps, u32* out) {
+    u32 value = 0;
+    int i;
+
+    if (ps->end - ps->p < 4) {
+        return false;
+    }
+    for (i = 0; i < 4; i++) {
+        const char c = *ps->p++;
+
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= (u32)(c - '0');
+        else if (c >= 'a' && c <= 'f') value |= (u32)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') value |= (u32)(c - 'A' + 10);
+        else return false;
+    }
+    *out = value;
+    return true;
+}
+
+static size_t utf8_encode(u32 cp, char* out) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// Returns the decoded string (malloc'd), positioned after the closing quote.
+static char* parse_string(Parser* ps) {
+    char* buf = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+
+    ps->p++; // opening quote
+    buf = buf_put(buf, &len, &cap, "", 0);
+    while (ps->p < ps->end) {
+        const char* run = ps->p;
+        char c;
+
+        while (ps->p < ps->end && *ps->p != '"' && *ps->p != '\\') {
+            ps->p++;
+        }
+        buf = buf_put(buf, &len, &cap, run, (size_t)(ps->p - run));
+        if (ps->p >= ps->end) {
+            break;
+        }
+        c = *ps->p++;
+        if (c == '"') {
+            return buf;
+        }
+        if (ps->p >= ps->end) {
+            break;
+        }
+        c = *ps->p++;
+        switch (c) {
+            case 'b': buf = buf_put(buf, &len, &cap, "\b", 1); break;
+            case 'f': buf = buf_put(buf, &len, &cap, "\f", 1); break;
+            case 'n': buf = buf_put(buf, &len, &cap, "\n", 1); break;
+            case 'r': buf = buf_put(buf, &len, &cap, "\r", 1); break;
+            case 't': buf = buf_put(buf, &len, &cap, "\t", 1); break;
+            case 'u': {
+                char utf8[4];
+                u32 cp;
+                u32 low;
+
+                if (!parse_hex4(ps, &cp)) {
+                    free(buf);
+                    parse_fail(ps, "bad \\u escape");
+                    return NULL;
+                }
+                if (cp >= 0xD800 && cp < 0xDC00 && ps->end - ps->p >= 6 && ps->p[0] == '\\' && ps->p[1] == 'u') {
+                    ps->p += 2;
+                    if (!parse_hex4(ps, &low) || low < 0xDC00 || low >= 0xE000) {
+                        free(buf);
+                        parse_fail(ps, "bad surrogate pair");
+                        return NULL;
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                } else if (cp >= 0xD800 && cp < 0xE000) {
+                    cp = 0xFFFD;
+                }
+                buf = buf_put(buf, &len, &cap, utf8, utf8_encode(cp, utf8));
+                break;
+            }
+            default: buf = buf_put(buf, &len, &cap, &c, 1); break; // \" \\ \/
+        }
+    }
+    free(buf);
+    parse_fail(ps, "unterminated string");
+    return NULL;
+}
+
+static void parse_value(Parser* ps, int depth, char** out_string);
+
+// Adds the object as a title if it carries an id and a name; an object-valued member keyed
+// by a title id is added under that id.
+static void parse_object(Parser* ps, int depth, ObjectFields* f) {
+    memset(f, 0, sizeof(*f));
+    ps->p++; // {
+    skip_ws(ps);
+    if (ps->p < ps->end && *ps->p == '}') {
+        ps->p++;
+        return;
+    }
+    while (ps->p < ps->end) {
+        char* key;
+        u64 key_id;
+
+        skip_ws(ps);
+        if (ps->p >= ps->end || *ps->p != '"') {
+            parse_fail(ps, "expected a key");
+            return;
+        }
+        key = parse_string(ps);
+        if (!key) return;
+        skip_ws(ps);
+        if (ps->p >= ps->end || *ps->p != ':') {
+            free(key);
+            parse_fail(ps, "expected ':'");
+            return;
+        }
+        ps->p++;
+        skip_ws(ps);
+
+        if (ps->p < ps->end && *ps->p == '{') {
+            ObjectFields child;
+
+            if (depth + 1 >= MAX_DEPTH) {
+                free(key);
+                parse_fail(ps, "nesting too deep");
+                return;
+            }
+            parse_object(ps, depth + 1, &child);
+            if (child.name && parse_title_id(key, &key_id)) {
+                add_entry(key_id, child.name, child.icon);
+            }
+            fields_free(&child);
+        } else {
+            char* value = NULL;
+
+            parse_value(ps, depth, &value);
+            if (value &&
+                !fields_offer(k_id_keys, key, &value, &f->id, &f->id_rank) &&
+                !fields_offer(k_name_keys, key, &value, &f->name, &f->name_rank)) {
+                fields_offer(k_icon_keys, key, &value, &f->icon, &f->icon_rank);
+            }
+            free(value);
+        }
+        free(key);
+
+        skip_ws(ps);
+        if (ps->p < ps->end && *ps->p == ',') {
+            ps->p++;
+            continue;
+        }
+        if (ps->p < ps->end && *ps->p == '}') {
+            u64 id;
+
+            ps->p++;
+            if (f->id && f->name && parse_title_id(f->id, &id)) {
+                add_entry(id, f->name, f->icon);
+            }
+            return;
+        }
+        parse_fail(ps, "expected ',' or '}'");
+    }
+}
+
+// Strings are handed back through out_string (when not NULL); objects and arrays are
+// scanned for titles; numbers and literals are skipped.
+static void parse_value(Parser* ps, int depth, char** out_string) {
+    skip_ws(ps);
+    if (ps->p >= ps->end) {
+        parse_fail(ps, "unexpected end");
+        return;
+    }
+    if (depth >= MAX_DEPTH) {
+        parse_fail(ps, "nesting too deep");
+        return;
+    }
+    switch (*ps->p) {
+        case '"': {
+            char* s = parse_string(ps);
+
+            if (out_string) {
+                *out_string = s;
+            } else {
+                free(s);
+            }
+            return;
+        }
+        case '{': {
+            ObjectFields f;
+
+            parse_object(ps, depth + 1, &f);
+            fields_free(&f);
+            return;
+        }
+        case '[':
+            ps->p++;
+            skip_ws(ps);
+            if (ps->p < ps->end && *ps->p == ']') {
+                ps->p++;
+                return;
+            }
+            while (ps->p < ps->end) {
+                parse_value(ps, depth + 1, NULL);
+                skip_ws(ps);
+                if (ps->p < ps->end && *ps->p == ',') {
+                    ps->p++;
+                    continue;
+                }
+                if (ps->p < ps->end && *ps->p == ']') {
+                    ps->p++;
+                    return;
+                }
+                parse_fail(ps, "expected ',' or ']'");
+            }
+            return;
+        default:
+            while (ps->p < ps->end && *ps->p != ',' && *ps->p != '}' && *ps->p != ']' && !is_space(*ps->p)) {
+                ps->p++;
+            }
+            return;
+    }
+}
+
+static bool load_pack(const char* path) {
+    Parser ps;
+    char* data;
+    long size;
+    FILE* f;
+    const size_t before = g_entry_count;
+
+    f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "titledb-build: cannot open %s\n", path);
+        return false;
+    }
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        fprintf(stderr, "titledb-build: cannot size %s\n", path);
+        fclose(f);
+        return false;
+    }
+    data = xrealloc(NULL, (size_t)size + 1);
+    if (fread(data, 1, (size_t)size, f) != (size_t)size) {
+        fprintf(stderr, "titledb-build: cannot read %s\n", path);
+        free(data);
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+
+    ps.path = path;
+    ps.start = data;
+    ps.p = data;
+    ps.end = data + size;
+    ps.failed = false;
+    if (ps.end - ps.p >= 3 && memcmp(ps.p, "\xEF\xBB\xBF", 3) == 0) {
+        ps.p += 3;
+    }
+    parse_value(&ps, 0, NULL);
+    free(data);
+    if (ps.failed) {
+        return false;
+    }
+    printf("titledb-build: %s: %zu titles\n", path, g_entry_count - before);
+    return true;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    const BuildEntry* x = (const BuildEntry*)a;
+    const BuildEntry* y = (const BuildEntry*)b;
+
+    if (x->title_id != y->title_id) {
+        return x->title_id < y->title_id ? -1 : 1;
+    }
+    return x->order < y->order ? -1 : (x->order > y->order ? 1 : 0);
+}
+
+static int write_index(const char* path) {
+    TitleDbIndexHeader header;
+    size_t count = 0;
+    size_t i;
+    FILE* f;
+
+    qsort(g_entries, g_entry_count, sizeof(*g_entries), compare_entries);
+
+    f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "titledb-build: cannot create %s\n", path);
+        return 1;
+    }
+    for (i = 0; i < g_entry_count; i++) {
+        if (i == 0 || g_entries[i].title_id != g_entries[i - 1].title_id) {
+            count++;
+        }
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = TITLEDB_INDEX_MAGIC;
+    header.version = TITLEDB_INDEX_VERSION;
+    header.record_size = sizeof(TitleDbIndexRecord);
+    header.count = (u32)count;
+    header.strings_offset = (u32)(sizeof(header) + count * sizeof(TitleDbIndexRecord));
+    header.strings_size = (u32)g_pool_size;
+    fwrite(&header, sizeof(header), 1, f);
+
+    for (i = 0; i < g_entry_count; i++) {
+        TitleDbIndexRecord record;
+
+        if (i > 0 && g_entries[i].title_id == g_entries[i - 1].title_id) {
+            continue;
+        }
+        memset(&record, 0, sizeof(record));
+        record.title_id = g_entries[i].title_id;
+        record.name_offset = g_entries[i].name_offset;
+        record.name_len = g_entries[i].name_len;
+        record.icon_offset = g_entries[i].icon_offset;
+        record.icon_len = g_entries[i].icon_len;
+        fwrite(&record, sizeof(record), 1, f);
+    }
+    // Names of dropped duplicates stay in the pool; they are a small fraction of it.
+    fwrite(g_pool, 1, g_pool_size, f);
+    if (fclose(f) != 0) {
+        fprintf(stderr, "titledb-build: cannot write %s\n", path);
+        return 1;
+    }
+    printf("titledb-build: %s: %zu titles, %zu bytes\n", path, count,
+        (size_t)header.strings_offset + g_pool_size);
+    return 0;
+}
+
+static int find_title(const char* index_path, const char* id_text) {
+    TitleDbIndex index;
+    char name[512];
+    char icon[1024];
+    u64 title_id;
+
+    if (!parse_title_id(id_text, &title_id)) {
+        fprintf(stderr, "titledb-build: %s is not a 16-digit title id\n", id_text);
+        return 2;
+    }
+    if (!titledb_index_open(&index, index_path)) {
+        fprintf(stderr, "titledb-build: %s is not a version %d title index\n", index_path, TITLEDB_INDEX_VERSION);
+        return 1;
+    }
+    if (!titledb_index_find(&index, title_id, name, sizeof(name), icon, sizeof(icon))) {
+        titledb_index_close(&index);
+        printf("0x%016llX not found\n", (unsigned long long)title_id);
+        return 1;
+    }
+    titledb_index_close(&index);
+    printf("0x%016llX %s%s%s\n", (unsigned long long)title_id, name, icon[0] ? " " : "", icon);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    int i;
+
+    if (argc == 4 && strcmp(argv[1], "--find") == 0) {
+        return find_title(argv[2], argv[3]);
+    }
+    if (argc < 3 || argv[1][0] == '-') {
+        fprintf(stderr,
+            "usage: %s INDEX PACK.json... (first pack wins)\n"
+            "       %s --find INDEX TITLE_ID\n",
+            argv[0], argv[0]);
+        return 2;
+    }
+    for (i = 2; i < argc; i++) {
+        if (!load_pack(argv[i])) {
+            return 1;
+        }
+    }
+    return write_index(argv[1]);
+}
@@ -2,20 +2,79 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <switch.h>
 #include "telemetry.h"
 
+#define HTTP_MAX_CONNECTIONS 8
+#define HTTP_RECV_BUF_SIZE 1024
+#define HTTP_SEND_BUF_SIZE 4096
+
+typedef enum {
+    HttpConnState_Free = 0,
+    HttpConnState_Reading,
+    HttpConnState_Parked,  // long-poll waiting for a telemetry change
+    HttpConnState_Writing,
+    HttpConnState_Streaming, // /events subscriber, frames queued as telemetry events arrive
+} HttpConnState;
+
+typedef struct {
+    int fd;
+    volatile u32 state; // HttpConnState
+    u64 accepted_ms;
+    u64 last_activity_ms;
+    u64 request_start_ms;
+    u64 park_deadline_ms;
+    u64 park_since_seq;
+    u64 event_cursor; // last telemetry event seq queued to a streaming client
+    volatile u64 request_count;
+    volatile u64 bytes_in;
+    volatile u64 bytes_out;
+    volatile u32 last_service_ms;
+    volatile u32 max_service_ms;
+    bool keep_alive;
+    bool binary_state; // current request is /state.bin
+    u32 recv_len;
+    u32 request_len; // bytes of recv_buf taken by the request being answered
+    u32 send_len;
+    u32 send_off;
+    FILE* body_file;     // response body still to be read into send_buf (icons)
+    u32 body_remaining;
+    char recv_buf[HTTP_RECV_BUF_SIZE];
+    char send_buf[HTTP_SEND_BUF_SIZE];
+} HttpConnection;
+
 typedef struct {
     TelemetryState* telemetry;
     volatile bool running;
     Thread thread;
     int listen_fd;
+    int wake_fd;               // loopback UDP socket connected to itself; readable after a telemetry change
+    volatile u32 wake_pending; // a wake datagram is in flight and not yet drained
+    u64 watch_noted_ms;        // last time parked/streaming clients were reported as activity
     unsigned short port;
     volatile u64 accepted_count;
     volatile u64 request_count;
+    volatile u64 longpoll_count;
+    volatile u64 longpoll_wakeups;
+    volatile u64 rejected_count;
+    volatile u64 timeout_count;
+    volatile u64 head_timeout_count; // request heads not complete within the deadline (408)
+    volatile u64 reclaimed_count;    // idle keep-alive connections closed to admit a new one
+    volatile u64 not_modified_count;
+    volatile u64 state_cache_hits;
+    volatile u64 binary_state_count;
+    volatile u64 stream_count;
+    volatile u64 stream_events_sent;
+    volatile u64 icon_count;
+    volatile u64 icon_not_modified_count;
+    volatile u64 icon_pending_count; // 503s while an icon waits for extraction
+    volatile u32 active_connections;
+    volatile u32 peak_connections;
     volatile int last_errno;
     volatile int stage;
     volatile bool listening;
+    HttpConnection connections[HTTP_MAX_CONNECTIONS];
 } HttpServer;
 
 bool http_server_start(HttpServer* server, TelemetryState* telemetry, unsigned short port);
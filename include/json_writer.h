@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <switch.h>
+
+#define JSON_WRITER_MAX_DEPTH 8
+
+// Append-only JSON into a caller buffer, without printf. Commas between members and
+// array items are inserted automatically; raw text can be mixed in for framing (SSE
+// lines, HTTP heads). The first write that does not fit sets overflow, and nothing is
+// written after it, so callers check json_writer_finish instead of trusting the bytes.
+typedef struct {
+    char* out;
+    size_t size;
+    size_t len;
+    bool overflow;
+    bool after_key;
+    u32 depth;
+    u32 has_item; // bit n: the container at depth n already has a member
+} JsonWriter;
+
+// A position to roll back to, e.g. to drop a list entry that did not fit.
+typedef struct {
+    size_t len;
+    u32 depth;
+    u32 has_item;
+    bool after_key;
+} JsonWriterMark;
+
+void json_writer_init(JsonWriter* w, char* out, size_t size);
+// NUL-terminates and returns true if everything fit and every container was closed.
+bool json_writer_finish(JsonWriter* w);
+JsonWriterMark json_writer_mark(const JsonWriter* w);
+void json_writer_rewind(JsonWriter* w, JsonWriterMark mark);
+// Bytes still writable, keeping room for the terminating NUL.
+size_t json_writer_room(const JsonWriter* w);
+
+void json_raw(JsonWriter* w, const char* text);
+void json_raw_n(JsonWriter* w, const char* text, size_t len);
+void json_raw_u64(JsonWriter* w, u64 value);
+
+void json_object_begin(JsonWriter* w);
+void json_object_end(JsonWriter* w);
+void json_array_begin(JsonWriter* w);
+void json_array_end(JsonWriter* w);
+// key is written verbatim; it must not need escaping.
+void json_key(JsonWriter* w, const char* key);
+
+void json_string(JsonWriter* w, const char* text); // escaped, control bytes become spaces
+void json_u64(JsonWriter* w, u64 value);
+void json_u64_padded(JsonWriter* w, u64 value, u32 width); // right-aligned with spaces
+void json_s64(JsonWriter* w, s64 value);
+void json_hex(JsonWriter* w, u64 value, u32 digits); // "0x" + zero-padded uppercase, quoted
+void json_bool(JsonWriter* w, bool value);
+void json_null(JsonWriter* w);
+void json_tristate(JsonWriter* w, bool valid, bool value); // null unless valid
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <switch.h>
+
+// Binary log layout (log.bin), little-endian. Every segment starts with a LogFileHeader;
+// records follow back to back: a LogRecordHeader, then payload_size bytes. Text records
+// carry the formatted message without a newline; every other event carries payload_size / 8
+// u64 arguments, described by log_event_desc. New events are only ever appended.
+#define LOG_FILE_MAGIC 0x4C584E52u // "RNXL"
+#define LOG_FILE_VERSION 1
+#define LOG_EVENT_MAX_ARGS 12
+
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 record_header_size;
+} LogFileHeader;
+
+typedef struct {
+    u64 time_ms; // since boot
+    u32 line;    // same counter as the [line=N] prefix of the text log
+    u16 event;
+    u16 payload_size;
+} LogRecordHeader;
+
+typedef enum {
+    LogEvent_Text = 0,
+    LogEvent_Heartbeat = 1,
+    LogEvent_HeartbeatHttp = 2,
+    LogEvent_HeartbeatUdp = 3,
+    LogEvent_Title = 4,
+    LogEvent_Count
+} LogEventId;
+
+typedef enum {
+    LogArg_Dec,
+    LogArg_Seconds, // decimal with an "s" suffix
+    LogArg_Hex32,
+    LogArg_Hex64,
+    LogArg_Flags, // one "name=0|1" pair per entry of bit_names, bit 0 first
+} LogArgKind;
+
+typedef struct {
+    const char* name;
+    LogArgKind kind;
+    const char* const* bit_names; // LogArg_Flags only, NULL-terminated
+} LogArgDesc;
+
+typedef struct {
+    const char* name;
+    u32 arg_count;
+    LogArgDesc args[LOG_EVENT_MAX_ARGS];
+} LogEventDesc;
+
+// Bits of the Heartbeat "ready" argument.
+typedef enum {
+    LogReady_Sm = 1u << 0,
+    LogReady_Fs = 1u << 1,
+    LogReady_Setsys = 1u << 2,
+    LogReady_Applet = 1u << 3,
+    LogReady_Pmshell = 1u << 4,
+    LogReady_Pminfo = 1u << 5,
+    LogReady_Nifm = 1u << 6,
+    LogReady_Socket = 1u << 7,
+    LogReady_HttpStarted = 1u << 8,
+    LogReady_DetectorStarted = 1u << 9,
+    LogReady_DetectorRun = 1u << 10,
+    LogReady_DetectorAlive = 1u << 11,
+    LogReady_DetectorNs = 1u << 12,
+    LogReady_DetectorKill = 1u << 13,
+    LogReady_UncleanPrev = 1u << 14,
+} LogReadyBits;
+
+// NULL for LogEvent_Text and for ids this build does not know.
+const LogEventDesc* log_event_desc(u32 event);
+// Renders "name: arg=value ..." like a logger_write line body. Returns the length written,
+// truncating to fit.
+size_t log_event_format(const LogEventDesc* desc, const u64* args, u32 arg_count, char* out, size_t size);
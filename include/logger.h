@@ -2,7 +2,67 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <switch.h>
+#include "log_events.h"
 
+typedef enum {
+    LogLevel_Off = 0,
+    LogLevel_Error = 1,
+    LogLevel_Warn = 2,
+    LogLevel_Info = 3,
+    LogLevel_Debug = 4,
+} LogLevel;
+
+typedef enum {
+    LogSys_Boot = 0, // init, stages, shutdown, the logger itself
+    LogSys_Http,
+    LogSys_Udp,
+    LogSys_Detector, // detection worker, process events, title changes
+    LogSys_Telemetry, // sampling and heartbeats
+    LogSys_Count
+} LogSubsystem;
+
+// Calls above this level are compiled out, e.g. -DLOG_COMPILE_LEVEL=LogLevel_Info.
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LogLevel_Debug
+#endif
+
+// Runtime threshold per subsystem, Info by default. Read directly by LOG_ENABLED so a
+// filtered call costs one compare and never evaluates or formats its arguments.
+extern volatile u8 g_log_levels[LogSys_Count];
+
+#define LOG_ENABLED(level, sys) ((level) <= LOG_COMPILE_LEVEL && (level) <= g_log_levels[(sys)])
+#define LOG_AT(level, sys, ...) \
+    do { \
+        if (LOG_ENABLED(level, sys)) logger_write(__VA_ARGS__); \
+    } while (0)
+#define LOG_ERROR(sys, ...) LOG_AT(LogLevel_Error, sys, __VA_ARGS__)
+#define LOG_WARN(sys, ...) LOG_AT(LogLevel_Warn, sys, __VA_ARGS__)
+#define LOG_INFO(sys, ...) LOG_AT(LogLevel_Info, sys, __VA_ARGS__)
+#define LOG_DEBUG(sys, ...) LOG_AT(LogLevel_Debug, sys, __VA_ARGS__)
+#define LOG_EVENT(level, sys, event, args, count) \
+    do { \
+        if (LOG_ENABLED(level, sys)) logger_event((event), (args), (count)); \
+    } while (0)
+
+// Lines are formatted by the caller into a preallocated ring and written to the SD card
+// by a low-priority flusher thread, so logger_write never touches the filesystem and never
+// blocks. When the ring is full the line is dropped and counted; the flusher reports the
+// count in the log once there is room again. The log is rotated at 512 KiB, keeping four
+// segments. With log_binary.flag present it is written as log.bin records instead of text
+// (see log_events.h; host/tools/log_decode.c turns them back into text).
 void logger_set_enabled(bool enabled);
-void logger_write(const char* fmt, ...);
+// Reads logging.txt from the SD card: "level=<off|error|warn|info|debug>" for every
+// subsystem, then "<subsystem>=<level>" lines (boot, http, udp, detector, telemetry) to
+// override it. A missing file restores the defaults. Cheap enough to call periodically.
+void logger_load_config(void);
+// Starts the flusher; requires the SD card to be mounted. Returns false if the thread could
+// not be started, in which case lines are written synchronously by their callers.
+bool logger_start(void);
+// Drains everything queued so far and closes the log file. Call before unmounting sdmc.
+void logger_stop(void);
+// Unfiltered; prefer the LOG_* macros, which add a level and subsystem.
+void logger_write(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
 void logger_vwrite(const char* fmt, va_list args);
+// A fixed-argument event: a few bytes in binary mode, "name: arg=value ..." in text mode.
+void logger_event(LogEventId event, const u64* args, u32 arg_count);
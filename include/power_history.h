@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <switch.h>
+
+#define POWER_HISTORY_RAW_CAPACITY 150        // 5 minutes of 2 s power samples
+#define POWER_HISTORY_MINUTE_CAPACITY 60      // 1 hour of 1-minute aggregates
+#define POWER_HISTORY_TEN_MINUTE_CAPACITY 144 // 1 day of 10-minute aggregates
+
+// Battery and dock history in fixed, preallocated rings at three resolutions. Each power
+// sample goes into the raw ring and is folded into the open 1-minute bucket; a closed
+// minute is folded into the open 10-minute bucket, so downsampling costs O(1) per sample.
+// The discharge rate is tracked on insert as well: a moving average of the time each
+// percent takes while unplugged. Times are seconds since boot. Safe to call from any thread.
+typedef enum {
+    PowerSampleFlag_ChargingValid = 1 << 0,
+    PowerSampleFlag_Charging = 1 << 1,
+    PowerSampleFlag_DockedValid = 1 << 2,
+    PowerSampleFlag_Docked = 1 << 3,
+} PowerSampleFlag;
+
+typedef struct {
+    u32 time_sec;
+    u8 battery_percent; // 0xFF unknown
+    u8 flags;           // PowerSampleFlag
+    u16 reserved;
+} PowerSample;
+
+typedef struct {
+    u32 start_sec; // a multiple of the bucket width
+    u16 samples;
+    u16 battery_samples;
+    u32 battery_sum;
+    u8 battery_min;
+    u8 battery_max;
+    u8 battery_last;
+    u8 reserved;
+    u16 charging_samples;
+    u16 docked_samples;
+} PowerAggregate;
+
+// Called by telemetry_update with each power sample, outside its write section.
+void power_history_add(
+    u64 time_sec,
+    bool battery_valid,
+    u32 battery_percent,
+    bool charging_valid,
+    bool charging,
+    bool docked_valid,
+    bool docked
+);
+// /metrics/history: res_sec 60 or 600 selects an aggregate tier, anything else raw samples.
+// Entries stamped since_sec or later, oldest first, as many as fit in out; the returned
+// "next" is one past the last entry's time.
+void power_history_build_json(u64 res_sec, u64 since_sec, char* out, size_t out_size);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdbool.h>
+#include <switch.h>
+#include "telemetry.h"
+
+// Waits on pm's process lifecycle event and kicks a telemetry query on every launch/exit.
+typedef struct {
+    TelemetryState* telemetry;
+    volatile bool running;
+    Thread thread;
+    Event event;
+    volatile u64 wake_count;
+    volatile u64 kick_count;
+    volatile Result last_result;
+} ProcessWatch;
+
+// Requires pmshell to be initialized.
+bool process_watch_start(ProcessWatch* watch, TelemetryState* telemetry);
+void process_watch_stop(ProcessWatch* watch);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <switch.h>
+#include "telemetry.h"
+
+#define SESSION_JOURNAL_COMPACT_AT 512 // records in sessions.bin that trigger a compaction
+#define SESSION_JOURNAL_KEEP 256       // newest records a compaction leaves in place
+#define SESSION_TOTALS_CAPACITY 64     // titles in sessions_totals.bin; least recently played goes to "other"
+
+// Play sessions, one per stretch of a title being the active program. Each finished session
+// is appended as a fixed-size record to sessions.bin, so an append is one write at the end of
+// the file and record i sits at a computable offset. Once the file holds COMPACT_AT records,
+// all but the newest KEEP are folded into per-title totals (sessions_totals.bin) and dropped.
+// Record indices are global and never reused: the journal header remembers how many records
+// compaction has removed. Timestamps are seconds since boot, tagged with a boot counter the
+// journal keeps, since the sysmodule has no wall clock.
+typedef enum {
+    SessionRecordFlag_Shutdown = 1 << 0, // closed by the sysmodule exiting, not by a title change
+    SessionRecordFlag_Gap = 1 << 1,      // telemetry events were missed; the dock split is approximate
+} SessionRecordFlag;
+
+typedef struct {
+    u64 program_id;
+    u32 boot;
+    u32 start_sec;
+    u32 duration_sec;
+    u32 docked_sec; // part of duration_sec spent docked; the rest was handheld
+    u32 flags;      // SessionRecordFlag
+    u32 reserved;
+} SessionRecord;
+
+// Opens (or creates) the journal and bumps its boot counter; requires the SD card to be mounted.
+void session_journal_load(void);
+// Follows the telemetry event ring, closing and opening sessions on program changes and
+// splitting their time on dock changes. Call from the thread that runs telemetry_update.
+void session_journal_poll(TelemetryState* telemetry);
+// Appends the session in progress, flagged Shutdown, and closes the files.
+void session_journal_stop(void);
+// /history: records with an index above since, oldest first, as many as fit in out.
+void session_journal_build_json(u64 since, char* out, size_t out_size);
+// /history/totals: compacted per-title totals, most played first, as many as fit in out.
+void session_journal_build_totals_json(char* out, size_t out_size);
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <switch.h>
+
+#define STATUS_STAGE_MAX 32
+
+// The crash-detection record behind status.txt. The file keeps the familiar key=value text
+// but every field has a fixed width, so its size never changes: it is rewritten in place,
+// and only when a field differs from what is on the card. Liveness (uptime, heartbeat
+// count) lives in one fixed slot that is overwritten on its own.
+typedef struct {
+    char state[8]; // "RUNNING", "STOPPED"
+    char stage[STATUS_STAGE_MAX];
+    u64 session_id;
+    u32 last_rc;
+    bool sm, fs, setsys, applet, psm, pmshell, pminfo, nifm, socket;
+    bool detector_started, detector_running, detector_ns, kill_switch, detector_alive;
+    u64 detector_last_hb;
+    u64 detector_attempts;
+    u64 detector_ok;
+    u64 detector_fail;
+    u32 detector_streak;
+    u64 detector_cooldown_until;
+    u32 detector_last_rc;
+} StatusRecord;
+
+// True if the previous session's status.txt still says RUNNING. Call before the first
+// status_file_update of this session.
+bool status_file_previous_unclean(void);
+// Writes the whole record if it differs from the last one written; otherwise only the
+// liveness slot, a few dozen bytes at a fixed offset.
+void status_file_update(const StatusRecord* record, u64 uptime_sec, u64 heartbeats);
+void status_file_close(void);
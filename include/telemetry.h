@@ -5,8 +5,83 @@
 #include <stdint.h>
 #include <switch.h>
 
+#define TELEMETRY_EVENT_RING_SIZE 32
+#define TELEMETRY_RESPONSE_MAX 3072
+#define TELEMETRY_COUNTER_SLOTS 7
+#define TELEMETRY_PID_CACHE_SIZE 256 // power of two, 4x the process scan limit
+
+// /state.bin frame, all fields little-endian:
+//   0 u32 magic "RNXS"       4 u16 schema id          6 u16 frame length
+//   8 u64 seq               16 u64 change_seq        24 u64 started_sec
+//  32 u64 last_update_sec   40 u64 active_program_id
+//  48 u8 battery_percent (0xFF unknown)   49 u8 TelemetryFrameFlag bits
+//  50 u8 dock_detection_source            51 u8 detection_source
+//  52 u32 detection_fail_streak
+//  56 u32 results: psm charge, psm charger, dock, pm, pminfo, ns, svc
+//  84 u8 firmware length + UTF-8 bytes, then u8 active_game length + UTF-8 bytes
+// Bump the schema id whenever the fixed part changes.
+#define TELEMETRY_FRAME_MAGIC 0x53584E52u
+#define TELEMETRY_FRAME_SCHEMA_ID 1
+#define TELEMETRY_FRAME_FIXED_SIZE 84
+#define TELEMETRY_FRAME_MAX (TELEMETRY_FRAME_FIXED_SIZE + 2 + 31 + 255)
+
+typedef enum {
+    TelemetryFrameFlag_BatteryValid = 1 << 0,
+    TelemetryFrameFlag_ChargingValid = 1 << 1,
+    TelemetryFrameFlag_Charging = 1 << 2,
+    TelemetryFrameFlag_DockedValid = 1 << 3,
+    TelemetryFrameFlag_Docked = 1 << 4,
+    TelemetryFrameFlag_DetectionMode = 1 << 5,
+} TelemetryFrameFlag;
+
+typedef enum {
+    TelemetryEvent_ProgramChanged = 1,
+    TelemetryEvent_BatteryChanged = 2,
+    TelemetryEvent_PowerChanged = 3, // charging or dock flip
+    TelemetryEvent_DetectionFailing = 4,
+    TelemetryEvent_DetectionRecovered = 5,
+} TelemetryEventType;
+
+// PIDs are never reused within a boot, so a PID's program id never changes.
+typedef struct {
+    u64 pid; // 0 = empty slot
+    u64 program_id; // 0 = negative entry: not an application candidate
+    u32 scan_gen; // last scan that saw this PID
+} TelemetryPidEntry;
+
+// Headline fields captured at the moment the event was committed.
+typedef struct {
+    u64 seq;
+    u64 time_sec;
+    u64 program_id;
+    u32 type; // TelemetryEventType
+    u32 detection_fail_streak;
+    u8 battery_percent;
+    bool battery_percent_valid;
+    bool is_charging;
+    bool is_charging_valid;
+    bool is_docked;
+    bool is_docked_valid;
+} TelemetryEvent;
+
+// Called after a change is published, from the writing thread; must not block.
+typedef void (*TelemetryChangeHook)(void* arg);
+
+// Writers serialize on lock and publish through publish_seq (a seqlock: odd while a write is
+// in progress). Readers never take lock; they copy what they need and retry if publish_seq moved.
 typedef struct {
     RMutex lock;
+    u32 publish_seq;
+    Mutex change_lock;
+    CondVar change_cv;
+    TelemetryChangeHook change_hook; // guarded by change_lock
+    void* change_hook_arg;
+    // Field groups carry the seq_counter value of their last change; 0 means never set.
+    u64 seq_counter;
+    u64 identity_seq;  // firmware, active program
+    u64 power_seq;     // battery, charging, dock
+    u64 detection_seq; // detection results (plain counters excluded)
+    u64 change_seq;    // max(identity_seq, power_seq); what long-polls wait on
     u64 started_sec;
     u64 last_update_sec;
     u64 sample_count;
@@ -19,7 +94,18 @@ typedef struct {
     Result last_svc_result;
     u64 last_process_id;
     u32 detection_source; // 0=none, 1=pmdmnt, 2=svc_scan
-    u64 next_query_sec;
+    // Adaptive sampling, owned by the writer. Program queries run at query_interval_ms, which
+    // drops to the fast interval after a change and doubles while the title is stable.
+    u64 next_query_ms;
+    u64 next_power_ms;
+    u32 query_interval_ms;
+    bool query_enabled;  // last telemetry_update allowed pm queries
+    u32 query_kick;      // set by any thread to force an immediate fast query
+    u32 fast_queries_left; // queries still forced fast after a kick
+    bool event_driven;   // process events trigger queries; polling is only a watchdog
+    Mutex kick_lock;
+    CondVar kick_cv;     // wakes the sampling loop on a kick
+    u64 last_client_ms;  // last HTTP client activity, stored atomically by the server
     u64 pending_program_id;
     u8 pending_match_count;
     bool detection_mode;
@@ -39,9 +125,53 @@ typedef struct {
     Result last_psm_charge_result;
     Result last_psm_charger_result;
     Result last_dock_result;
+    // Fallback-scan cache, touched only by the thread running telemetry_update.
+    TelemetryPidEntry pid_cache[TELEMETRY_PID_CACHE_SIZE];
+    u32 pid_cache_used;
+    u32 pid_scan_gen;
+    volatile u64 pid_cache_hits;
+    volatile u64 pid_cache_misses;
+    u64 event_seq; // seq of the newest entry in events
+    TelemetryEvent events[TELEMETRY_EVENT_RING_SIZE];
+
+    // Pre-rendered full /state response, double-buffered. The writer re-renders the back
+    // buffer when a group seq moves and then flips response_front; per-sample counters sit
+    // in fixed-width slots and are patched in place every update. Each buffer has its own
+    // seqlock generation so readers can memcpy it without any lock.
+    Mutex render_lock; // serializes writers rendering into the back buffer
+    u32 response_front;
+    u32 response_gen[2];
+    u64 response_seq[2];
+    u32 response_head_len[2]; // status line + headers, without connection headers/terminator
+    u32 response_len[2];
+    u16 response_counter_offsets[2][TELEMETRY_COUNTER_SLOTS];
+    char response[2][TELEMETRY_RESPONSE_MAX];
 } TelemetryState;
 
 void telemetry_init(TelemetryState* state);
 void telemetry_set_firmware(TelemetryState* state, const char* firmware);
+void telemetry_set_active_game(TelemetryState* state, u64 program_id, const char* name);
 void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_battery_query, bool allow_dock_query);
+u64 telemetry_next_update_delay_ns(TelemetryState* state);
+void telemetry_note_client_activity(TelemetryState* state);
+void telemetry_request_query(TelemetryState* state);
+bool telemetry_wait_for_kick(TelemetryState* state, u64 timeout_ns);
+void telemetry_set_event_driven(TelemetryState* state, bool event_driven);
+bool telemetry_changed_since(TelemetryState* state, u64 since_seq);
+bool telemetry_wait_for_change(TelemetryState* state, u64 since_seq, u64 timeout_ns);
+// Registers the hook run on every change and event push (NULL clears it); one hook at a time.
+void telemetry_set_change_hook(TelemetryState* state, TelemetryChangeHook hook, void* arg);
+u64 telemetry_get_event_seq(TelemetryState* state);
+void telemetry_get_active_program(TelemetryState* state, u64* out_program_id, char* out_game, size_t game_size, Result* out_ns_result);
+size_t telemetry_read_events(TelemetryState* state, u64 after_seq, TelemetryEvent* out, size_t max_events, bool* out_gap);
+const char* telemetry_event_name(u32 type);
 void telemetry_build_json(TelemetryState* state, char* out, size_t out_size);
+size_t telemetry_copy_state_response(
+    TelemetryState* state,
+    const char* connection_headers,
+    char* out,
+    size_t out_size,
+    u64* out_seq
+);
+void telemetry_build_json_since(TelemetryState* state, u64 since_seq, char* out, size_t out_size, u64* out_etag_seq);
+size_t telemetry_build_frame(TelemetryState* state, u8* out, size_t out_size);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <switch.h>
+
+#define TITLE_ICONS_CAPACITY 128
+#define TITLE_ICONS_PENDING 4 // extractions queued for title_icons_service
+#define TITLE_ICON_PATH_MAX 64
+
+// Title icons (the JPEG in NACP control data), extracted once and kept on the SD card as
+// icons/<hash>.jpg, named by a 64-bit FNV-1a hash of their bytes. icons/index.bin maps
+// program ids to hashes, so a cached icon is served without touching ns again; the hash
+// doubles as the HTTP ETag. Titles without an icon are remembered there too. Extraction is
+// left to title_icons_service on the thread that owns the ns session. Safe to call from any thread.
+typedef enum {
+    TitleIconStatus_Found = 0,
+    TitleIconStatus_Missing, // the title has no icon, or ns is not available
+    TitleIconStatus_Queued,  // this call queued the extraction; whoever runs title_icons_service should be woken
+    TitleIconStatus_Pending, // already queued, or the queue is full; ask again later
+} TitleIconStatus;
+
+typedef struct {
+    u64 hash;
+    u32 size;
+    char path[TITLE_ICON_PATH_MAX];
+} TitleIcon;
+
+// Reads icons/index.bin; requires the SD card to be mounted.
+void title_icons_load(void);
+// Whether an icon that is not cached yet may be queued for extraction.
+void title_icons_set_ns_ready(bool ready);
+// Writes an icon taken from control data someone else already fetched (see title_names).
+void title_icons_store(u64 program_id, const u8* jpeg, size_t size);
+// Finds the cached icon; a title not seen yet is queued for extraction.
+TitleIconStatus title_icons_get(u64 program_id, TitleIcon* out);
+// Opens the file found by title_icons_get. NULL if it has gone missing from the card, in which
+// case the icon is forgotten and queued for extraction again.
+FILE* title_icons_open(u64 program_id, const TitleIcon* icon);
+// Extracts at most one queued icon from ns control data, no more often than every 250 ms,
+// and writes back index.bin after title_icons_open dropped an entry. Call from the thread
+// that owns the ns session.
+void title_icons_service(void);
+void title_icons_get_stats(u64* out_hits, u64* out_extractions);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <switch.h>
+
+#define TITLE_NAME_MAX 128 // bytes including the terminator; longer NACP names are truncated
+#define TITLE_NAMES_CAPACITY 32
+
+// Display names from the titles' NACP control data, kept in a small LRU that is persisted to
+// the SD card (title_names.bin), so a title seen before resolves with no ns IPC at all.
+// Safe to call from any thread; lookups never block on ns.
+
+// Reads the persisted cache; requires the SD card to be mounted. A missing or damaged file
+// leaves the cache empty.
+void title_names_load(void);
+// Copies the cached name of program_id into out and marks it most recently used. Memory only,
+// and never waits for a save to the SD card, so it is cheap enough to call inside a telemetry
+// write section.
+bool title_names_lookup(u64 program_id, char* out, size_t out_size);
+// Returns the cached name, fetching it first if it is not cached yet: from ns control data
+// when use_ns is set (ns must be initialized), else or failing that from the compiled
+// TitleDB index titledb.bin on the SD card, if there is one. A fetched name is inserted
+// (evicting the least recently used entry when full) and the cache is written back to the SD
+// card. *out_rc is the ns result on a miss and 0 on a hit.
+bool title_names_fetch(u64 program_id, bool use_ns, char* out, size_t out_size, Result* out_rc);
+void title_names_get_stats(u64* out_hits, u64* out_misses, u64* out_fetches, u64* out_index_hits);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <switch.h>
+
+// Compiled TitleDB (titledb.bin), little-endian, built from TitleDB JSON packs by
+// host/tools/titledb_build.c. A TitleDbIndexHeader, then count TitleDbIndexRecords of
+// record_size bytes sorted by title_id, then the string pool: names and icon URLs as UTF-8
+// without terminators, addressed by offset and length relative to strings_offset. Lookups
+// binary-search the records straight from the file, so memory use is independent of the
+// index size.
+#define TITLEDB_INDEX_MAGIC 0x49584E52u // "RNXI"
+#define TITLEDB_INDEX_VERSION 1
+
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 record_size;
+    u32 count;
+    u32 strings_offset;
+    u32 strings_size;
+    u32 reserved;
+} TitleDbIndexHeader;
+
+typedef struct {
+    u64 title_id;
+    u32 name_offset;
+    u32 icon_offset;
+    u16 name_len;
+    u16 icon_len; // 0 = no icon URL
+    u32 reserved;
+} TitleDbIndexRecord;
+
+typedef struct {
+    FILE* file;
+    TitleDbIndexHeader header;
+} TitleDbIndex;
+
+// Checks the header and keeps the file open; false if it is missing or not a valid index.
+bool titledb_index_open(TitleDbIndex* index, const char* path);
+void titledb_index_close(TitleDbIndex* index);
+// O(log n) record reads. Copies the name (and icon URL, when icon_url is not NULL) truncated
+// to fit; a title without an icon gets "".
+bool titledb_index_find(TitleDbIndex* index, u64 title_id, char* name, size_t name_size, char* icon_url, size_t icon_size);
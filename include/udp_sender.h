@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <switch.h>
+#include "telemetry.h"
+
+#define UDP_SENDER_DEFAULT_PORT 6030
+
+// Pushes the /state.bin frame as a datagram on every change, plus a keepalive.
+typedef struct {
+    TelemetryState* telemetry;
+    volatile bool running;
+    Thread thread;
+    int fd;
+    u32 target_addr; // network byte order; INADDR_BROADCAST for LAN broadcast
+    unsigned short port;
+    volatile u64 change_count;
+    volatile u64 keepalive_count;
+    volatile u64 send_error_count;
+    volatile int last_errno;
+} UdpSender;
+
+// target is a dotted IPv4 address (a subnet broadcast address works too) or "broadcast",
+// optionally followed by ":port".
+bool udp_sender_start(UdpSender* sender, TelemetryState* telemetry, const char* target);
+void udp_sender_stop(UdpSender* sender);
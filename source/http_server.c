@@ -1,13 +1,23 @@
 #include "http_server.h"
 
+#include "json_writer.h"
 #include "logger.h"
+#include "power_history.h"
+#include "session_journal.h"
+#include "title_icons.h"
+#include "title_names.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #define SERVER_STACK_SIZE (64 * 1024)
@@ -15,6 +25,20 @@
 #define SERVER_THREAD_CPUID -2
 #define ACCEPT_ERROR_REOPEN_THRESHOLD 32
 #define ACCEPT_ERRNO_NET_UNREACH 113
+#define LONGPOLL_MAX_WAIT_MS 30000
+#define LONGPOLL_CHECK_MS 50 // only without a wake socket, when parked clients must poll for changes
+#define SELECT_IDLE_MS 500    // longest select wait when no deadline is nearer
+#define HTTP_WATCH_NOTE_MS 10000 // well inside telemetry's client window; keeps the fast cadence for watchers
+#define HTTP_IO_TIMEOUT_MS 5000
+#define HTTP_HEAD_DEADLINE_MS 3000 // whole request head, however the bytes trickle in
+#define HTTP_KEEPALIVE_IDLE_MS 15000
+#define HTTP_RECLAIM_IDLE_MS 1000 // idle keep-alive connections older than this may be reclaimed
+#define HTTP_CONN_HEADERS_KEEP_ALIVE "Connection: keep-alive\r\nKeep-Alive: timeout=15\r\n" // keep in step with IDLE_MS
+#define HTTP_CONN_HEADERS_CLOSE "Connection: close\r\n"
+#define HTTP_KEEPALIVE_MAX_REQUESTS 1000
+#define SSE_KEEPALIVE_MS 15000
+#define SSE_EVENTS_PER_FILL 8
+#define ICON_CACHE_CONTROL "Cache-Control: public, max-age=86400\r\n"
 
 // Use static stack memory for sysmodule thread stability (avoid heap-backed stack alloc failures).
 static u8 g_http_thread_stack[SERVER_STACK_SIZE] __attribute__((aligned(0x1000)));
@@ -32,7 +56,7 @@ static bool http_server_open_listen_socket(HttpServer* server) {
     if (server->listen_fd < 0) {
         server->last_errno = errno;
         server->stage = -1;
-        logger_write("http: socket failed errno=%d", errno);
+        LOG_ERROR(LogSys_Http, "http: socket failed errno=%d", errno);
         return false;
     }
 
@@ -45,17 +69,17 @@ static bool http_server_open_listen_socket(HttpServer* server) {
     if (bind(server->listen_fd, (const struct sockaddr*)&addr, sizeof(addr)) < 0) {
         server->last_errno = errno;
         server->stage = -2;
-        logger_write("http: bind failed errno=%d", errno);
+        LOG_ERROR(LogSys_Http, "http: bind failed errno=%d", errno);
         close(server->listen_fd);
         server->listen_fd = -1;
         return false;
     }
 
     server->stage = 3; // listening
-    if (listen(server->listen_fd, 4) < 0) {
+    if (listen(server->listen_fd, HTTP_MAX_CONNECTIONS) < 0) {
         server->last_errno = errno;
         server->stage = -3;
-        logger_write("http: listen failed errno=%d", errno);
+        LOG_ERROR(LogSys_Http, "http: listen failed errno=%d", errno);
         close(server->listen_fd);
         server->listen_fd = -1;
         return false;
@@ -63,162 +87,1086 @@ static bool http_server_open_listen_socket(HttpServer* server) {
 
     server->listening = true;
     server->stage = 4; // serving
-    logger_write("http: listening on 0.0.0.0:%u", server->port);
+    LOG_INFO(LogSys_Http, "http: listening on 0.0.0.0:%u", server->port);
     return true;
 }
 
-static void send_http_json(int client_fd, const char* json_body) {
-    char response[4096];
-    const int body_len = (int)strlen(json_body);
+// A datagram to itself makes the socket readable, so a telemetry change ends the select wait.
+// Only the first change before the server drains the socket sends one.
+static void http_server_wake(void* arg) {
+    HttpServer* server = (HttpServer*)arg;
+
+    if (server->wake_fd >= 0 && !__atomic_exchange_n(&server->wake_pending, 1, __ATOMIC_ACQ_REL)) {
+        send(server->wake_fd, "w", 1, MSG_DONTWAIT);
+    }
+}
+
+static bool http_server_open_wake_socket(HttpServer* server) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        LOG_WARN(LogSys_Http, "http: wake socket failed errno=%d, parked clients will poll", errno);
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(fd, (const struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        getsockname(fd, (struct sockaddr*)&addr, &addr_len) < 0 ||
+        connect(fd, (const struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        LOG_WARN(LogSys_Http, "http: wake socket setup failed errno=%d, parked clients will poll", errno);
+        close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    server->wake_fd = fd;
+    telemetry_set_change_hook(server->telemetry, http_server_wake, server);
+    return true;
+}
+
+static void http_server_close_wake_socket(HttpServer* server) {
+    if (server->wake_fd < 0) {
+        return;
+    }
+    telemetry_set_change_hook(server->telemetry, NULL, NULL);
+    close(server->wake_fd);
+    server->wake_fd = -1;
+}
+
+// Clear the flag first: a change published after this point sends a fresh datagram.
+static void http_server_drain_wake(HttpServer* server) {
+    char buf[16];
+
+    __atomic_store_n(&server->wake_pending, 0, __ATOMIC_RELEASE);
+    while (recv(server->wake_fd, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+    }
+}
+
+static u64 ms_since_boot_now(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000ULL;
+}
+
+static const char* http_conn_state_name(u32 state) {
+    switch (state) {
+        case HttpConnState_Reading: return "reading";
+        case HttpConnState_Parked: return "parked";
+        case HttpConnState_Writing: return "writing";
+        case HttpConnState_Streaming: return "streaming";
+        default: return "free";
+    }
+}
+
+// Constant so the cached /state response can be spliced without formatting.
+static const char* http_conn_headers(const HttpConnection* conn) {
+    return conn->keep_alive ? HTTP_CONN_HEADERS_KEEP_ALIVE : HTTP_CONN_HEADERS_CLOSE;
+}
+
+static void http_conn_queue_response(
+    HttpConnection* conn,
+    const char* status,
+    const char* content_type,
+    const char* extra_headers,
+    const char* body,
+    size_t body_len
+) {
+    int len;
+
+    len = snprintf(
+        conn->send_buf,
+        sizeof(conn->send_buf),
+        "HTTP/1.1 %s\r\n"
+        "%s%s%s"
+        "%s"
+        "Access-Control-Allow-Origin: *\r\n"
+        "%s"
+        "Content-Length: %u\r\n"
+        "\r\n",
+        status,
+        content_type ? "Content-Type: " : "",
+        content_type ? content_type : "",
+        content_type ? "\r\n" : "",
+        extra_headers ? extra_headers : "",
+        http_conn_headers(conn),
+        (unsigned int)body_len
+    );
+
+    if (len < 0 || (size_t)len >= sizeof(conn->send_buf) ||
+        (body && (size_t)len + body_len > sizeof(conn->send_buf))) {
+        // Never send less than Content-Length promises; a cut JSON body is no use anyway.
+        LOG_WARN(LogSys_Http, "http: %s response with %u byte body does not fit", status, (unsigned int)body_len);
+        len = snprintf(
+            conn->send_buf,
+            sizeof(conn->send_buf),
+            "HTTP/1.1 500 Internal Server Error\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "%s"
+            "Content-Length: 0\r\n"
+            "\r\n",
+            http_conn_headers(conn)
+        );
+        body_len = 0;
+    } else if (!body) {
+        // Headers only; the caller streams body_len bytes from body_file.
+        body_len = 0;
+    }
+    if (body_len > 0) {
+        memcpy(conn->send_buf + len, body, body_len);
+    }
+    conn->send_len = (u32)((size_t)len + body_len);
+    conn->send_off = 0;
+    conn->state = HttpConnState_Writing;
+}
 
+static void http_conn_queue_json(HttpConnection* conn, const char* json_body) {
+    http_conn_queue_response(conn, "200 OK", "application/json", NULL, json_body, strlen(json_body));
+}
+
+static void http_conn_queue_not_found(HttpConnection* conn) {
+    http_conn_queue_response(conn, "404 Not Found", NULL, NULL, "", 0);
+}
+
+// Case-insensitive lookup of a header value inside the request head.
+static const char* http_find_header(const char* head, size_t head_len, const char* name, size_t* value_len) {
+    const size_t name_len = strlen(name);
+    const char* end = head + head_len;
+    const char* line = memchr(head, '\n', head_len);
+
+    while (line && line + 1 < end) {
+        const char* p = line + 1;
+        const char* eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) break;
+        if ((size_t)(eol - p) > name_len && strncasecmp(p, name, name_len) == 0 && p[name_len] == ':') {
+            p += name_len + 1;
+            while (p < eol && (*p == ' ' || *p == '\t')) p++;
+            *value_len = (size_t)(eol - p);
+            while (*value_len > 0 && (p[*value_len - 1] == '\r' || p[*value_len - 1] == ' ')) (*value_len)--;
+            return p;
+        }
+        line = eol;
+    }
+    return NULL;
+}
+
+static bool http_value_has_token(const char* value, size_t value_len, const char* token) {
+    const size_t token_len = strlen(token);
+    size_t i;
+
+    for (i = 0; i + token_len <= value_len; i++) {
+        if (strncasecmp(value + i, token, token_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses "<name>=<digits>" from the query string of the request line only.
+static bool http_query_u64(const char* req, const char* name, u64* out) {
+    const size_t name_len = strlen(name);
+    const char* p = req;
+    const char* line_end = strpbrk(req, " \r\n");
+    u64 value = 0;
+    bool have_digit = false;
+
+    // Skip the method token; the request target ends at the next space.
+    if (!line_end || *line_end != ' ') return false;
+    p = line_end + 1;
+    line_end = strpbrk(p, " \r\n");
+    if (!line_end) return false;
+
+    p = memchr(p, '?', (size_t)(line_end - p));
+    while (p && p < line_end) {
+        p++;
+        if ((size_t)(line_end - p) > name_len && strncmp(p, name, name_len) == 0 && p[name_len] == '=') {
+            p += name_len + 1;
+            while (p < line_end && *p >= '0' && *p <= '9') {
+                value = value * 10 + (u64)(*p - '0');
+                have_digit = true;
+                p++;
+            }
+            if (have_digit) {
+                *out = value;
+            }
+            return have_digit;
+        }
+        p = memchr(p, '&', (size_t)(line_end - p));
+    }
+    return false;
+}
+
+// The frame is always a full snapshot; since/wait only decide when it is sent.
+static void server_queue_state_frame(HttpServer* server, HttpConnection* conn) {
+    u8 frame[TELEMETRY_FRAME_MAX];
+    size_t frame_len = telemetry_build_frame(server->telemetry, frame, sizeof(frame));
+
+    server->binary_state_count++;
+    http_conn_queue_response(conn, "200 OK", "application/octet-stream", NULL, (const char*)frame, frame_len);
+}
+
+// Answers /state, as a delta when since is non-zero, or 304 when If-None-Match still matches.
+// The weak ETag covers the group seqs only; per-sample counters may differ under the same tag.
+static void server_queue_state(HttpServer* server, HttpConnection* conn, u64 since) {
+    char json_body[2048];
+    char etag[48];
+    char etag_header[64];
+    const char* value;
+    size_t value_len = 0;
+    size_t cached_len;
+    u64 etag_seq = 0;
+
+    if (conn->binary_state) {
+        server_queue_state_frame(server, conn);
+        return;
+    }
+
+    value = http_find_header(conn->recv_buf, conn->request_len, "If-None-Match", &value_len);
+
+    // Full snapshots come straight from the pre-rendered response; deltas and revalidations render.
+    if (since == 0 && !value) {
+        cached_len = telemetry_copy_state_response(
+            server->telemetry,
+            http_conn_headers(conn),
+            conn->send_buf,
+            sizeof(conn->send_buf),
+            NULL
+        );
+        if (cached_len > 0) {
+            server->state_cache_hits++;
+            conn->send_len = (u32)cached_len;
+            conn->send_off = 0;
+            conn->state = HttpConnState_Writing;
+            return;
+        }
+    }
+
+    telemetry_build_json_since(server->telemetry, since, json_body, sizeof(json_body), &etag_seq);
     snprintf(
-        response,
-        sizeof(response),
+        etag,
+        sizeof(etag),
+        "W/\"%llu-%llu-%llu\"",
+        (unsigned long long)server->telemetry->started_sec,
+        (unsigned long long)etag_seq,
+        (unsigned long long)since
+    );
+    snprintf(etag_header, sizeof(etag_header), "ETag: %s\r\n", etag);
+
+    if (value && http_value_has_token(value, value_len, etag)) {
+        server->not_modified_count++;
+        http_conn_queue_response(conn, "304 Not Modified", NULL, etag_header, "", 0);
+        return;
+    }
+
+    http_conn_queue_response(conn, "200 OK", "application/json", etag_header, json_body, strlen(json_body));
+}
+
+static void http_conn_close_body(HttpConnection* conn) {
+    if (conn->body_file) {
+        fclose(conn->body_file);
+        conn->body_file = NULL;
+    }
+    conn->body_remaining = 0;
+}
+
+// Tops send_buf up from body_file after send_len; false if the file ends early or fails.
+static bool http_conn_fill_body(HttpConnection* conn) {
+    const size_t room = sizeof(conn->send_buf) - conn->send_len;
+    const size_t want = conn->body_remaining < room ? conn->body_remaining : room;
+    size_t got;
+
+    if (want == 0) {
+        return true;
+    }
+    got = fread(conn->send_buf + conn->send_len, 1, want, conn->body_file);
+    conn->send_len += (u32)got;
+    conn->body_remaining -= (u32)got;
+    if (conn->body_remaining == 0) {
+        http_conn_close_body(conn);
+    }
+    return got == want;
+}
+
+static void server_close_conn(HttpServer* server, HttpConnection* conn) {
+    http_conn_close_body(conn);
+    if (conn->fd >= 0) {
+        close(conn->fd);
+    }
+    conn->fd = -1;
+    conn->state = HttpConnState_Free;
+    conn->recv_len = 0;
+    conn->request_len = 0;
+    conn->send_len = 0;
+    conn->send_off = 0;
+    if (server->active_connections > 0) {
+        server->active_connections--;
+    }
+}
+
+// Appends at send_len; returns false (leaving the buffer untouched) if the text does not fit.
+static bool http_conn_append(HttpConnection* conn, const char* fmt, ...) {
+    const size_t room = sizeof(conn->send_buf) - conn->send_len;
+    va_list args;
+    int len;
+
+    va_start(args, fmt);
+    len = vsnprintf(conn->send_buf + conn->send_len, room, fmt, args);
+    va_end(args);
+    if (len < 0 || (size_t)len >= room) {
+        return false;
+    }
+    conn->send_len += (u32)len;
+    return true;
+}
+
+static bool server_stream_append_state(HttpServer* server, HttpConnection* conn, const char* event_name) {
+    char json_body[2048];
+    telemetry_build_json(server->telemetry, json_body, sizeof(json_body));
+    return http_conn_append(conn, "event: %s\ndata: %s\n\n", event_name, json_body);
+}
+
+// Appends one SSE frame at send_len; returns false (leaving the buffer untouched) if it does not fit.
+static bool server_stream_append_event(HttpConnection* conn, const TelemetryEvent* ev) {
+    JsonWriter w;
+
+    json_writer_init(&w, conn->send_buf + conn->send_len, sizeof(conn->send_buf) - conn->send_len);
+    json_raw(&w, "id: ");
+    json_raw_u64(&w, ev->seq);
+    json_raw(&w, "\nevent: ");
+    json_raw(&w, telemetry_event_name(ev->type));
+    json_raw(&w, "\ndata: ");
+    json_object_begin(&w);
+    json_key(&w, "seq");
+    json_u64(&w, ev->seq);
+    json_key(&w, "time_sec");
+    json_u64(&w, ev->time_sec);
+    json_key(&w, "active_program_id");
+    json_hex(&w, ev->program_id, 16);
+    json_key(&w, "battery_percent");
+    if (ev->battery_percent_valid) {
+        json_u64(&w, ev->battery_percent);
+    } else {
+        json_null(&w);
+    }
+    json_key(&w, "is_charging");
+    json_tristate(&w, ev->is_charging_valid, ev->is_charging);
+    json_key(&w, "is_docked");
+    json_tristate(&w, ev->is_docked_valid, ev->is_docked);
+    json_key(&w, "detection_fail_streak");
+    json_u64(&w, ev->detection_fail_streak);
+    json_object_end(&w);
+    json_raw(&w, "\n\n");
+    if (!json_writer_finish(&w)) {
+        return false;
+    }
+    conn->send_len += (u32)w.len;
+    return true;
+}
+
+// Queues pending telemetry events (or a keepalive comment) once the previous frame is flushed.
+// Events stay in the telemetry ring until sent, so a slow subscriber never stalls the writer.
+static void server_stream_fill(HttpServer* server, HttpConnection* conn, u64 now_ms) {
+    TelemetryEvent events[SSE_EVENTS_PER_FILL];
+    bool gap = false;
+    size_t count;
+    size_t i;
+
+    if (conn->send_off < conn->send_len) {
+        return;
+    }
+    conn->send_len = 0;
+    conn->send_off = 0;
+
+    count = telemetry_read_events(server->telemetry, conn->event_cursor, events, SSE_EVENTS_PER_FILL, &gap);
+    if (gap) {
+        // Fell behind the ring: resend the whole state and continue from the newest event.
+        conn->event_cursor = telemetry_get_event_seq(server->telemetry);
+        server_stream_append_state(server, conn, "resync");
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (!server_stream_append_event(conn, &events[i])) {
+            break;
+        }
+        conn->event_cursor = events[i].seq;
+        server->stream_events_sent++;
+    }
+
+    if (conn->send_len == 0 && now_ms - conn->last_activity_ms >= SSE_KEEPALIVE_MS) {
+        http_conn_append(conn, ": keepalive\n\n");
+    }
+}
+
+static void server_start_event_stream(HttpServer* server, HttpConnection* conn) {
+    const char* value;
+    size_t value_len = 0;
+    u64 last_event_id = 0;
+
+    // Resume after Last-Event-ID when reconnecting; events older than the ring trigger a resync.
+    value = http_find_header(conn->recv_buf, conn->request_len, "Last-Event-ID", &value_len);
+    if (value && value_len > 0) {
+        last_event_id = strtoull(value, NULL, 10);
+        conn->event_cursor = last_event_id;
+    } else {
+        conn->event_cursor = telemetry_get_event_seq(server->telemetry);
+    }
+
+    conn->keep_alive = false;
+    conn->send_len = 0;
+    conn->send_off = 0;
+    http_conn_append(
+        conn,
         "HTTP/1.1 200 OK\r\n"
-        "Content-Type: application/json\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
         "Access-Control-Allow-Origin: *\r\n"
         "Connection: close\r\n"
-        "Content-Length: %d\r\n"
         "\r\n"
-        "%s",
-        body_len,
-        json_body
+        "retry: 2000\n\n"
     );
+    if (!value) {
+        server_stream_append_state(server, conn, "state");
+    }
 
-    send(client_fd, response, strlen(response), 0);
+    conn->recv_len = 0;
+    conn->request_len = 0;
+    conn->state = HttpConnState_Streaming;
+    server->stream_count++;
 }
 
-static void send_http_not_found(int client_fd) {
-    static const char response[] =
-        "HTTP/1.1 404 Not Found\r\n"
-        "Connection: close\r\n"
-        "Content-Length: 0\r\n"
-        "\r\n";
-    send(client_fd, response, sizeof(response) - 1, 0);
+// Parses the 16 hex digit program id (optional 0x) that ends the path of a /icon/ request.
+static bool http_parse_program_id(const char* p, u64* out) {
+    u64 value = 0;
+    int digits = 0;
+
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) p += 2;
+    for (; digits < 16; digits++, p++) {
+        const char c = *p;
+        u64 nibble;
+
+        if (c >= '0' && c <= '9') nibble = (u64)(c - '0');
+        else if (c >= 'a' && c <= 'f') nibble = (u64)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') nibble = (u64)(c - 'A' + 10);
+        else break;
+        value = (value << 4) | nibble;
+    }
+    if (digits != 16 || (*p != ' ' && *p != '?') || value == 0) {
+        return false;
+    }
+    *out = value;
+    return true;
 }
 
-static void server_handle_client(HttpServer* server, int client_fd) {
-    char req_buf[1024];
-    int recv_len = recv(client_fd, req_buf, sizeof(req_buf) - 1, 0);
-    if (recv_len < 0) {
-        logger_write("http: recv failed errno=%d", errno);
+// Extraction runs on the main loop, never here; until it is done the client is asked to retry.
+static void server_queue_icon_pending(HttpServer* server, HttpConnection* conn, TitleIconStatus status) {
+    if (status == TitleIconStatus_Queued) {
+        telemetry_request_query(server->telemetry); // wakes the main loop to extract it
+    }
+    server->icon_pending_count++;
+    http_conn_queue_response(conn, "503 Service Unavailable", NULL, "Retry-After: 1\r\n", "", 0);
+}
+
+// Answers /icon/<program_id> from the SD icon cache. The strong ETag is the content hash, so a
+// revalidation is answered from the in-memory index without opening the file; a full answer is
+// streamed from the file through send_buf.
+static void server_queue_icon(HttpServer* server, HttpConnection* conn, u64 program_id) {
+    TitleIcon icon;
+    TitleIconStatus status;
+    struct stat st;
+    char etag[24];
+    char headers[96];
+    const char* value;
+    size_t value_len = 0;
+    FILE* f;
+
+    status = title_icons_get(program_id, &icon);
+    if (status == TitleIconStatus_Missing) {
+        http_conn_queue_not_found(conn);
+        return;
+    }
+    if (status != TitleIconStatus_Found) {
+        server_queue_icon_pending(server, conn, status);
+        return;
+    }
+
+    snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long)icon.hash);
+    value = http_find_header(conn->recv_buf, conn->request_len, "If-None-Match", &value_len);
+    if (value && http_value_has_token(value, value_len, etag)) {
+        snprintf(headers, sizeof(headers), "ETag: %s\r\n" ICON_CACHE_CONTROL, etag);
+        server->icon_not_modified_count++;
+        http_conn_queue_response(conn, "304 Not Modified", NULL, headers, "", 0);
         return;
     }
 
-    req_buf[recv_len] = '\0';
+    f = title_icons_open(program_id, &icon);
+    if (!f) {
+        // Gone from the card; title_icons_open queued it again.
+        server_queue_icon_pending(server, conn, TitleIconStatus_Queued);
+        return;
+    }
+    // The 200 promises icon.size bytes, so it only stands once the file is that long and the
+    // first piece has been read; nothing has reached the socket before then.
+    if (fstat(fileno(f), &st) != 0 || (u64)st.st_size != icon.size) {
+        LOG_WARN(LogSys_Http, "http: icon %016llX is not %u bytes on the card", (unsigned long long)program_id, icon.size);
+        fclose(f);
+        http_conn_queue_response(conn, "500 Internal Server Error", NULL, NULL, "", 0);
+        return;
+    }
+    snprintf(headers, sizeof(headers), "ETag: %s\r\n" ICON_CACHE_CONTROL, etag);
+    http_conn_queue_response(conn, "200 OK", "image/jpeg", headers, NULL, icon.size);
+    conn->body_file = f;
+    conn->body_remaining = icon.size;
+    if (!http_conn_fill_body(conn)) {
+        LOG_WARN(LogSys_Http, "http: icon %016llX short read", (unsigned long long)program_id);
+        http_conn_close_body(conn);
+        http_conn_queue_response(conn, "500 Internal Server Error", NULL, NULL, "", 0);
+        return;
+    }
+    server->icon_count++;
+}
+
+static void server_dispatch_request(HttpServer* server, HttpConnection* conn, u64 now_ms) {
+    const char* req_buf = conn->recv_buf;
+    u64 since = 0;
+    u64 wait_ms = 0;
+
     server->request_count++;
+    conn->request_count++;
+    telemetry_note_client_activity(server->telemetry);
 
     if (strncmp(req_buf, "GET /debug", 10) == 0) {
-        char json_body[1024];
+        char json_body[HTTP_SEND_BUF_SIZE - 256];
         http_server_build_debug_json(server, json_body, sizeof(json_body));
-        send_http_json(client_fd, json_body);
+        http_conn_queue_json(conn, json_body);
+        return;
+    }
+
+    if (strncmp(req_buf, "GET /events", 11) == 0) {
+        server_start_event_stream(server, conn);
+        return;
+    }
+
+    if (strncmp(req_buf, "GET /metrics/history", 20) == 0) {
+        char json_body[HTTP_SEND_BUF_SIZE - 256];
+        u64 res_sec = 0;
+        http_query_u64(req_buf, "res", &res_sec);
+        http_query_u64(req_buf, "since", &since);
+        power_history_build_json(res_sec, since, json_body, sizeof(json_body));
+        http_conn_queue_json(conn, json_body);
+        return;
+    }
+
+    if (strncmp(req_buf, "GET /history/totals", 19) == 0) {
+        char json_body[HTTP_SEND_BUF_SIZE - 256];
+        session_journal_build_totals_json(json_body, sizeof(json_body));
+        http_conn_queue_json(conn, json_body);
+        return;
+    }
+
+    if (strncmp(req_buf, "GET /history", 12) == 0) {
+        char json_body[HTTP_SEND_BUF_SIZE - 256];
+        http_query_u64(req_buf, "since", &since);
+        session_journal_build_json(since, json_body, sizeof(json_body));
+        http_conn_queue_json(conn, json_body);
+        return;
+    }
+
+    if (strncmp(req_buf, "GET /icon/", 10) == 0) {
+        u64 program_id;
+
+        if (!http_parse_program_id(req_buf + 10, &program_id)) {
+            http_conn_queue_not_found(conn);
+            return;
+        }
+        server_queue_icon(server, conn, program_id);
         return;
     }
 
     if (strncmp(req_buf, "GET /state", 10) != 0 && strncmp(req_buf, "GET / ", 6) != 0) {
-        send_http_not_found(client_fd);
+        http_conn_queue_not_found(conn);
         return;
     }
 
-    {
-        char json_body[2048];
-        telemetry_build_json(server->telemetry, json_body, sizeof(json_body));
-        send_http_json(client_fd, json_body);
+    conn->binary_state = strncmp(req_buf, "GET /state.bin", 14) == 0;
+    http_query_u64(req_buf, "since", &since);
+    if (since != 0 && http_query_u64(req_buf, "wait", &wait_ms) && wait_ms > 0 &&
+        !telemetry_changed_since(server->telemetry, since)) {
+        if (wait_ms > LONGPOLL_MAX_WAIT_MS) {
+            wait_ms = LONGPOLL_MAX_WAIT_MS;
+        }
+        server->longpoll_count++;
+        conn->park_since_seq = since;
+        conn->park_deadline_ms = now_ms + wait_ms;
+        conn->state = HttpConnState_Parked;
+        return;
+    }
+
+    server_queue_state(server, conn, since);
+}
+
+// Dispatches the oldest complete request in recv_buf; pipelined ones wait for the previous response.
+static void server_try_dispatch(HttpServer* server, HttpConnection* conn, u64 now_ms) {
+    const char* head_end;
+    const char* version;
+    const char* value;
+    size_t value_len = 0;
+    size_t head_len;
+    bool http10;
+
+    if (conn->state != HttpConnState_Reading || conn->recv_len == 0) {
+        return;
+    }
+
+    head_end = strstr(conn->recv_buf, "\r\n\r\n");
+    if (!head_end) {
+        return;
+    }
+
+    head_len = (size_t)(head_end + 4 - conn->recv_buf);
+    conn->request_len = (u32)head_len;
+    conn->request_start_ms = now_ms;
+
+    // HTTP/1.1 is persistent unless the client opts out; 1.0 only with an explicit keep-alive.
+    version = strstr(conn->recv_buf, " HTTP/1.0\r\n");
+    http10 = (version != NULL && version < head_end);
+    value = http_find_header(conn->recv_buf, head_len, "Connection", &value_len);
+    if (http10) {
+        conn->keep_alive = value && http_value_has_token(value, value_len, "keep-alive");
+    } else {
+        conn->keep_alive = !(value && http_value_has_token(value, value_len, "close"));
+    }
+    if (conn->request_count + 1 >= HTTP_KEEPALIVE_MAX_REQUESTS) {
+        conn->keep_alive = false;
+    }
+
+    // Request bodies are never used; rather than buffering them, answer and close.
+    value = http_find_header(conn->recv_buf, head_len, "Content-Length", &value_len);
+    if (value && strtoul(value, NULL, 10) > 0) {
+        conn->keep_alive = false;
+    }
+
+    server_dispatch_request(server, conn, now_ms);
+}
+
+static void server_accept(HttpServer* server, int* accept_error_streak) {
+    int client_fd = accept(server->listen_fd, NULL, NULL);
+    HttpConnection* conn = NULL;
+    u64 now_ms;
+    int i;
+
+    if (client_fd < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+            const int accept_errno = errno;
+            server->last_errno = errno;
+            server->stage = -5;
+            LOG_WARN(LogSys_Http, "http: accept failed errno=%d", accept_errno);
+            (*accept_error_streak)++;
+
+            if (accept_errno == ACCEPT_ERRNO_NET_UNREACH || *accept_error_streak >= ACCEPT_ERROR_REOPEN_THRESHOLD) {
+                LOG_WARN(LogSys_Http,
+                    "http: recover-v2 reopen accept_errno=%d streak=%d",
+                    accept_errno,
+                    *accept_error_streak
+                );
+                *accept_error_streak = 0;
+                server->listening = false;
+                if (server->listen_fd >= 0) {
+                    close(server->listen_fd);
+                    server->listen_fd = -1;
+                }
+                svcSleepThread(500ULL * 1000000ULL);
+                if (!http_server_open_listen_socket(server)) {
+                    svcSleepThread(1000ULL * 1000000ULL);
+                }
+            }
+        }
+        return;
+    }
+
+    *accept_error_streak = 0;
+    server->accepted_count++;
+
+    for (i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (server->connections[i].state == HttpConnState_Free) {
+            conn = &server->connections[i];
+            break;
+        }
+    }
+
+    // A full table first gives up the connection that has been idle between requests longest,
+    // if it has been idle for a while; a poller between two requests keeps its slot.
+    if (!conn) {
+        u64 oldest_ms = ms_since_boot_now() - HTTP_RECLAIM_IDLE_MS;
+
+        for (i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+            HttpConnection* idle = &server->connections[i];
+            if (idle->state == HttpConnState_Reading && idle->recv_len == 0 && idle->request_count > 0 &&
+                idle->last_activity_ms <= oldest_ms) {
+                conn = idle;
+                oldest_ms = idle->last_activity_ms;
+            }
+        }
+        if (conn) {
+            server->reclaimed_count++;
+            server_close_conn(server, conn);
+        }
+    }
+
+    if (!conn) {
+        static const char busy[] =
+            "HTTP/1.1 503 Service Unavailable\r\n"
+            "Connection: close\r\n"
+            "Content-Length: 0\r\n"
+            "\r\n";
+        server->rejected_count++;
+        send(client_fd, busy, sizeof(busy) - 1, MSG_DONTWAIT);
+        close(client_fd);
+        return;
     }
+
+    fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    now_ms = ms_since_boot_now();
+    conn->fd = client_fd;
+    conn->state = HttpConnState_Reading;
+    conn->accepted_ms = now_ms;
+    conn->last_activity_ms = now_ms;
+    conn->request_start_ms = now_ms;
+    conn->request_count = 0;
+    conn->bytes_in = 0;
+    conn->bytes_out = 0;
+    conn->last_service_ms = 0;
+    conn->max_service_ms = 0;
+    conn->recv_len = 0;
+    conn->request_len = 0;
+    conn->send_len = 0;
+    conn->send_off = 0;
+    conn->body_file = NULL;
+    conn->body_remaining = 0;
+    conn->keep_alive = false;
+
+    server->active_connections++;
+    if (server->active_connections > server->peak_connections) {
+        server->peak_connections = server->active_connections;
+    }
+}
+
+static void server_conn_readable(HttpServer* server, HttpConnection* conn, u64 now_ms) {
+    const size_t room = sizeof(conn->recv_buf) - 1 - conn->recv_len;
+    int recv_len;
+
+    if (room == 0) {
+        // Request head does not fit; nothing sane to answer with.
+        server_close_conn(server, conn);
+        return;
+    }
+
+    recv_len = recv(conn->fd, conn->recv_buf + conn->recv_len, room, 0);
+    if (recv_len < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return;
+        }
+        LOG_WARN(LogSys_Http, "http: recv failed errno=%d", errno);
+        server_close_conn(server, conn);
+        return;
+    }
+    if (recv_len == 0) {
+        server_close_conn(server, conn);
+        return;
+    }
+
+    conn->bytes_in += (u64)recv_len;
+    if (conn->state == HttpConnState_Streaming) {
+        // Event streams are one-way; anything the client sends is ignored.
+        return;
+    }
+
+    // The head deadline runs from the first byte of the request, not from the latest one.
+    if (conn->recv_len == 0 && conn->state == HttpConnState_Reading) {
+        conn->request_start_ms = now_ms;
+    }
+    conn->last_activity_ms = now_ms;
+    conn->recv_len += (u32)recv_len;
+    conn->recv_buf[conn->recv_len] = '\0';
+
+    // Bytes arriving while parked are pipelined requests; they are picked up after the response.
+    server_try_dispatch(server, conn, now_ms);
+}
+
+static void server_conn_writable(HttpServer* server, HttpConnection* conn, u64 now_ms) {
+    int sent = send(conn->fd, conn->send_buf + conn->send_off, conn->send_len - conn->send_off, 0);
+    if (sent < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return;
+        }
+        server_close_conn(server, conn);
+        return;
+    }
+
+    conn->send_off += (u32)sent;
+    conn->bytes_out += (u64)sent;
+    conn->last_activity_ms = now_ms;
+    if (conn->send_off < conn->send_len) {
+        return;
+    }
+
+    if (conn->body_file) {
+        conn->send_len = 0;
+        conn->send_off = 0;
+        if (!http_conn_fill_body(conn)) {
+            // The Content-Length promise cannot be kept; the client sees a short body.
+            LOG_WARN(LogSys_Http, "http: response body read failed");
+            server_close_conn(server, conn);
+        }
+        return;
+    }
+
+    if (conn->state == HttpConnState_Streaming) {
+        server_stream_fill(server, conn, now_ms);
+        return;
+    }
+
+    conn->last_service_ms = (u32)(now_ms - conn->request_start_ms);
+    if (conn->last_service_ms > conn->max_service_ms) {
+        conn->max_service_ms = conn->last_service_ms;
+    }
+
+    if (!conn->keep_alive) {
+        server_close_conn(server, conn);
+        return;
+    }
+
+    // Drop the answered request and continue with whatever the client pipelined behind it.
+    if (conn->request_len > conn->recv_len) {
+        conn->request_len = conn->recv_len;
+    }
+    memmove(conn->recv_buf, conn->recv_buf + conn->request_len, conn->recv_len - conn->request_len);
+    conn->recv_len -= conn->request_len;
+    conn->recv_buf[conn->recv_len] = '\0';
+    conn->request_len = 0;
+    conn->send_len = 0;
+    conn->send_off = 0;
+    conn->state = HttpConnState_Reading;
+    conn->request_start_ms = now_ms; // a pipelined partial head starts its deadline now
+    server_try_dispatch(server, conn, now_ms);
+}
+
+static bool http_conn_wants_write(const HttpConnection* conn) {
+    return conn->state == HttpConnState_Writing ||
+        (conn->state == HttpConnState_Streaming && conn->send_off < conn->send_len);
+}
+
+static void deadline_min(u64* next_ms, u64 at_ms) {
+    if (at_ms < *next_ms) {
+        *next_ms = at_ms;
+    }
+}
+
+// Returns when the next timer falls due, so select sleeps until then or until a socket wakes it.
+static u64 server_check_timers(HttpServer* server, u64 now_ms) {
+    u64 next_ms = now_ms + SELECT_IDLE_MS;
+    bool subscribed = false;
+    int i;
+
+    for (i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        HttpConnection* conn = &server->connections[i];
+
+        if (conn->state == HttpConnState_Parked || conn->state == HttpConnState_Streaming) {
+            subscribed = true;
+        }
+
+        if (conn->state == HttpConnState_Parked) {
+            if (telemetry_changed_since(server->telemetry, conn->park_since_seq)) {
+                server->longpoll_wakeups++;
+                server_queue_state(server, conn, conn->park_since_seq);
+            } else if (now_ms >= conn->park_deadline_ms) {
+                server_queue_state(server, conn, conn->park_since_seq);
+            } else {
+                deadline_min(&next_ms, conn->park_deadline_ms);
+                if (server->wake_fd < 0) {
+                    deadline_min(&next_ms, now_ms + LONGPOLL_CHECK_MS);
+                }
+            }
+        } else if (conn->state == HttpConnState_Streaming) {
+            if (conn->send_off < conn->send_len) {
+                if (now_ms - conn->last_activity_ms >= HTTP_IO_TIMEOUT_MS) {
+                    // Subscriber stopped draining; drop it rather than buffer without bound.
+                    server->timeout_count++;
+                    server_close_conn(server, conn);
+                } else {
+                    deadline_min(&next_ms, conn->last_activity_ms + HTTP_IO_TIMEOUT_MS);
+                }
+            } else {
+                server_stream_fill(server, conn, now_ms);
+                deadline_min(&next_ms, conn->last_activity_ms + SSE_KEEPALIVE_MS);
+                if (server->wake_fd < 0) {
+                    deadline_min(&next_ms, now_ms + LONGPOLL_CHECK_MS);
+                }
+            }
+        } else if (conn->state == HttpConnState_Reading && conn->recv_len > 0 &&
+                   now_ms - conn->request_start_ms >= HTTP_HEAD_DEADLINE_MS) {
+            // Trickling bytes keeps last_activity_ms fresh but cannot stretch the head deadline.
+            server->head_timeout_count++;
+            conn->keep_alive = false;
+            http_conn_queue_response(conn, "408 Request Timeout", NULL, NULL, "", 0);
+            deadline_min(&next_ms, now_ms + HTTP_IO_TIMEOUT_MS);
+        } else if (conn->state == HttpConnState_Reading || conn->state == HttpConnState_Writing) {
+            // Between requests a persistent connection gets the longer keep-alive idle budget.
+            const bool between_requests =
+                conn->state == HttpConnState_Reading && conn->recv_len == 0 && conn->request_count > 0;
+            const u64 limit_ms = between_requests ? HTTP_KEEPALIVE_IDLE_MS : HTTP_IO_TIMEOUT_MS;
+            if (now_ms - conn->last_activity_ms >= limit_ms) {
+                server->timeout_count++;
+                server_close_conn(server, conn);
+            } else {
+                deadline_min(&next_ms, conn->last_activity_ms + limit_ms);
+                if (conn->state == HttpConnState_Reading && conn->recv_len > 0) {
+                    deadline_min(&next_ms, conn->request_start_ms + HTTP_HEAD_DEADLINE_MS);
+                }
+            }
+        }
+    }
+
+    // Long-pollers and SSE subscribers are watching even while they send no requests; telling
+    // telemetry now and then is enough to keep it inside its client window.
+    if (subscribed) {
+        if (now_ms - server->watch_noted_ms >= HTTP_WATCH_NOTE_MS) {
+            telemetry_note_client_activity(server->telemetry);
+            server->watch_noted_ms = now_ms;
+        }
+        deadline_min(&next_ms, server->watch_noted_ms + HTTP_WATCH_NOTE_MS);
+    }
+    return next_ms;
 }
 
 static void http_server_thread(void* arg) {
     HttpServer* server = (HttpServer*)arg;
     int accept_error_streak = 0;
+    int i;
+
+    u64 next_ms;
 
     if (!http_server_open_listen_socket(server)) {
         return;
     }
+    http_server_open_wake_socket(server);
 
+    next_ms = ms_since_boot_now();
     while (server->running) {
         fd_set readfds;
+        fd_set writefds;
         struct timeval timeout;
+        int max_fd = -1;
         int sel_rc;
+        u64 now_ms;
+        u64 wait_ms;
 
         FD_ZERO(&readfds);
-        FD_SET(server->listen_fd, &readfds);
-        timeout.tv_sec = 1;
-        timeout.tv_usec = 0;
+        FD_ZERO(&writefds);
+        if (server->listen_fd >= 0) {
+            FD_SET(server->listen_fd, &readfds);
+            max_fd = server->listen_fd;
+        }
+        if (server->wake_fd >= 0) {
+            FD_SET(server->wake_fd, &readfds);
+            if (server->wake_fd > max_fd) max_fd = server->wake_fd;
+        }
+        for (i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+            HttpConnection* conn = &server->connections[i];
+            if (conn->state == HttpConnState_Free) {
+                continue;
+            }
+            if (http_conn_wants_write(conn)) {
+                FD_SET(conn->fd, &writefds);
+            } else {
+                // Parked and streaming sockets stay in the read set so a client hang-up frees the slot.
+                FD_SET(conn->fd, &readfds);
+            }
+            if (conn->fd > max_fd) max_fd = conn->fd;
+        }
 
-        sel_rc = select(server->listen_fd + 1, &readfds, NULL, NULL, &timeout);
+        now_ms = ms_since_boot_now();
+        wait_ms = next_ms > now_ms ? next_ms - now_ms : 0;
+        timeout.tv_sec = (long)(wait_ms / 1000);
+        timeout.tv_usec = (long)(wait_ms % 1000) * 1000;
+
+        sel_rc = select(max_fd + 1, &readfds, &writefds, NULL, &timeout);
         if (sel_rc < 0) {
             if (errno == EINTR) {
                 continue;
             }
             server->last_errno = errno;
             server->stage = -4;
-            logger_write("http: select failed errno=%d", errno);
+            LOG_ERROR(LogSys_Http, "http: select failed errno=%d", errno);
             break;
         }
-        if (sel_rc == 0 || !FD_ISSET(server->listen_fd, &readfds)) {
-            continue;
-        }
 
-        {
-            int client_fd = accept(server->listen_fd, NULL, NULL);
-            if (client_fd < 0) {
-                if (errno != EINTR) {
-                    const int accept_errno = errno;
-                    server->last_errno = errno;
-                    server->stage = -5;
-                    logger_write("http: accept failed errno=%d", accept_errno);
-                    accept_error_streak++;
-
-                    if (accept_errno == ACCEPT_ERRNO_NET_UNREACH || accept_error_streak >= ACCEPT_ERROR_REOPEN_THRESHOLD) {
-                        logger_write(
-                            "http: recover-v2 reopen accept_errno=%d streak=%d",
-                            accept_errno,
-                            accept_error_streak
-                        );
-                        accept_error_streak = 0;
-                        server->listening = false;
-                        if (server->listen_fd >= 0) {
-                            close(server->listen_fd);
-                            server->listen_fd = -1;
-                        }
-                        svcSleepThread(500ULL * 1000000ULL);
-                        if (!http_server_open_listen_socket(server)) {
-                            svcSleepThread(1000ULL * 1000000ULL);
-                        }
+        now_ms = ms_since_boot_now();
+        if (sel_rc > 0) {
+            if (server->wake_fd >= 0 && FD_ISSET(server->wake_fd, &readfds)) {
+                http_server_drain_wake(server);
+            }
+            for (i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+                HttpConnection* conn = &server->connections[i];
+                if (conn->state == HttpConnState_Free) {
+                    continue;
+                }
+                if (http_conn_wants_write(conn)) {
+                    if (FD_ISSET(conn->fd, &writefds)) {
+                        server_conn_writable(server, conn, now_ms);
                     }
+                } else if (FD_ISSET(conn->fd, &readfds)) {
+                    server_conn_readable(server, conn, now_ms);
                 }
-                continue;
             }
 
-            accept_error_streak = 0;
-            server->accepted_count++;
-            server_handle_client(server, client_fd);
-            close(client_fd);
+            if (server->listen_fd >= 0 && FD_ISSET(server->listen_fd, &readfds)) {
+                server_accept(server, &accept_error_streak);
+            }
+        }
+
+        next_ms = server_check_timers(server, now_ms);
+    }
+
+    for (i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (server->connections[i].state != HttpConnState_Free) {
+            server_close_conn(server, &server->connections[i]);
         }
     }
 
+    http_server_close_wake_socket(server);
     server->listening = false;
     if (server->listen_fd >= 0) {
         close(server->listen_fd);
         server->listen_fd = -1;
     }
 
-    logger_write("http: thread stopped");
+    LOG_INFO(LogSys_Http, "http: thread stopped");
 }
 
 bool http_server_start(HttpServer* server, TelemetryState* telemetry, unsigned short port) {
     Result rc;
+    int i;
 
     memset(server, 0, sizeof(*server));
     server->telemetry = telemetry;
     server->running = true;
     server->listen_fd = -1;
+    server->wake_fd = -1;
     server->port = port;
     server->accepted_count = 0;
     server->request_count = 0;
+    server->longpoll_count = 0;
+    server->longpoll_wakeups = 0;
     server->last_errno = 0;
     server->stage = 0;
     server->listening = false;
+    for (i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        server->connections[i].fd = -1;
+        server->connections[i].state = HttpConnState_Free;
+    }
 
     rc = threadCreate(
         &server->thread,
@@ -230,7 +1178,7 @@ bool http_server_start(HttpServer* server, TelemetryState* telemetry, unsigned s
         SERVER_THREAD_CPUID
     );
     if (R_FAILED(rc)) {
-        logger_write(
+        LOG_ERROR(LogSys_Http,
             "http: threadCreate failed rc=0x%08lX prio=%d cpuid=%d",
             (unsigned long)rc,
             SERVER_THREAD_PRIO,
@@ -242,7 +1190,7 @@ bool http_server_start(HttpServer* server, TelemetryState* telemetry, unsigned s
 
     rc = threadStart(&server->thread);
     if (R_FAILED(rc)) {
-        logger_write("http: threadStart failed rc=0x%08lX", (unsigned long)rc);
+        LOG_ERROR(LogSys_Http, "http: threadStart failed rc=0x%08lX", (unsigned long)rc);
         threadClose(&server->thread);
         server->running = false;
         return false;
@@ -266,26 +1214,129 @@ void http_server_stop(HttpServer* server) {
 }
 
 void http_server_build_debug_json(const HttpServer* server, char* out, size_t out_size) {
-    snprintf(
-        out,
-        out_size,
-        "{"
-        "\"running\":%s,"
-        "\"listening\":%s,"
-        "\"stage\":%d,"
-        "\"listen_fd\":%d,"
-        "\"port\":%u,"
-        "\"accepted_count\":%llu,"
-        "\"request_count\":%llu,"
-        "\"last_errno\":%d"
-        "}",
-        server->running ? "true" : "false",
-        server->listening ? "true" : "false",
-        server->stage,
-        server->listen_fd,
-        (unsigned int)server->port,
-        (unsigned long long)server->accepted_count,
-        (unsigned long long)server->request_count,
-        server->last_errno
-    );
+    const u64 now_ms = ms_since_boot_now();
+    JsonWriter w;
+    u64 title_hits;
+    u64 title_misses;
+    u64 title_fetches;
+    u64 title_index_hits;
+    u64 icon_hits;
+    u64 icon_extractions;
+    int i;
+
+    json_writer_init(&w, out, out_size);
+    json_object_begin(&w);
+    json_key(&w, "running");
+    json_bool(&w, server->running);
+    json_key(&w, "listening");
+    json_bool(&w, server->listening);
+    json_key(&w, "stage");
+    json_s64(&w, server->stage);
+    json_key(&w, "listen_fd");
+    json_s64(&w, server->listen_fd);
+    json_key(&w, "port");
+    json_u64(&w, server->port);
+    json_key(&w, "accepted_count");
+    json_u64(&w, server->accepted_count);
+    json_key(&w, "request_count");
+    json_u64(&w, server->request_count);
+    json_key(&w, "longpoll_count");
+    json_u64(&w, server->longpoll_count);
+    json_key(&w, "longpoll_wakeups");
+    json_u64(&w, server->longpoll_wakeups);
+    json_key(&w, "rejected_count");
+    json_u64(&w, server->rejected_count);
+    json_key(&w, "timeout_count");
+    json_u64(&w, server->timeout_count);
+    json_key(&w, "head_timeout_count");
+    json_u64(&w, server->head_timeout_count);
+    json_key(&w, "reclaimed_count");
+    json_u64(&w, server->reclaimed_count);
+    json_key(&w, "not_modified_count");
+    json_u64(&w, server->not_modified_count);
+    json_key(&w, "state_cache_hits");
+    json_u64(&w, server->state_cache_hits);
+    json_key(&w, "binary_state_count");
+    json_u64(&w, server->binary_state_count);
+    json_key(&w, "stream_count");
+    json_u64(&w, server->stream_count);
+    json_key(&w, "stream_events_sent");
+    json_u64(&w, server->stream_events_sent);
+    json_key(&w, "max_connections");
+    json_u64(&w, HTTP_MAX_CONNECTIONS);
+    json_key(&w, "active_connections");
+    json_u64(&w, server->active_connections);
+    json_key(&w, "peak_connections");
+    json_u64(&w, server->peak_connections);
+    json_key(&w, "last_errno");
+    json_s64(&w, server->last_errno);
+    json_key(&w, "pid_cache_hits");
+    json_u64(&w, server->telemetry ? server->telemetry->pid_cache_hits : 0);
+    json_key(&w, "pid_cache_misses");
+    json_u64(&w, server->telemetry ? server->telemetry->pid_cache_misses : 0);
+    title_names_get_stats(&title_hits, &title_misses, &title_fetches, &title_index_hits);
+    json_key(&w, "title_name_hits");
+    json_u64(&w, title_hits);
+    json_key(&w, "title_name_misses");
+    json_u64(&w, title_misses);
+    json_key(&w, "title_name_fetches");
+    json_u64(&w, title_fetches);
+    json_key(&w, "title_name_index_hits");
+    json_u64(&w, title_index_hits);
+    title_icons_get_stats(&icon_hits, &icon_extractions);
+    json_key(&w, "icon_count");
+    json_u64(&w, server->icon_count);
+    json_key(&w, "icon_not_modified_count");
+    json_u64(&w, server->icon_not_modified_count);
+    json_key(&w, "icon_pending_count");
+    json_u64(&w, server->icon_pending_count);
+    json_key(&w, "icon_cache_hits");
+    json_u64(&w, icon_hits);
+    json_key(&w, "icon_extractions");
+    json_u64(&w, icon_extractions);
+    json_key(&w, "connections");
+    json_array_begin(&w);
+
+    for (i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        const HttpConnection* conn = &server->connections[i];
+        const u32 state = conn->state;
+        JsonWriterMark mark;
+
+        if (state == HttpConnState_Free) {
+            continue;
+        }
+
+        mark = json_writer_mark(&w);
+        json_object_begin(&w);
+        json_key(&w, "slot");
+        json_u64(&w, (u64)i);
+        json_key(&w, "state");
+        json_string(&w, http_conn_state_name(state));
+        json_key(&w, "age_ms");
+        json_u64(&w, now_ms > conn->accepted_ms ? now_ms - conn->accepted_ms : 0);
+        json_key(&w, "idle_ms");
+        json_u64(&w, now_ms > conn->last_activity_ms ? now_ms - conn->last_activity_ms : 0);
+        json_key(&w, "requests");
+        json_u64(&w, conn->request_count);
+        json_key(&w, "bytes_in");
+        json_u64(&w, conn->bytes_in);
+        json_key(&w, "bytes_out");
+        json_u64(&w, conn->bytes_out);
+        json_key(&w, "last_service_ms");
+        json_u64(&w, conn->last_service_ms);
+        json_key(&w, "max_service_ms");
+        json_u64(&w, conn->max_service_ms);
+        json_object_end(&w);
+        // Keep room for the closing "]}" so a full buffer still yields valid JSON.
+        if (w.overflow || json_writer_room(&w) < 2) {
+            json_writer_rewind(&w, mark);
+            break;
+        }
+    }
+
+    json_array_end(&w);
+    json_object_end(&w);
+    if (!json_writer_finish(&w) && out_size > 0) {
+        out[0] = '\0';
+    }
 }
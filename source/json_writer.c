@@ -0,0 +1,250 @@
+#include "json_writer.h"
+
+#include <string.h>
+
+static bool json_reserve(JsonWriter* w, size_t len) {
+    if (w->overflow) {
+        return false;
+    }
+    if (len > json_writer_room(w)) {
+        w->overflow = true;
+        return false;
+    }
+    return true;
+}
+
+// Separator before a value or key; a value right after its key needs none.
+static void json_value_prefix(JsonWriter* w) {
+    const u32 bit = 1u << w->depth;
+
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->depth > 0 && (w->has_item & bit)) {
+        json_raw_n(w, ",", 1);
+    }
+    w->has_item |= bit;
+}
+
+void json_writer_init(JsonWriter* w, char* out, size_t size) {
+    memset(w, 0, sizeof(*w));
+    w->out = out;
+    w->size = size;
+    if (size == 0) {
+        w->overflow = true;
+    } else {
+        out[0] = '\0';
+    }
+}
+
+bool json_writer_finish(JsonWriter* w) {
+    if (w->size == 0) {
+        return false;
+    }
+    w->out[w->len] = '\0';
+    return !w->overflow && w->depth == 0;
+}
+
+JsonWriterMark json_writer_mark(const JsonWriter* w) {
+    JsonWriterMark mark;
+
+    mark.len = w->len;
+    mark.depth = w->depth;
+    mark.has_item = w->has_item;
+    mark.after_key = w->after_key;
+    return mark;
+}
+
+void json_writer_rewind(JsonWriter* w, JsonWriterMark mark) {
+    w->len = mark.len;
+    w->depth = mark.depth;
+    w->has_item = mark.has_item;
+    w->after_key = mark.after_key;
+    w->overflow = false;
+}
+
+size_t json_writer_room(const JsonWriter* w) {
+    return w->size > w->len ? w->size - w->len - 1 : 0;
+}
+
+void json_raw_n(JsonWriter* w, const char* text, size_t len) {
+    if (!json_reserve(w, len)) {
+        return;
+    }
+    memcpy(w->out + w->len, text, len);
+    w->len += len;
+}
+
+void json_raw(JsonWriter* w, const char* text) {
+    json_raw_n(w, text, strlen(text));
+}
+
+// Digits are produced backwards into a scratch buffer, then copied once.
+void json_raw_u64(JsonWriter* w, u64 value) {
+    char digits[20];
+    char* p = digits + sizeof(digits);
+
+    do {
+        *--p = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value != 0);
+    json_raw_n(w, p, (size_t)(digits + sizeof(digits) - p));
+}
+
+static void json_open(JsonWriter* w, char c) {
+    json_value_prefix(w);
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        w->overflow = true;
+        return;
+    }
+    json_raw_n(w, &c, 1);
+    w->depth++;
+    w->has_item &= ~(1u << w->depth);
+}
+
+static void json_close(JsonWriter* w, char c) {
+    if (w->depth == 0) {
+        w->overflow = true;
+        return;
+    }
+    w->depth--;
+    json_raw_n(w, &c, 1);
+}
+
+void json_object_begin(JsonWriter* w) {
+    json_open(w, '{');
+}
+
+void json_object_end(JsonWriter* w) {
+    json_close(w, '}');
+}
+
+void json_array_begin(JsonWriter* w) {
+    json_open(w, '[');
+}
+
+void json_array_end(JsonWriter* w) {
+    json_close(w, ']');
+}
+
+void json_key(JsonWriter* w, const char* key) {
+    const size_t len = strlen(key);
+
+    json_value_prefix(w);
+    if (!json_reserve(w, len + 3)) {
+        return;
+    }
+    w->out[w->len++] = '"';
+    memcpy(w->out + w->len, key, len);
+    w->len += len;
+    w->out[w->len++] = '"';
+    w->out[w->len++] = ':';
+    w->after_key = true;
+}
+
+void json_string(JsonWriter* w, const char* text) {
+    const char* run = text;
+    const char* p = text;
+
+    json_value_prefix(w);
+    json_raw_n(w, "\"", 1);
+    while (text && *p) {
+        const unsigned char c = (unsigned char)*p;
+
+        if (c == '"' || c == '\\' || c < 0x20) {
+            json_raw_n(w, run, (size_t)(p - run));
+            if (c < 0x20) {
+                json_raw_n(w, " ", 1);
+            } else {
+                const char escaped[2] = { '\\', (char)c };
+                json_raw_n(w, escaped, 2);
+            }
+            run = p + 1;
+        }
+        p++;
+    }
+    if (text) {
+        json_raw_n(w, run, (size_t)(p - run));
+    }
+    json_raw_n(w, "\"", 1);
+}
+
+void json_u64(JsonWriter* w, u64 value) {
+    json_value_prefix(w);
+    json_raw_u64(w, value);
+}
+
+void json_u64_padded(JsonWriter* w, u64 value, u32 width) {
+    char digits[20];
+    char* p = digits + sizeof(digits);
+    size_t len;
+
+    json_value_prefix(w);
+    do {
+        *--p = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value != 0);
+    len = (size_t)(digits + sizeof(digits) - p);
+
+    if (width > len) {
+        const size_t pad = width - len;
+        if (!json_reserve(w, pad)) {
+            return;
+        }
+        memset(w->out + w->len, ' ', pad);
+        w->len += pad;
+    }
+    json_raw_n(w, p, len);
+}
+
+void json_s64(JsonWriter* w, s64 value) {
+    json_value_prefix(w);
+    if (value < 0) {
+        json_raw_n(w, "-", 1);
+        json_raw_u64(w, (u64)0 - (u64)value);
+    } else {
+        json_raw_u64(w, (u64)value);
+    }
+}
+
+void json_hex(JsonWriter* w, u64 value, u32 digits) {
+    static const char hex[] = "0123456789ABCDEF";
+    char buf[2 + 2 + 16 + 1]; // quotes, "0x", up to 16 digits
+    u32 i;
+
+    if (digits == 0 || digits > 16) {
+        digits = 16;
+    }
+    json_value_prefix(w);
+    buf[0] = '"';
+    buf[1] = '0';
+    buf[2] = 'x';
+    for (i = 0; i < digits; i++) {
+        buf[3 + digits - 1 - i] = hex[(value >> (i * 4)) & 0xF];
+    }
+    buf[3 + digits] = '"';
+    json_raw_n(w, buf, digits + 4);
+}
+
+void json_bool(JsonWriter* w, bool value) {
+    json_value_prefix(w);
+    if (value) {
+        json_raw_n(w, "true", 4);
+    } else {
+        json_raw_n(w, "false", 5);
+    }
+}
+
+void json_null(JsonWriter* w) {
+    json_value_prefix(w);
+    json_raw_n(w, "null", 4);
+}
+
+void json_tristate(JsonWriter* w, bool valid, bool value) {
+    if (!valid) {
+        json_null(w);
+        return;
+    }
+    json_bool(w, value);
+}
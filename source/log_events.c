@@ -0,0 +1,105 @@
+#include "log_events.h"
+
+#include <stdio.h>
+
+static const char* const k_ready_bits[] = {
+    "sm", "fs", "setsys", "applet", "pmshell", "pminfo", "nifm", "socket", "http_started",
+    "detector_started", "detector_run", "detector_alive", "detector_ns", "detector_kill",
+    "unclean_prev", NULL,
+};
+
+static const LogEventDesc k_events[LogEvent_Count] = {
+    [LogEvent_Heartbeat] = { "heartbeat", 8, {
+        { "n", LogArg_Dec, NULL },
+        { "uptime", LogArg_Seconds, NULL },
+        { "rc", LogArg_Hex32, NULL },
+        { "ready", LogArg_Flags, k_ready_bits },
+        { "detector_hb", LogArg_Dec, NULL },
+        { "detector_streak", LogArg_Dec, NULL },
+        { "cooldown_until", LogArg_Dec, NULL },
+        { "query_interval_ms", LogArg_Dec, NULL },
+    } },
+    [LogEvent_HeartbeatHttp] = { "heartbeat-http", 11, {
+        { "accepted", LogArg_Dec, NULL },
+        { "requests", LogArg_Dec, NULL },
+        { "rejected", LogArg_Dec, NULL },
+        { "timeouts", LogArg_Dec, NULL },
+        { "not_modified", LogArg_Dec, NULL },
+        { "cache_hits", LogArg_Dec, NULL },
+        { "streams", LogArg_Dec, NULL },
+        { "stream_events", LogArg_Dec, NULL },
+        { "active", LogArg_Dec, NULL },
+        { "peak", LogArg_Dec, NULL },
+        { "last_errno", LogArg_Dec, NULL },
+    } },
+    [LogEvent_HeartbeatUdp] = { "heartbeat-udp", 4, {
+        { "changes", LogArg_Dec, NULL },
+        { "keepalives", LogArg_Dec, NULL },
+        { "send_errors", LogArg_Dec, NULL },
+        { "last_errno", LogArg_Dec, NULL },
+    } },
+    [LogEvent_Title] = { "title", 1, {
+        { "active_program_id", LogArg_Hex64, NULL },
+    } },
+};
+
+const LogEventDesc* log_event_desc(u32 event) {
+    if (event == LogEvent_Text || event >= LogEvent_Count) {
+        return NULL;
+    }
+    return &k_events[event];
+}
+
+static size_t log_append(char* out, size_t size, size_t len, const char* fmt, unsigned long long value, const char* name) {
+    int n;
+
+    if (len + 1 >= size) {
+        return len;
+    }
+    n = snprintf(out + len, size - len, fmt, name, value);
+    if (n < 0) {
+        return len;
+    }
+    return (size_t)n < size - len ? len + (size_t)n : size - 1;
+}
+
+size_t log_event_format(const LogEventDesc* desc, const u64* args, u32 arg_count, char* out, size_t size) {
+    size_t len;
+    u32 i;
+
+    if (size == 0) {
+        return 0;
+    }
+    len = log_append(out, size, 0, "%s:", 0, desc->name);
+
+    for (i = 0; i < arg_count; i++) {
+        const LogArgDesc* arg = i < desc->arg_count ? &desc->args[i] : NULL;
+        const unsigned long long value = (unsigned long long)args[i];
+        u32 bit;
+
+        if (!arg) {
+            len = log_append(out, size, len, " %s=%llu", value, "?");
+            continue;
+        }
+        switch (arg->kind) {
+        case LogArg_Seconds:
+            len = log_append(out, size, len, " %s=%llus", value, arg->name);
+            break;
+        case LogArg_Hex32:
+            len = log_append(out, size, len, " %s=0x%08llX", value, arg->name);
+            break;
+        case LogArg_Hex64:
+            len = log_append(out, size, len, " %s=0x%016llX", value, arg->name);
+            break;
+        case LogArg_Flags:
+            for (bit = 0; arg->bit_names[bit]; bit++) {
+                len = log_append(out, size, len, " %s=%llu", (value >> bit) & 1, arg->bit_names[bit]);
+            }
+            break;
+        default:
+            len = log_append(out, size, len, " %s=%llu", value, arg->name);
+            break;
+        }
+    }
+    return len;
+}
@@ -1,34 +1,478 @@
 #include "logger.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <strings.h>
 #include <switch.h>
 
-#define LOG_PATH "sdmc:/switch/switch-dcrpc/log.log"
+#define LOG_DIR "sdmc:/switch/switch-dcrpc/"
+#define LOG_BINARY_FLAG_PATH LOG_DIR "log_binary.flag"
+#define LOG_CONFIG_PATH LOG_DIR "logging.txt"
+#define LOG_ROTATE_BYTES (512 * 1024)
+#define LOG_SEGMENTS 4 // log.log plus log.1.log .. log.3.log
+#define LOG_RING_SLOTS 256 // power of two
+#define LOG_SLOT_BYTES 116 // a slot is 128 bytes; longer records take consecutive slots
+#define LOG_LINE_MAX 2560
+#define LOG_BATCH_SIZE 4096
+#define LOG_STACK_SIZE (16 * 1024)
+#define LOG_THREAD_PRIO 0x3B
+#define LOG_THREAD_CPUID -2
+#define LOG_FLUSH_INTERVAL_NS (100ULL * 1000000ULL)
 
-static bool g_logger_enabled = false;
+// A piece of a record. seq follows the bounded MPMC queue scheme: a slot is free for the
+// producer at position p when seq == p, and holds published bytes when seq == p + 1.
+typedef struct {
+    volatile u64 seq;
+    u16 len;
+    bool last; // ends a record; segments are only rotated between records
+    char text[LOG_SLOT_BYTES];
+} LogSlot;
+
+static const char* const k_level_names[] = { "off", "error", "warn", "info", "debug" };
+static const char* const k_subsystem_names[LogSys_Count] = { "boot", "http", "udp", "detector", "telemetry" };
+
+volatile u8 g_log_levels[LogSys_Count] = {
+    LogLevel_Info, LogLevel_Info, LogLevel_Info, LogLevel_Info, LogLevel_Info,
+};
+
+static u8 g_logger_thread_stack[LOG_STACK_SIZE] __attribute__((aligned(0x1000)));
+static LogSlot g_ring[LOG_RING_SLOTS];
+static char g_batch[LOG_BATCH_SIZE];
+
+static volatile bool g_logger_enabled = false;
+static bool g_logger_binary = false;
+static bool g_ring_ready = false;
+static u64 g_ring_head = 0; // next position to claim, shared by producers
+static u64 g_ring_tail = 0; // next position to flush, owned by the consumer
 static u64 g_log_line = 0;
+static u64 g_dropped = 0;
+
+static Thread g_logger_thread;
+static volatile bool g_logger_running = false;
+static bool g_logger_async = false;
+static Mutex g_sync_lock; // serializes inline flushing when there is no flusher thread
+static FILE* g_log_file = NULL;
+static u64 g_log_size = 0;
+static bool g_record_open = false; // the consumer has written part of a record
+
+static u64 logger_ms_since_boot(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000ULL;
+}
+
+static void logger_ring_reset(void) {
+    u32 i;
+
+    for (i = 0; i < LOG_RING_SLOTS; i++) {
+        g_ring[i].seq = i;
+    }
+    g_ring_head = 0;
+    g_ring_tail = 0;
+    mutexInit(&g_sync_lock);
+    g_ring_ready = true;
+}
+
+// Claims count consecutive slots without blocking; false when the ring lacks room. Slots
+// are freed in order, so the last one being free means all of them are.
+static bool logger_ring_claim(u32 count, u64* pos_out) {
+    u64 pos = __atomic_load_n(&g_ring_head, __ATOMIC_RELAXED);
+
+    while (1) {
+        const LogSlot* last = &g_ring[(pos + count - 1) & (LOG_RING_SLOTS - 1)];
+        const u64 seq = __atomic_load_n(&last->seq, __ATOMIC_ACQUIRE);
+        const s64 diff = (s64)(seq - (pos + count - 1));
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&g_ring_head, &pos, pos + count, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *pos_out = pos;
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = __atomic_load_n(&g_ring_head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void logger_segment_path(u32 index, char* out, size_t size) {
+    const char* ext = g_logger_binary ? "bin" : "log";
+
+    if (index == 0) {
+        snprintf(out, size, LOG_DIR "log.%s", ext);
+    } else {
+        snprintf(out, size, LOG_DIR "log.%u.%s", (unsigned int)index, ext);
+    }
+}
+
+// log.log becomes log.1.log, and so on; the oldest segment is deleted.
+static void logger_rotate(void) {
+    char from[64];
+    char to[64];
+    u32 i;
+
+    if (g_log_file) {
+        fclose(g_log_file);
+        g_log_file = NULL;
+    }
+    logger_segment_path(LOG_SEGMENTS - 1, to, sizeof(to));
+    remove(to);
+    for (i = LOG_SEGMENTS - 1; i > 0; i--) {
+        logger_segment_path(i - 1, from, sizeof(from));
+        logger_segment_path(i, to, sizeof(to));
+        rename(from, to);
+    }
+    g_log_size = 0;
+}
+
+static bool logger_file_open(void) {
+    char path[64];
+    long end;
+
+    logger_segment_path(0, path, sizeof(path));
+    g_log_file = fopen(path, g_logger_binary ? "ab" : "a");
+    if (!g_log_file) {
+        return false;
+    }
+    fseek(g_log_file, 0, SEEK_END);
+    end = ftell(g_log_file);
+    g_log_size = end > 0 ? (u64)end : 0;
+
+    if (g_logger_binary && g_log_size == 0) {
+        const LogFileHeader header = { LOG_FILE_MAGIC, LOG_FILE_VERSION, sizeof(LogRecordHeader) };
+
+        fwrite(&header, 1, sizeof(header), g_log_file);
+        g_log_size = sizeof(header);
+    }
+    return true;
+}
+
+static void logger_file_write(const char* data, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    if (!g_log_file && !logger_file_open()) {
+        return;
+    }
+    if (fwrite(data, 1, len, g_log_file) != len || fflush(g_log_file) != 0) {
+        // Reopen on the next batch; the SD card may have been busy or remounted.
+        fclose(g_log_file);
+        g_log_file = NULL;
+        return;
+    }
+    g_log_size += len;
+}
+
+static size_t logger_clamp(int written, size_t room) {
+    if (written <= 0 || room == 0) {
+        return 0;
+    }
+    return (size_t)written < room ? (size_t)written : room - 1;
+}
+
+static void logger_record_header(char* out, u16 event, size_t payload_size) {
+    LogRecordHeader header;
+
+    header.time_ms = logger_ms_since_boot();
+    header.line = (u32)__atomic_fetch_add(&g_log_line, 1, __ATOMIC_RELAXED);
+    header.event = event;
+    header.payload_size = (u16)payload_size;
+    memcpy(out, &header, sizeof(header));
+}
+
+// "[<sec> s] [line=<n>] ", the start of every text line.
+static size_t logger_text_prefix(char* out, size_t size) {
+    const int written = snprintf(out, size, "[%llu s] [line=%llu] ",
+        (unsigned long long)(logger_ms_since_boot() / 1000ULL),
+        (unsigned long long)__atomic_fetch_add(&g_log_line, 1, __ATOMIC_RELAXED));
+
+    return logger_clamp(written, size);
+}
+
+// Moves every published record to the file in as few writes as the batch buffer allows.
+// Single consumer: every caller holds g_sync_lock, the flusher thread included.
+static void logger_drain(void) {
+    size_t batch_len = 0;
+
+    if (!g_record_open) {
+        const u64 dropped = __atomic_exchange_n(&g_dropped, 0, __ATOMIC_RELAXED);
+
+        if (g_log_file && g_log_size >= LOG_ROTATE_BYTES) {
+            logger_rotate();
+        }
+        if (dropped != 0) {
+            char* body = g_batch;
+            size_t room = sizeof(g_batch);
+
+            if (g_logger_binary) {
+                body += sizeof(LogRecordHeader);
+                room -= sizeof(LogRecordHeader);
+            } else {
+                batch_len = logger_text_prefix(g_batch, sizeof(g_batch));
+                body += batch_len;
+                room -= batch_len;
+            }
+            batch_len += logger_clamp(snprintf(body, room, "logger: dropped %llu records, ring full",
+                (unsigned long long)dropped), room);
+            if (g_logger_binary) {
+                logger_record_header(g_batch, LogEvent_Text, batch_len);
+                batch_len += sizeof(LogRecordHeader);
+            } else {
+                g_batch[batch_len++] = '\n';
+            }
+        }
+    }
+
+    while (1) {
+        LogSlot* slot = &g_ring[g_ring_tail & (LOG_RING_SLOTS - 1)];
+
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != g_ring_tail + 1) {
+            break;
+        }
+        if (batch_len + slot->len > sizeof(g_batch)) {
+            logger_file_write(g_batch, batch_len);
+            batch_len = 0;
+        }
+        memcpy(g_batch + batch_len, slot->text, slot->len);
+        batch_len += slot->len;
+        g_record_open = !slot->last;
+        __atomic_store_n(&slot->seq, g_ring_tail + LOG_RING_SLOTS, __ATOMIC_RELEASE);
+        g_ring_tail++;
+    }
+
+    logger_file_write(g_batch, batch_len);
+}
+
+// Takes g_sync_lock like the inline drains: until logger_start has set g_logger_async, other
+// threads still drain from logger_push while this thread is already running.
+static void logger_thread(void* arg) {
+    (void)arg;
+
+    while (g_logger_running) {
+        mutexLock(&g_sync_lock);
+        logger_drain();
+        mutexUnlock(&g_sync_lock);
+        svcSleepThread(LOG_FLUSH_INTERVAL_NS);
+    }
+    mutexLock(&g_sync_lock);
+    logger_drain();
+    mutexUnlock(&g_sync_lock);
+}
 
 void logger_set_enabled(bool enabled) {
+    if (enabled && !g_ring_ready) {
+        logger_ring_reset();
+    }
     g_logger_enabled = enabled;
 }
 
-void logger_vwrite(const char* fmt, va_list args) {
-    if (!g_logger_enabled) {
+static bool logger_parse_level(const char* text, u8* out) {
+    u32 i;
+
+    for (i = 0; i < sizeof(k_level_names) / sizeof(k_level_names[0]); i++) {
+        if (strcasecmp(text, k_level_names[i]) == 0) {
+            *out = (u8)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void logger_load_config(void) {
+    u8 overrides[LogSys_Count];
+    u8 base = LogLevel_Info;
+    bool changed = false;
+    char line[64];
+    FILE* f;
+    u32 i;
+
+    memset(overrides, 0xFF, sizeof(overrides));
+    f = fopen(LOG_CONFIG_PATH, "r");
+    if (f) {
+        while (fgets(line, sizeof(line), f)) {
+            char* value;
+            u8 level;
+
+            line[strcspn(line, "\r\n")] = '\0';
+            value = strchr(line, '=');
+            if (line[0] == '#' || !value) {
+                continue;
+            }
+            *value++ = '\0';
+            if (!logger_parse_level(value, &level)) {
+                continue;
+            }
+            if (strcasecmp(line, "level") == 0) {
+                base = level;
+                continue;
+            }
+            for (i = 0; i < LogSys_Count; i++) {
+                if (strcasecmp(line, k_subsystem_names[i]) == 0) {
+                    overrides[i] = level;
+                }
+            }
+        }
+        fclose(f);
+    }
+
+    for (i = 0; i < LogSys_Count; i++) {
+        const u8 level = overrides[i] != 0xFF ? overrides[i] : base;
+
+        if (g_log_levels[i] != level) {
+            g_log_levels[i] = level;
+            changed = true;
+        }
+    }
+    if (changed) {
+        logger_write("logger: levels boot=%s http=%s udp=%s detector=%s telemetry=%s",
+            k_level_names[g_log_levels[LogSys_Boot]],
+            k_level_names[g_log_levels[LogSys_Http]],
+            k_level_names[g_log_levels[LogSys_Udp]],
+            k_level_names[g_log_levels[LogSys_Detector]],
+            k_level_names[g_log_levels[LogSys_Telemetry]]);
+    }
+}
+
+bool logger_start(void) {
+    Result rc;
+
+    FILE* flag;
+
+    if (g_logger_running) {
+        return true;
+    }
+
+    flag = fopen(LOG_BINARY_FLAG_PATH, "r");
+    if (flag) {
+        fclose(flag);
+        g_logger_binary = true;
+    }
+    logger_set_enabled(true);
+    logger_load_config();
+
+    g_logger_running = true;
+    rc = threadCreate(
+        &g_logger_thread,
+        logger_thread,
+        NULL,
+        g_logger_thread_stack,
+        LOG_STACK_SIZE,
+        LOG_THREAD_PRIO,
+        LOG_THREAD_CPUID
+    );
+    if (R_FAILED(rc)) {
+        g_logger_running = false;
+        logger_write("logger: threadCreate failed rc=0x%08lX, writing synchronously", (unsigned long)rc);
+        return false;
+    }
+
+    rc = threadStart(&g_logger_thread);
+    if (R_FAILED(rc)) {
+        g_logger_running = false;
+        threadClose(&g_logger_thread);
+        logger_write("logger: threadStart failed rc=0x%08lX, writing synchronously", (unsigned long)rc);
+        return false;
+    }
+
+    g_logger_async = true;
+    return true;
+}
+
+void logger_stop(void) {
+    g_logger_enabled = false;
+    if (g_logger_async) {
+        g_logger_running = false;
+        threadWaitForExit(&g_logger_thread);
+        threadClose(&g_logger_thread);
+        g_logger_async = false;
+    }
+
+    // Catches lines from callers that were already past the enabled check.
+    if (g_ring_ready) {
+        mutexLock(&g_sync_lock);
+        logger_drain();
+        mutexUnlock(&g_sync_lock);
+    }
+    if (g_log_file) {
+        fclose(g_log_file);
+        g_log_file = NULL;
+    }
+}
+
+// Copies one framed record into the ring. Never blocks: without room it is dropped.
+static void logger_push(const char* data, size_t len) {
+    const u32 count = (u32)((len + LOG_SLOT_BYTES - 1) / LOG_SLOT_BYTES);
+    u64 pos;
+    u32 i;
+
+    if (!logger_ring_claim(count, &pos)) {
+        __atomic_fetch_add(&g_dropped, 1, __ATOMIC_RELAXED);
         return;
     }
+    for (i = 0; i < count; i++) {
+        LogSlot* slot = &g_ring[(pos + i) & (LOG_RING_SLOTS - 1)];
+        const size_t offset = (size_t)i * LOG_SLOT_BYTES;
+        const size_t chunk = len - offset < LOG_SLOT_BYTES ? len - offset : LOG_SLOT_BYTES;
 
-    FILE* f = fopen(LOG_PATH, "a");
-    if (!f) {
+        memcpy(slot->text, data + offset, chunk);
+        slot->len = (u16)chunk;
+        slot->last = i + 1 == count;
+        __atomic_store_n(&slot->seq, pos + i + 1, __ATOMIC_RELEASE);
+    }
+
+    if (!g_logger_async) {
+        mutexLock(&g_sync_lock);
+        logger_drain();
+        mutexUnlock(&g_sync_lock);
+    }
+}
+
+void logger_event(LogEventId event, const u64* args, u32 arg_count) {
+    const LogEventDesc* desc = log_event_desc(event);
+    char line[LOG_LINE_MAX];
+    size_t len;
+
+    if (!g_logger_enabled || !desc) {
+        return;
+    }
+    if (arg_count > LOG_EVENT_MAX_ARGS) {
+        arg_count = LOG_EVENT_MAX_ARGS;
+    }
+
+    if (g_logger_binary) {
+        len = (size_t)arg_count * sizeof(u64);
+        logger_record_header(line, (u16)event, len);
+        memcpy(line + sizeof(LogRecordHeader), args, len);
+        len += sizeof(LogRecordHeader);
+    } else {
+        len = logger_text_prefix(line, sizeof(line) - 1);
+        len += log_event_format(desc, args, arg_count, line + len, sizeof(line) - 1 - len);
+        line[len++] = '\n';
+    }
+    logger_push(line, len);
+}
+
+void logger_vwrite(const char* fmt, va_list args) {
+    char line[LOG_LINE_MAX];
+    size_t len;
+
+    if (!g_logger_enabled) {
         return;
     }
 
-    const u64 sec_since_boot = armTicksToNs(armGetSystemTick()) / 1000000000ULL;
-    fprintf(f, "[%llu s] [line=%llu] ",
-            (unsigned long long)sec_since_boot,
-            (unsigned long long)g_log_line++);
-    vfprintf(f, fmt, args);
-    fputc('\n', f);
-    fclose(f);
+    // Formatted before claiming, so a slow vsnprintf never holds slots the flusher waits on.
+    if (g_logger_binary) {
+        const size_t room = sizeof(line) - sizeof(LogRecordHeader);
+
+        len = logger_clamp(vsnprintf(line + sizeof(LogRecordHeader), room, fmt, args), room);
+        logger_record_header(line, LogEvent_Text, len);
+        len += sizeof(LogRecordHeader);
+    } else {
+        // Long lines are truncated, keeping room for the newline that replaces the NUL.
+        len = logger_text_prefix(line, sizeof(line) - 1);
+        len += logger_clamp(vsnprintf(line + len, sizeof(line) - 1 - len, fmt, args), sizeof(line) - 1 - len);
+        line[len++] = '\n';
+    }
+    logger_push(line, len);
 }
 
 void logger_write(const char* fmt, ...) {
@@ -5,19 +5,31 @@
 #include <switch.h>
 #include "http_server.h"
 #include "logger.h"
+#include "process_watch.h"
+#include "session_journal.h"
+#include "status_file.h"
+#include "title_icons.h"
+#include "title_names.h"
 #include "telemetry.h"
+#include "udp_sender.h"
 
 #define INNER_HEAP_SIZE            0x400000
-#define LOOP_SLEEP_NS              (2ULL * 1000000000ULL)
+#define LOOP_SLEEP_NS              (2ULL * 1000000000ULL) // housekeeping tick; telemetry samples in between
+#define SAMPLE_MIN_SLEEP_NS        (10ULL * 1000000ULL)
 #define APPINIT_DELAY_NS           (20ULL * 1000000000ULL)
 #define INIT_RETRY_TICKS           3
 #define HEARTBEAT_TICKS            15
+#ifndef HTTP_PORT
 #define HTTP_PORT                  6029
-#define STATUS_PATH                "sdmc:/switch/switch-dcrpc/status.txt"
+#endif
 #define DETECTION_DISABLE_FLAG_PATH "sdmc:/switch/switch-dcrpc/detection.off"
+#define UDP_CONFIG_PATH            "sdmc:/switch/switch-dcrpc/udp.txt"
 #define ENABLE_PM_SERVICES         1
 #define ENABLE_DETECTION_WORKER    0
 #define ENABLE_RISKY_MAINLOOP_DETECTION 1
+#define ENABLE_PROCESS_EVENT_WATCH 1
+#define ENABLE_TITLE_NAMES         1
+#define ENABLE_SESSION_JOURNAL     1
 #define DETECTION_START_DELAY_SEC  45
 #define DETECTION_SLEEP_NS         (3ULL * 1000000000ULL)
 #define DETECTION_STACK_SIZE       (64 * 1024)
@@ -53,6 +65,7 @@ static u64 g_session_id = 0;
 static u64 g_heartbeat_count = 0;
 static bool g_unclean_prev = false;
 static bool g_ns_ready = false;
+static bool g_names_ns_ready = false; // main loop's ns session, for title names
 static bool g_detection_thread_started = false;
 static volatile bool g_detection_thread_running = false;
 static volatile bool g_detection_thread_alive = false;
@@ -60,6 +73,7 @@ static u64 g_detection_thread_last_heartbeat_sec = 0;
 static bool g_detection_services_ready = false;
 static bool g_detection_services_ready_logged = false;
 static u64 g_last_logged_active_program_id = 0;
+static u64 g_last_seen_active_program_id = 0;
 static bool g_detection_wait_logged = false;
 static bool g_detection_kill_switch = false;
 static u64 g_detection_attempt_count = 0;
@@ -74,6 +88,10 @@ static u8 g_detection_thread_stack[DETECTION_STACK_SIZE] __attribute__((aligned(
 
 static TelemetryState g_telemetry;
 static HttpServer g_server;
+static UdpSender g_udp;
+static ProcessWatch g_process_watch;
+static bool g_process_watch_started = false;
+static bool g_udp_checked = false;
 
 static u64 sec_since_boot_now(void) {
     return armTicksToNs(armGetSystemTick()) / 1000000000ULL;
@@ -81,7 +99,7 @@ static u64 sec_since_boot_now(void) {
 
 static void set_stage(const char* stage) {
     snprintf(g_stage, sizeof(g_stage), "%s", stage ? stage : "unknown");
-    logger_write("stage: %s", g_stage);
+    LOG_DEBUG(LogSys_Boot, "stage: %s", g_stage);
 }
 
 static bool file_exists(const char* path) {
@@ -91,6 +109,26 @@ static bool file_exists(const char* path) {
     return true;
 }
 
+// udp.txt holds one line: "broadcast" or an IPv4 address, optionally ":port". Absent means off.
+static void start_udp_sender_if_configured(void) {
+    char target[96];
+    bool started;
+    FILE* f;
+
+    g_udp_checked = true;
+    f = fopen(UDP_CONFIG_PATH, "r");
+    if (!f) return;
+    if (!fgets(target, sizeof(target), f)) {
+        fclose(f);
+        return;
+    }
+    fclose(f);
+    target[strcspn(target, "\r\n")] = '\0';
+
+    started = udp_sender_start(&g_udp, &g_telemetry, target);
+    LOG_INFO(LogSys_Udp, "udp: start %s target=%s", started ? "ok" : "failed", target);
+}
+
 static void refresh_detection_kill_switch(void) {
     bool enabled_now;
 
@@ -99,7 +137,7 @@ static void refresh_detection_kill_switch(void) {
     enabled_now = file_exists(DETECTION_DISABLE_FLAG_PATH);
     if (enabled_now != g_detection_kill_switch) {
         g_detection_kill_switch = enabled_now;
-        logger_write(
+        LOG_WARN(LogSys_Detector,
             "detector: kill-switch %s (%s)",
             g_detection_kill_switch ? "enabled" : "disabled",
             DETECTION_DISABLE_FLAG_PATH
@@ -107,19 +145,44 @@ static void refresh_detection_kill_switch(void) {
     }
 }
 
+// Swaps the hex placeholder for the title's name (NACP, else the TitleDB index); only a
+// title not in the name cache costs an ns call or a file read.
+static void resolve_active_title_name(u64 program_id, bool use_ns) {
+    char name[TITLE_NAME_MAX];
+    Result rc;
+
+    if (title_names_fetch(program_id, use_ns, name, sizeof(name), &rc)) {
+        telemetry_set_active_game(&g_telemetry, program_id, name);
+    } else {
+        LOG_DEBUG(LogSys_Detector,
+            "titles: no name for 0x%016llX rc=0x%08lX",
+            (unsigned long long)program_id,
+            (unsigned long)rc
+        );
+    }
+}
+
 static void log_active_title_if_changed(void) {
     u64 active_program_id = 0;
 
-    rmutexLock(&g_telemetry.lock);
-    active_program_id = g_telemetry.active_program_id;
-    rmutexUnlock(&g_telemetry.lock);
+    telemetry_get_active_program(&g_telemetry, &active_program_id, NULL, 0, NULL);
 
-    if (active_program_id == 0 || active_program_id == g_last_logged_active_program_id) {
+    if (active_program_id == g_last_seen_active_program_id) {
         return;
     }
+    g_last_seen_active_program_id = active_program_id;
+    if (active_program_id == 0) {
+        return;
+    }
+    if (ENABLE_TITLE_NAMES) {
+        resolve_active_title_name(active_program_id, g_names_ns_ready);
+    }
 
+    if (active_program_id == g_last_logged_active_program_id) {
+        return;
+    }
     g_last_logged_active_program_id = active_program_id;
-    logger_write("title: active_program_id=0x%016llX", (unsigned long long)active_program_id);
+    LOG_EVENT(LogLevel_Info, LogSys_Detector, LogEvent_Title, &active_program_id, 1);
 }
 
 static void detection_worker_thread(void* arg) {
@@ -128,7 +191,7 @@ static void detection_worker_thread(void* arg) {
 
     g_detection_thread_alive = true;
     g_detection_thread_last_heartbeat_sec = sec_since_boot_now();
-    logger_write(
+    LOG_INFO(LogSys_Detector,
         "detector: thread started prio=%d cpuid=%d",
         DETECTION_THREAD_PRIO,
         DETECTION_THREAD_CPUID
@@ -147,7 +210,7 @@ static void detection_worker_thread(void* arg) {
                 nsExit();
                 ns_ready_local = false;
                 g_ns_ready = false;
-                logger_write("detector: ns shutdown because kill-switch is active");
+                LOG_WARN(LogSys_Detector, "detector: ns shutdown because kill-switch is active");
             }
             svcSleepThread(DETECTION_SLEEP_NS);
             continue;
@@ -160,7 +223,7 @@ static void detection_worker_thread(void* arg) {
         if (g_detection_disabled_until_sec != 0) {
             g_detection_disabled_until_sec = 0;
             g_detection_fail_streak = 0;
-            logger_write("detector: cooldown elapsed, resuming");
+            LOG_INFO(LogSys_Detector, "detector: cooldown elapsed, resuming");
         }
 
         if (!ns_ready_local) {
@@ -168,14 +231,14 @@ static void detection_worker_thread(void* arg) {
             if (R_FAILED(g_detection_last_rc)) {
                 g_detection_fail_count++;
                 if (g_detection_fail_streak < 0xFFFFFFFFU) g_detection_fail_streak++;
-                logger_write(
+                LOG_WARN(LogSys_Detector,
                     "detector: nsInitialize failed rc=0x%08lX streak=%u",
                     (unsigned long)g_detection_last_rc,
                     (unsigned int)g_detection_fail_streak
                 );
                 if (g_detection_fail_streak >= DETECTION_FAIL_STREAK_MAX) {
                     g_detection_disabled_until_sec = now + DETECTION_COOLDOWN_SEC;
-                    logger_write(
+                    LOG_WARN(LogSys_Detector,
                         "detector: auto-cooldown for %us after init failures",
                         (unsigned int)DETECTION_COOLDOWN_SEC
                     );
@@ -187,29 +250,29 @@ static void detection_worker_thread(void* arg) {
             ns_ready_local = true;
             g_ns_ready = true;
             g_detection_fail_streak = 0;
-            logger_write("detector: ns ready");
+            LOG_INFO(LogSys_Detector, "detector: ns ready");
         }
 
         telemetry_update(&g_telemetry, true, g_psm_ready, g_applet_ready);
 
-        rmutexLock(&g_telemetry.lock);
-        ns_rc = g_telemetry.last_ns_result;
-        active_program_id = g_telemetry.active_program_id;
-        snprintf(active_game, sizeof(active_game), "%s", g_telemetry.active_game);
-        rmutexUnlock(&g_telemetry.lock);
+        telemetry_get_active_program(&g_telemetry, &active_program_id, active_game, sizeof(active_game), &ns_rc);
 
         g_detection_attempt_count++;
         g_detection_last_rc = ns_rc;
 
         if (R_SUCCEEDED(ns_rc)) {
             if (g_detection_fail_streak > 0) {
-                logger_write("detector: recovered after fail_streak=%u", (unsigned int)g_detection_fail_streak);
+                LOG_INFO(LogSys_Detector, "detector: recovered after fail_streak=%u", (unsigned int)g_detection_fail_streak);
             }
             g_detection_fail_streak = 0;
             g_detection_success_count++;
             if (active_program_id != g_detection_last_logged_program_id) {
                 g_detection_last_logged_program_id = active_program_id;
-                logger_write(
+                if (ENABLE_TITLE_NAMES && active_program_id != 0) {
+                    resolve_active_title_name(active_program_id, true);
+                    telemetry_get_active_program(&g_telemetry, NULL, active_game, sizeof(active_game), NULL);
+                }
+                LOG_INFO(LogSys_Detector,
                     "detector: active changed program=0x%016llX game=%s",
                     (unsigned long long)active_program_id,
                     active_game
@@ -219,7 +282,7 @@ static void detection_worker_thread(void* arg) {
             g_detection_fail_count++;
             if (g_detection_fail_streak < 0xFFFFFFFFU) g_detection_fail_streak++;
             if (g_detection_fail_streak == 1 || (g_detection_fail_streak % 3) == 0) {
-                logger_write(
+                LOG_WARN(LogSys_Detector,
                     "detector: query failed ns_rc=0x%08lX streak=%u",
                     (unsigned long)ns_rc,
                     (unsigned int)g_detection_fail_streak
@@ -227,7 +290,7 @@ static void detection_worker_thread(void* arg) {
             }
             if (g_detection_fail_streak >= DETECTION_FAIL_STREAK_MAX) {
                 g_detection_disabled_until_sec = now + DETECTION_COOLDOWN_SEC;
-                logger_write(
+                LOG_WARN(LogSys_Detector,
                     "detector: auto-cooldown for %us after query failures",
                     (unsigned int)DETECTION_COOLDOWN_SEC
                 );
@@ -235,7 +298,7 @@ static void detection_worker_thread(void* arg) {
                     nsExit();
                     ns_ready_local = false;
                     g_ns_ready = false;
-                    logger_write("detector: ns shutdown for cooldown");
+                    LOG_INFO(LogSys_Detector, "detector: ns shutdown for cooldown");
                 }
             }
         }
@@ -248,7 +311,7 @@ static void detection_worker_thread(void* arg) {
         g_ns_ready = false;
     }
     g_detection_thread_alive = false;
-    logger_write("detector: thread stopped");
+    LOG_INFO(LogSys_Detector, "detector: thread stopped");
 }
 
 static void stop_detection_worker(void) {
@@ -257,7 +320,7 @@ static void stop_detection_worker(void) {
     threadClose(&g_detection_thread);
     g_detection_thread_alive = false;
     g_detection_thread_started = false;
-    logger_write("detector: worker stop requested (non-blocking)");
+    LOG_INFO(LogSys_Detector, "detector: worker stop requested (non-blocking)");
 }
 
 static bool start_detection_worker(void) {
@@ -282,7 +345,7 @@ static bool start_detection_worker(void) {
     if (R_FAILED(rc)) {
         g_detection_thread_running = false;
         g_detection_last_rc = rc;
-        logger_write(
+        LOG_ERROR(LogSys_Detector,
             "detector: threadCreate failed rc=0x%08lX prio=%d cpuid=%d",
             (unsigned long)rc,
             DETECTION_THREAD_PRIO,
@@ -296,82 +359,54 @@ static bool start_detection_worker(void) {
         g_detection_thread_running = false;
         g_detection_last_rc = rc;
         threadClose(&g_detection_thread);
-        logger_write("detector: threadStart failed rc=0x%08lX", (unsigned long)rc);
+        LOG_ERROR(LogSys_Detector, "detector: threadStart failed rc=0x%08lX", (unsigned long)rc);
         return false;
     }
 
     g_detection_thread_started = true;
-    logger_write("detector: worker started");
+    LOG_INFO(LogSys_Detector, "detector: worker started");
     return true;
 }
 
 static void update_status_file(const char* state) {
-    FILE* f;
+    StatusRecord record;
 
     if (!g_fs_ready) return;
 
-    f = fopen(STATUS_PATH, "w");
-    if (!f) return;
-
-    fprintf(
-        f,
-        "state=%s\n"
-        "session_id=%llu\n"
-        "uptime_sec=%llu\n"
-        "stage=%s\n"
-        "last_rc=0x%08lX\n"
-        "heartbeats=%llu\n"
-        "sm=%d fs=%d setsys=%d applet=%d psm=%d pmshell=%d pminfo=%d nifm=%d socket=%d\n" 
-        "detector_started=%d detector_running=%d detector_ns=%d kill_switch=%d\n"
-        "detector_alive=%d detector_last_hb=%llu\n"
-        "detector_attempts=%llu detector_ok=%llu detector_fail=%llu detector_streak=%u\n"
-        "detector_cooldown_until=%llu detector_last_rc=0x%08lX\n",
-        state ? state : "UNKNOWN",
-        (unsigned long long)g_session_id,
-        (unsigned long long)sec_since_boot_now(),
-        g_stage,
-        (unsigned long)g_last_rc,
-        (unsigned long long)g_heartbeat_count,
-        g_sm_ready,
-        g_fs_ready,
-        g_setsys_ready,
-        g_applet_ready,
-        g_psm_ready,
-        g_pmshell_ready,
-        g_pminfo_ready,
-        g_nifm_ready,
-        g_socket_ready,
-        g_detection_thread_started,
-        g_detection_thread_running ? 1 : 0,
-        g_ns_ready,
-        g_detection_kill_switch,
-        g_detection_thread_alive ? 1 : 0,
-        (unsigned long long)g_detection_thread_last_heartbeat_sec,
-        (unsigned long long)g_detection_attempt_count,
-        (unsigned long long)g_detection_success_count,
-        (unsigned long long)g_detection_fail_count,
-        (unsigned int)g_detection_fail_streak,
-        (unsigned long long)g_detection_disabled_until_sec,
-        (unsigned long)g_detection_last_rc
-    );
-    fclose(f);
+    memset(&record, 0, sizeof(record)); // compared bytewise, padding included
+    snprintf(record.state, sizeof(record.state), "%s", state ? state : "UNKNOWN");
+    snprintf(record.stage, sizeof(record.stage), "%.*s", STATUS_STAGE_MAX - 1, g_stage);
+    record.session_id = g_session_id;
+    record.last_rc = g_last_rc;
+    record.sm = g_sm_ready;
+    record.fs = g_fs_ready;
+    record.setsys = g_setsys_ready;
+    record.applet = g_applet_ready;
+    record.psm = g_psm_ready;
+    record.pmshell = g_pmshell_ready;
+    record.pminfo = g_pminfo_ready;
+    record.nifm = g_nifm_ready;
+    record.socket = g_socket_ready;
+    record.detector_started = g_detection_thread_started;
+    record.detector_running = g_detection_thread_running;
+    record.detector_ns = g_ns_ready;
+    record.kill_switch = g_detection_kill_switch;
+    record.detector_alive = g_detection_thread_alive;
+    record.detector_last_hb = g_detection_thread_last_heartbeat_sec;
+    record.detector_attempts = g_detection_attempt_count;
+    record.detector_ok = g_detection_success_count;
+    record.detector_fail = g_detection_fail_count;
+    record.detector_streak = g_detection_fail_streak;
+    record.detector_cooldown_until = g_detection_disabled_until_sec;
+    record.detector_last_rc = g_detection_last_rc;
+
+    status_file_update(&record, sec_since_boot_now(), g_heartbeat_count);
 }
 
 static void detect_previous_unclean_shutdown(void) {
-    FILE* f;
-    char buf[512];
-    size_t n;
-
-    f = fopen(STATUS_PATH, "r");
-    if (!f) return;
-
-    n = fread(buf, 1, sizeof(buf) - 1, f);
-    fclose(f);
-    buf[n] = '\0';
-
-    if (strstr(buf, "state=RUNNING") != NULL) {
+    if (status_file_previous_unclean()) {
         g_unclean_prev = true;
-        logger_write("warn: previous session did not shutdown cleanly (possible crash/hang)");
+        LOG_WARN(LogSys_Boot, "warn: previous session did not shutdown cleanly (possible crash/hang)");
     }
 }
 
@@ -402,10 +437,12 @@ void __appInit(void) {
 
 void __appExit(void) {
     set_stage("exit");
-    logger_write("shutdown: begin");
+    LOG_INFO(LogSys_Boot, "shutdown: begin");
     update_status_file("STOPPED");
 
     stop_detection_worker();
+    process_watch_stop(&g_process_watch);
+    udp_sender_stop(&g_udp);
     http_server_stop(&g_server);
     if (g_socket_ready) socketExit();
     if (g_nifm_ready) nifmExit();
@@ -414,8 +451,18 @@ void __appExit(void) {
     if (g_pminfo_ready) pminfoExit();
     if (g_pmshell_ready) pmshellExit();
     if (g_ns_ready) nsExit();
+    if (g_names_ns_ready) {
+        title_icons_set_ns_ready(false);
+        nsExit();
+    }
     if (g_setsys_ready) setsysExit();
     if (g_fs_ready) {
+        if (ENABLE_SESSION_JOURNAL) {
+            session_journal_poll(&g_telemetry);
+            session_journal_stop();
+        }
+        status_file_close();
+        logger_stop();
         fsdevUnmountAll();
         fsExit();
     }
@@ -426,14 +473,104 @@ void __appExit(void) {
 }
 #endif
 
+static void log_heartbeat(bool http_started) {
+    const u64 heartbeat[] = {
+        g_heartbeat_count,
+        sec_since_boot_now(),
+        g_last_rc,
+        (g_sm_ready ? LogReady_Sm : 0) |
+            (g_fs_ready ? LogReady_Fs : 0) |
+            (g_setsys_ready ? LogReady_Setsys : 0) |
+            (g_applet_ready ? LogReady_Applet : 0) |
+            (g_pmshell_ready ? LogReady_Pmshell : 0) |
+            (g_pminfo_ready ? LogReady_Pminfo : 0) |
+            (g_nifm_ready ? LogReady_Nifm : 0) |
+            (g_socket_ready ? LogReady_Socket : 0) |
+            (http_started ? LogReady_HttpStarted : 0) |
+            (g_detection_thread_started ? LogReady_DetectorStarted : 0) |
+            (g_detection_thread_running ? LogReady_DetectorRun : 0) |
+            (g_detection_thread_alive ? LogReady_DetectorAlive : 0) |
+            (g_ns_ready ? LogReady_DetectorNs : 0) |
+            (g_detection_kill_switch ? LogReady_DetectorKill : 0) |
+            (g_unclean_prev ? LogReady_UncleanPrev : 0),
+        g_detection_thread_last_heartbeat_sec,
+        g_detection_fail_streak,
+        g_detection_disabled_until_sec,
+        g_telemetry.query_interval_ms,
+    };
+    const u64 http[] = {
+        g_server.accepted_count,
+        g_server.request_count,
+        g_server.rejected_count,
+        g_server.timeout_count,
+        g_server.not_modified_count,
+        g_server.state_cache_hits,
+        g_server.stream_count,
+        g_server.stream_events_sent,
+        g_server.active_connections,
+        g_server.peak_connections,
+        (u64)g_server.last_errno,
+    };
+
+    LOG_EVENT(LogLevel_Info, LogSys_Telemetry, LogEvent_Heartbeat, heartbeat, sizeof(heartbeat) / sizeof(heartbeat[0]));
+    LOG_EVENT(LogLevel_Debug, LogSys_Http, LogEvent_HeartbeatHttp, http, sizeof(http) / sizeof(http[0]));
+    if (g_udp.running) {
+        const u64 udp[] = {
+            g_udp.change_count,
+            g_udp.keepalive_count,
+            g_udp.send_error_count,
+            (u64)g_udp.last_errno,
+        };
+        LOG_EVENT(LogLevel_Debug, LogSys_Udp, LogEvent_HeartbeatUdp, udp, sizeof(udp) / sizeof(udp[0]));
+    }
+}
+
+// Sleeps out one housekeeping tick, waking whenever the telemetry scheduler has a sample due
+// or a query is requested (process event, returning client).
+static void sample_until_next_tick(bool pm_query_allowed) {
+    const u64 tick_end_ns = armTicksToNs(armGetSystemTick()) + LOOP_SLEEP_NS;
+
+    while (1) {
+        u64 now_ns = armTicksToNs(armGetSystemTick());
+        u64 sleep_ns;
+
+        if (now_ns >= tick_end_ns) {
+            return;
+        }
+        sleep_ns = telemetry_next_update_delay_ns(&g_telemetry);
+        if (sleep_ns < SAMPLE_MIN_SLEEP_NS) sleep_ns = SAMPLE_MIN_SLEEP_NS;
+        if (sleep_ns > tick_end_ns - now_ns) sleep_ns = tick_end_ns - now_ns;
+        telemetry_wait_for_kick(&g_telemetry, sleep_ns);
+
+        now_ns = armTicksToNs(armGetSystemTick());
+        if (now_ns >= tick_end_ns) {
+            return;
+        }
+        telemetry_update(&g_telemetry, pm_query_allowed, g_psm_ready, g_applet_ready);
+        if (pm_query_allowed) {
+            log_active_title_if_changed();
+        }
+        // Only reads the event ring unless the title changed.
+        if (ENABLE_SESSION_JOURNAL && g_fs_ready) {
+            session_journal_poll(&g_telemetry);
+        }
+        if (ENABLE_TITLE_NAMES && g_fs_ready) {
+            title_icons_service();
+        }
+    }
+}
+
 int main(int argc, char* argv[]) {
     u64 ticks = 0;
     bool http_started = false;
+    bool pm_query_allowed = false;
 
     (void)argc;
     (void)argv;
 
     memset(&g_server, 0, sizeof(g_server));
+    memset(&g_udp, 0, sizeof(g_udp));
+    memset(&g_process_watch, 0, sizeof(g_process_watch));
     telemetry_init(&g_telemetry);
     g_session_id = sec_since_boot_now();
 
@@ -452,8 +589,11 @@ int main(int argc, char* argv[]) {
                         g_fs_ready = true;
                         mkdir("sdmc:/switch", 0777);
                         mkdir("sdmc:/switch/switch-dcrpc", 0777);
-                        logger_set_enabled(true);
-                        logger_write("boot: fs ready");
+                        logger_start();
+                        title_names_load();
+                        title_icons_load();
+                        if (ENABLE_SESSION_JOURNAL) session_journal_load();
+                        LOG_INFO(LogSys_Boot, "boot: fs ready");
                         detect_previous_unclean_shutdown();
                         update_status_file("RUNNING");
                     } else {
@@ -474,7 +614,7 @@ int main(int argc, char* argv[]) {
                         snprintf(g_fw_str, sizeof(g_fw_str), "%u.%u.%u", fw.major, fw.minor, fw.micro);
                         g_fw_valid = true;
                         telemetry_set_firmware(&g_telemetry, g_fw_str);
-                        logger_write("init: firmware=%s", g_fw_str);
+                        LOG_INFO(LogSys_Boot, "init: firmware=%s", g_fw_str);
                     }
                     g_setsys_ready = true;
                 }
@@ -513,7 +653,12 @@ int main(int argc, char* argv[]) {
             if (g_socket_ready && !http_started) {
                 set_stage("http.start");
                 http_started = http_server_start(&g_server, &g_telemetry, HTTP_PORT);
-                logger_write("http: start %s port=%d", http_started ? "ok" : "failed", HTTP_PORT);
+                LOG_INFO(LogSys_Http, "http: start %s port=%d", http_started ? "ok" : "failed", HTTP_PORT);
+            }
+
+            if (http_started && g_fs_ready && !g_udp_checked) {
+                set_stage("udp.start");
+                start_udp_sender_if_configured();
             }
 
             refresh_detection_kill_switch();
@@ -526,9 +671,9 @@ int main(int argc, char* argv[]) {
                     g_last_rc = rc; 
                     if (R_SUCCEEDED(rc)) { 
                         g_pmshell_ready = true; 
-                        logger_write("init: pmshell ready"); 
+                        LOG_INFO(LogSys_Boot, "init: pmshell ready"); 
                     } else { 
-                        logger_write("init: pmshell failed rc=0x%08lX", (unsigned long)rc); 
+                        LOG_WARN(LogSys_Boot, "init: pmshell failed rc=0x%08lX", (unsigned long)rc); 
                     } 
                 } 
 
@@ -538,21 +683,45 @@ int main(int argc, char* argv[]) {
                     g_last_rc = rc;
                     if (R_SUCCEEDED(rc)) {
                         g_pminfo_ready = true;
-                        logger_write("init: pminfo ready");
+                        LOG_INFO(LogSys_Boot, "init: pminfo ready");
                     } else {
-                        logger_write("init: pminfo failed rc=0x%08lX", (unsigned long)rc);
+                        LOG_WARN(LogSys_Boot, "init: pminfo failed rc=0x%08lX", (unsigned long)rc);
                     }
                 }
                 
+                // Names only; detection works without it, so a failure is just retried.
+                if (ENABLE_TITLE_NAMES && !g_names_ns_ready) {
+                    set_stage("ns.init");
+                    rc = nsInitialize();
+                    g_last_rc = rc;
+                    if (R_SUCCEEDED(rc)) {
+                        g_names_ns_ready = true;
+                        title_icons_set_ns_ready(true); // /icon extracts through the same session
+                        LOG_INFO(LogSys_Boot, "init: ns ready");
+                    } else {
+                        LOG_WARN(LogSys_Boot, "init: ns failed rc=0x%08lX", (unsigned long)rc);
+                    }
+                }
+
                 g_detection_services_ready = (g_pmshell_ready && g_pminfo_ready); 
                 if (g_detection_services_ready && !g_detection_services_ready_logged) { 
                     g_detection_services_ready_logged = true; 
-                    logger_write( 
+                    LOG_INFO(LogSys_Detector, 
                         "detect: services ready (pmshell=%d pminfo=%d)", 
                         g_pmshell_ready, 
                         g_pminfo_ready 
                     ); 
                 } 
+
+                // One attempt only: on failure polling alone keeps detecting.
+                if (ENABLE_PROCESS_EVENT_WATCH && g_detection_services_ready && !g_process_watch_started) {
+                    set_stage("procwatch.start");
+                    g_process_watch_started = true;
+                    LOG_INFO(LogSys_Detector,
+                        "procwatch: start %s",
+                        process_watch_start(&g_process_watch, &g_telemetry) ? "ok" : "failed"
+                    );
+                }
             } 
 
             if (ENABLE_DETECTION_WORKER && http_started && !g_detection_thread_started && !g_detection_kill_switch) {
@@ -561,7 +730,7 @@ int main(int argc, char* argv[]) {
                     start_detection_worker();
                 } else if (!g_detection_wait_logged) {
                     g_detection_wait_logged = true;
-                    logger_write(
+                    LOG_INFO(LogSys_Detector,
                         "detector: delayed start active (uptime=%llus < %us)",
                         (unsigned long long)uptime,
                         (unsigned int)DETECTION_START_DELAY_SEC
@@ -575,7 +744,7 @@ int main(int argc, char* argv[]) {
                     (g_detection_thread_last_heartbeat_sec > 0) &&
                     ((now - g_detection_thread_last_heartbeat_sec) > DETECTION_HEARTBEAT_TIMEOUT_SEC);
                 if (!g_detection_thread_alive || stale_heartbeat) {
-                    logger_write(
+                    LOG_WARN(LogSys_Detector,
                         "detector: stale worker detected (alive=%d last_hb=%llus now=%llus), disabling detection",
                         g_detection_thread_alive ? 1 : 0,
                         (unsigned long long)g_detection_thread_last_heartbeat_sec,
@@ -584,7 +753,7 @@ int main(int argc, char* argv[]) {
                     g_detection_kill_switch = true;
                     g_detection_disabled_until_sec = now + DETECTION_STALE_DISABLE_SEC;
                     stop_detection_worker();
-                    logger_write(
+                    LOG_WARN(LogSys_Detector,
                         "detector: disabled for %us after stale worker",
                         (unsigned int)DETECTION_STALE_DISABLE_SEC
                     );
@@ -593,7 +762,7 @@ int main(int argc, char* argv[]) {
         }
 
         if (ticks == 0) {
-            logger_write(
+            LOG_INFO(LogSys_Telemetry,
                 "telemetry: mode=%s",
                 ENABLE_DETECTION_WORKER ? "worker-detection" :
                 (ENABLE_RISKY_MAINLOOP_DETECTION ?
@@ -601,53 +770,31 @@ int main(int argc, char* argv[]) {
                     : "safe-mode")
             );
         }
+        pm_query_allowed =
+            ENABLE_RISKY_MAINLOOP_DETECTION && http_started && g_detection_services_ready && !g_detection_kill_switch;
         set_stage("telemetry.update");
-        telemetry_update(
-            &g_telemetry,
-            ENABLE_RISKY_MAINLOOP_DETECTION && http_started && g_detection_services_ready && !g_detection_kill_switch,
-            g_psm_ready,
-            g_applet_ready
-        );
-        if (ENABLE_RISKY_MAINLOOP_DETECTION && http_started && g_detection_services_ready && !g_detection_kill_switch) {
+        telemetry_update(&g_telemetry, pm_query_allowed, g_psm_ready, g_applet_ready);
+        if (pm_query_allowed) {
             log_active_title_if_changed();
         }
+        if (ENABLE_SESSION_JOURNAL && g_fs_ready) {
+            session_journal_poll(&g_telemetry);
+        }
+        // /icon misses are extracted here, on the thread that owns the ns session.
+        if (ENABLE_TITLE_NAMES && g_fs_ready) {
+            title_icons_service();
+        }
 
         if ((ticks % HEARTBEAT_TICKS) == 0) {
-            char dbg[512];
             g_heartbeat_count++;
             set_stage("heartbeat");
-            http_server_build_debug_json(&g_server, dbg, sizeof(dbg));
-            logger_write(
-                "heartbeat: n=%llu uptime=%llus stage=%s rc=0x%08lX sm=%d fs=%d setsys=%d applet=%d pmshell=%d pminfo=%d nifm=%d socket=%d http_started=%d detector_started=%d detector_run=%d detector_alive=%d detector_hb=%llu detector_ns=%d detector_streak=%u detector_kill=%d cooldown_until=%llu unclean_prev=%d", 
-                (unsigned long long)g_heartbeat_count,
-                (unsigned long long)sec_since_boot_now(),
-                g_stage,
-                (unsigned long)g_last_rc,
-                g_sm_ready,
-                g_fs_ready,
-                g_setsys_ready,
-                g_applet_ready,
-                g_pmshell_ready, 
-                g_pminfo_ready, 
-                g_nifm_ready,
-                g_socket_ready,
-                http_started,
-                g_detection_thread_started,
-                g_detection_thread_running ? 1 : 0,
-                g_detection_thread_alive ? 1 : 0,
-                (unsigned long long)g_detection_thread_last_heartbeat_sec,
-                g_ns_ready,
-                (unsigned int)g_detection_fail_streak,
-                g_detection_kill_switch,
-                (unsigned long long)g_detection_disabled_until_sec,
-                g_unclean_prev
-            );
-            logger_write("heartbeat-http: %s", dbg);
+            logger_load_config();
+            log_heartbeat(http_started);
             update_status_file("RUNNING");
         }
 
         ticks++;
-        svcSleepThread(LOOP_SLEEP_NS);
+        sample_until_next_tick(pm_query_allowed);
     }
 
     return 0;
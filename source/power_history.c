@@ -0,0 +1,281 @@
+#include "power_history.h"
+
+#include "json_writer.h"
+
+#include <string.h>
+
+#define BATTERY_UNKNOWN 0xFF
+#define DRAIN_FIXED_SHIFT 4 // drain estimate is kept in 1/16 s per percent
+#define DRAIN_EWMA_SHIFT 2  // each new step moves the estimate a quarter of the way
+#define HISTORY_TAIL_ROOM 40 // `],"next":<u64>}` after the last entry that fits
+
+typedef struct {
+    PowerAggregate* slots;
+    u32 capacity;
+    u32 width_sec;
+    u32 head; // oldest closed bucket
+    u32 count;
+    PowerAggregate open; // bucket being filled; empty while samples == 0
+} PowerTier;
+
+static Mutex g_lock;
+static PowerSample g_raw[POWER_HISTORY_RAW_CAPACITY];
+static u32 g_raw_head = 0;
+static u32 g_raw_count = 0;
+static PowerAggregate g_minute_slots[POWER_HISTORY_MINUTE_CAPACITY];
+static PowerAggregate g_ten_minute_slots[POWER_HISTORY_TEN_MINUTE_CAPACITY];
+static PowerTier g_minute = { g_minute_slots, POWER_HISTORY_MINUTE_CAPACITY, 60, 0, 0, { 0 } };
+static PowerTier g_ten_minute = { g_ten_minute_slots, POWER_HISTORY_TEN_MINUTE_CAPACITY, 600, 0, 0, { 0 } };
+
+// Discharge tracking. Time is measured between observed percent drops, so the first drop
+// after unplugging (a partial percent) only sets the anchor.
+static bool g_discharging = false;
+static u8 g_step_percent = BATTERY_UNKNOWN;
+static u32 g_step_time = 0;   // time of the last drop; 0 = waiting for the first one
+static u32 g_drain_fixed = 0; // seconds per percent << DRAIN_FIXED_SHIFT; 0 = no estimate yet
+static u32 g_drain_steps = 0;
+
+static void aggregate_merge(PowerAggregate* dst, const PowerAggregate* src) {
+    if (dst->samples == 0) {
+        dst->battery_min = BATTERY_UNKNOWN;
+        dst->battery_max = 0;
+    }
+    dst->samples += src->samples;
+    dst->charging_samples += src->charging_samples;
+    dst->docked_samples += src->docked_samples;
+    if (src->battery_samples > 0) {
+        dst->battery_samples += src->battery_samples;
+        dst->battery_sum += src->battery_sum;
+        if (src->battery_min < dst->battery_min) dst->battery_min = src->battery_min;
+        if (src->battery_max > dst->battery_max) dst->battery_max = src->battery_max;
+        dst->battery_last = src->battery_last;
+    }
+}
+
+// Folds in into the tier's open bucket. When in starts a new bucket, the open one is stored
+// (overwriting the oldest when full), copied to *closed and true is returned.
+static bool tier_add(PowerTier* tier, const PowerAggregate* in, PowerAggregate* closed) {
+    const u32 start = in->start_sec - in->start_sec % tier->width_sec;
+    bool did_close = false;
+
+    if (tier->open.samples > 0 && tier->open.start_sec != start) {
+        *closed = tier->open;
+        tier->slots[(tier->head + tier->count) % tier->capacity] = tier->open;
+        if (tier->count < tier->capacity) {
+            tier->count++;
+        } else {
+            tier->head = (tier->head + 1) % tier->capacity;
+        }
+        memset(&tier->open, 0, sizeof(tier->open));
+        did_close = true;
+    }
+    if (tier->open.samples == 0) {
+        tier->open.start_sec = start;
+    }
+    aggregate_merge(&tier->open, in);
+    return did_close;
+}
+
+static void update_drain_locked(u32 now, bool battery_valid, u8 percent, bool discharging) {
+    if (!discharging || !battery_valid) {
+        g_discharging = false;
+        return;
+    }
+    if (!g_discharging || percent > g_step_percent) {
+        // Just unplugged, or the reading went up: start over and wait for a drop.
+        g_discharging = true;
+        g_step_percent = percent;
+        g_step_time = 0;
+        return;
+    }
+    if (percent == g_step_percent) {
+        return;
+    }
+    if (g_step_time != 0 && now > g_step_time) {
+        const u32 step = ((now - g_step_time) << DRAIN_FIXED_SHIFT) / (u32)(g_step_percent - percent);
+
+        if (g_drain_fixed == 0) {
+            g_drain_fixed = step;
+        } else if (step >= g_drain_fixed) {
+            g_drain_fixed += (step - g_drain_fixed) >> DRAIN_EWMA_SHIFT;
+        } else {
+            g_drain_fixed -= (g_drain_fixed - step) >> DRAIN_EWMA_SHIFT;
+        }
+        g_drain_steps++;
+    }
+    g_step_percent = percent;
+    g_step_time = now;
+}
+
+void power_history_add(
+    u64 time_sec,
+    bool battery_valid,
+    u32 battery_percent,
+    bool charging_valid,
+    bool charging,
+    bool docked_valid,
+    bool docked
+) {
+    const u32 now = (u32)time_sec;
+    const u8 percent = battery_valid ? (u8)(battery_percent > 100 ? 100 : battery_percent) : BATTERY_UNKNOWN;
+    PowerSample sample;
+    PowerAggregate one;
+    PowerAggregate minute;
+    PowerAggregate unused;
+
+    memset(&sample, 0, sizeof(sample));
+    sample.time_sec = now;
+    sample.battery_percent = percent;
+    if (charging_valid) sample.flags |= PowerSampleFlag_ChargingValid | (charging ? PowerSampleFlag_Charging : 0);
+    if (docked_valid) sample.flags |= PowerSampleFlag_DockedValid | (docked ? PowerSampleFlag_Docked : 0);
+
+    memset(&one, 0, sizeof(one));
+    one.start_sec = now;
+    one.samples = 1;
+    if (battery_valid) {
+        one.battery_samples = 1;
+        one.battery_sum = percent;
+        one.battery_min = percent;
+        one.battery_max = percent;
+        one.battery_last = percent;
+    }
+    one.charging_samples = charging_valid && charging ? 1 : 0;
+    one.docked_samples = docked_valid && docked ? 1 : 0;
+
+    mutexLock(&g_lock);
+    g_raw[(g_raw_head + g_raw_count) % POWER_HISTORY_RAW_CAPACITY] = sample;
+    if (g_raw_count < POWER_HISTORY_RAW_CAPACITY) {
+        g_raw_count++;
+    } else {
+        g_raw_head = (g_raw_head + 1) % POWER_HISTORY_RAW_CAPACITY;
+    }
+    if (tier_add(&g_minute, &one, &minute)) {
+        tier_add(&g_ten_minute, &minute, &unused);
+    }
+    update_drain_locked(now, battery_valid, percent, charging_valid && !charging);
+    mutexUnlock(&g_lock);
+}
+
+static void json_u32_or_null(JsonWriter* w, bool valid, u32 value) {
+    if (valid) {
+        json_u64(w, value);
+    } else {
+        json_null(w);
+    }
+}
+
+// [time_sec, battery_percent, is_charging, is_docked]
+static void json_sample(JsonWriter* w, const PowerSample* s) {
+    json_array_begin(w);
+    json_u64(w, s->time_sec);
+    json_u32_or_null(w, s->battery_percent != BATTERY_UNKNOWN, s->battery_percent);
+    json_tristate(w, (s->flags & PowerSampleFlag_ChargingValid) != 0, (s->flags & PowerSampleFlag_Charging) != 0);
+    json_tristate(w, (s->flags & PowerSampleFlag_DockedValid) != 0, (s->flags & PowerSampleFlag_Docked) != 0);
+    json_array_end(w);
+}
+
+// [start_sec, samples, battery_avg, battery_min, battery_max, charging_samples, docked_samples]
+static void json_aggregate(JsonWriter* w, const PowerAggregate* a) {
+    const bool battery = a->battery_samples > 0;
+
+    json_array_begin(w);
+    json_u64(w, a->start_sec);
+    json_u64(w, a->samples);
+    json_u32_or_null(w, battery, battery ? (a->battery_sum + a->battery_samples / 2) / a->battery_samples : 0);
+    json_u32_or_null(w, battery, a->battery_min);
+    json_u32_or_null(w, battery, a->battery_max);
+    json_u64(w, a->charging_samples);
+    json_u64(w, a->docked_samples);
+    json_array_end(w);
+}
+
+void power_history_build_json(u64 res_sec, u64 since_sec, char* out, size_t out_size) {
+    const PowerTier* tier = res_sec == 60 ? &g_minute : (res_sec == 600 ? &g_ten_minute : NULL);
+    JsonWriter w;
+    u64 next = since_sec;
+    u32 count;
+    u32 i;
+
+    json_writer_init(&w, out, out_size);
+    mutexLock(&g_lock);
+    json_object_begin(&w);
+    json_key(&w, "res_sec");
+    json_u64(&w, tier ? tier->width_sec : 0);
+    json_key(&w, "capacity");
+    json_u64(&w, tier ? tier->capacity : POWER_HISTORY_RAW_CAPACITY);
+    json_key(&w, "discharging");
+    json_bool(&w, g_discharging);
+    json_key(&w, "drain_sec_per_percent");
+    json_u32_or_null(&w, g_drain_fixed != 0, g_drain_fixed >> DRAIN_FIXED_SHIFT);
+    json_key(&w, "drain_steps");
+    json_u64(&w, g_drain_steps);
+    json_key(&w, "time_to_empty_sec");
+    json_u32_or_null(
+        &w,
+        g_discharging && g_drain_fixed != 0,
+        (u32)(((u64)g_step_percent * g_drain_fixed) >> DRAIN_FIXED_SHIFT)
+    );
+    json_key(&w, "fields");
+    json_array_begin(&w);
+    if (tier) {
+        json_string(&w, "start_sec");
+        json_string(&w, "samples");
+        json_string(&w, "battery_avg");
+        json_string(&w, "battery_min");
+        json_string(&w, "battery_max");
+        json_string(&w, "charging_samples");
+        json_string(&w, "docked_samples");
+    } else {
+        json_string(&w, "time_sec");
+        json_string(&w, "battery_percent");
+        json_string(&w, "is_charging");
+        json_string(&w, "is_docked");
+    }
+    json_array_end(&w);
+    // The bucket still being filled; it reappears in samples once closed.
+    if (tier) {
+        json_key(&w, "current");
+        if (tier->open.samples > 0) {
+            json_aggregate(&w, &tier->open);
+        } else {
+            json_null(&w);
+        }
+    }
+
+    json_key(&w, "samples");
+    json_array_begin(&w);
+    count = tier ? tier->count : g_raw_count;
+    for (i = 0; i < count; i++) {
+        JsonWriterMark mark;
+        u32 time_sec;
+
+        if (tier) {
+            time_sec = tier->slots[(tier->head + i) % tier->capacity].start_sec;
+        } else {
+            time_sec = g_raw[(g_raw_head + i) % POWER_HISTORY_RAW_CAPACITY].time_sec;
+        }
+        if (time_sec < since_sec) {
+            continue;
+        }
+        mark = json_writer_mark(&w);
+        if (tier) {
+            json_aggregate(&w, &tier->slots[(tier->head + i) % tier->capacity]);
+        } else {
+            json_sample(&w, &g_raw[(g_raw_head + i) % POWER_HISTORY_RAW_CAPACITY]);
+        }
+        if (w.overflow || json_writer_room(&w) < HISTORY_TAIL_ROOM) {
+            json_writer_rewind(&w, mark);
+            break;
+        }
+        next = (u64)time_sec + 1;
+    }
+    mutexUnlock(&g_lock);
+    json_array_end(&w);
+    // Pass as since to continue after the last entry returned.
+    json_key(&w, "next");
+    json_u64(&w, next);
+    json_object_end(&w);
+    if (!json_writer_finish(&w) && out_size > 0) {
+        out[0] = '\0';
+    }
+}
@@ -0,0 +1,104 @@
+#include "process_watch.h"
+
+#include "logger.h"
+
+#include <string.h>
+
+#define WATCH_STACK_SIZE (16 * 1024)
+#define WATCH_THREAD_PRIO 0x2C
+#define WATCH_THREAD_CPUID -2
+#define WATCH_WAIT_SLICE_NS (1000ULL * 1000000ULL) // bounds how long process_watch_stop waits
+#define WATCH_SETTLE_MIN_NS (100ULL * 1000000ULL)
+#define WATCH_SETTLE_MAX_NS (1000ULL * 1000000ULL)
+
+static u8 g_watch_thread_stack[WATCH_STACK_SIZE] __attribute__((aligned(0x1000)));
+
+// The event is only observed. Its info queue belongs to ns, which drains it with
+// GetProcessEventInfo and thereby clears the event; reading or clearing it here would
+// steal launches from the system. While it stays signaled the settle delay doubles so a
+// slow consumer cannot turn this thread into a spin.
+static void process_watch_thread(void* arg) {
+    ProcessWatch* watch = (ProcessWatch*)arg;
+    u64 settle_ns = WATCH_SETTLE_MIN_NS;
+
+    while (watch->running) {
+        const Result rc = eventWait(&watch->event, WATCH_WAIT_SLICE_NS);
+
+        if (R_VALUE(rc) == KERNELRESULT(TimedOut)) {
+            settle_ns = WATCH_SETTLE_MIN_NS;
+            continue;
+        }
+        if (R_FAILED(rc)) {
+            watch->last_result = rc;
+            LOG_WARN(LogSys_Detector, "procwatch: wait failed rc=0x%08lX, falling back to polling", (unsigned long)rc);
+            break;
+        }
+
+        watch->wake_count++;
+        telemetry_request_query(watch->telemetry);
+        watch->kick_count++;
+
+        svcSleepThread(settle_ns);
+        if (settle_ns < WATCH_SETTLE_MAX_NS) {
+            settle_ns *= 2;
+        }
+    }
+
+    telemetry_set_event_driven(watch->telemetry, false);
+}
+
+bool process_watch_start(ProcessWatch* watch, TelemetryState* telemetry) {
+    Result rc;
+
+    memset(watch, 0, sizeof(*watch));
+    watch->telemetry = telemetry;
+
+    rc = pmshellGetProcessEventHandle(&watch->event);
+    if (R_FAILED(rc)) {
+        watch->last_result = rc;
+        LOG_WARN(LogSys_Detector, "procwatch: GetProcessEventHandle failed rc=0x%08lX", (unsigned long)rc);
+        return false;
+    }
+
+    watch->running = true;
+    rc = threadCreate(
+        &watch->thread,
+        process_watch_thread,
+        watch,
+        g_watch_thread_stack,
+        WATCH_STACK_SIZE,
+        WATCH_THREAD_PRIO,
+        WATCH_THREAD_CPUID
+    );
+    if (R_FAILED(rc)) {
+        LOG_ERROR(LogSys_Detector, "procwatch: threadCreate failed rc=0x%08lX", (unsigned long)rc);
+        watch->running = false;
+        eventClose(&watch->event);
+        return false;
+    }
+
+    // Set before the thread runs so a thread that fails right away can clear it again.
+    telemetry_set_event_driven(telemetry, true);
+    rc = threadStart(&watch->thread);
+    if (R_FAILED(rc)) {
+        LOG_ERROR(LogSys_Detector, "procwatch: threadStart failed rc=0x%08lX", (unsigned long)rc);
+        telemetry_set_event_driven(telemetry, false);
+        threadClose(&watch->thread);
+        watch->running = false;
+        eventClose(&watch->event);
+        return false;
+    }
+
+    return true;
+}
+
+void process_watch_stop(ProcessWatch* watch) {
+    if (!watch->running) {
+        return;
+    }
+
+    watch->running = false;
+    threadWaitForExit(&watch->thread);
+    threadClose(&watch->thread);
+    eventClose(&watch->event);
+}
@@ -0,0 +1,534 @@
+#include "session_journal.h"
+
+#include "json_writer.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define JOURNAL_PATH "sdmc:/switch/switch-dcrpc/sessions.bin"
+#define JOURNAL_TMP_PATH "sdmc:/switch/switch-dcrpc/sessions.tmp"
+#define TOTALS_PATH "sdmc:/switch/switch-dcrpc/sessions_totals.bin"
+#define JOURNAL_MAGIC 0x4A584E52u // "RNXJ"
+#define JOURNAL_VERSION 1
+#define TOTALS_MAGIC 0x55584E52u // "RNXU"
+#define TOTALS_VERSION 1
+#define JOURNAL_CHUNK 8 // records per read while compacting or rendering
+#define COMPACT_RETRY_AFTER 64 // appends before a failed compaction is tried again
+#define EVENTS_PER_POLL 8
+#define HISTORY_TAIL_ROOM 40 // `],"next":<u64>}` after the last session that fits
+
+// sessions.bin: this header, then SessionRecords back to back. The record count follows from
+// the file size; a torn record at the end is ignored and overwritten by the next append.
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 record_size;
+    u32 boot;
+    u32 reserved;
+    u64 base_index; // records removed by compaction; record i (from 0) has index base_index + i + 1
+} SessionJournalHeader;
+
+// sessions_totals.bin: this header, then count SessionTotal slots.
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 count;
+    u32 other_sessions; // titles evicted from the table, summed
+    u32 reserved;
+    u64 folded_through; // newest record index already in the totals
+    u64 other_sec;
+} SessionTotalsHeader;
+
+typedef struct {
+    u64 program_id; // 0 = empty slot
+    u64 last_index; // newest session folded in; the smallest is evicted when the table is full
+    u32 sessions;
+    u32 reserved;
+    u64 total_sec;
+    u64 docked_sec;
+} SessionTotal;
+
+static Mutex g_lock;
+static FILE* g_file = NULL;
+static bool g_on_copy = false; // appending to sessions.tmp: a compaction could not move it into place
+static u32 g_compact_at = SESSION_JOURNAL_COMPACT_AT;
+static SessionJournalHeader g_header;
+static u32 g_count = 0; // records in sessions.bin
+static SessionTotalsHeader g_totals_header;
+static SessionTotal g_totals[SESSION_TOTALS_CAPACITY];
+static u64 g_event_cursor = 0;
+static bool g_open = false;
+static SessionRecord g_current; // duration_sec is filled in when the session closes
+static u64 g_segment_start = 0; // last dock flip (or session start), seconds since boot
+static bool g_docked = false;
+
+static u64 sec_since_boot_now(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000000ULL;
+}
+
+static long record_offset(u32 pos) {
+    return (long)(sizeof(SessionJournalHeader) + (u64)pos * sizeof(SessionRecord));
+}
+
+static bool read_records_locked(u32 pos, SessionRecord* out, u32 n) {
+    return g_file && fseek(g_file, record_offset(pos), SEEK_SET) == 0 &&
+        fread(out, sizeof(*out), n, g_file) == n;
+}
+
+static bool write_header_locked(void) {
+    return fseek(g_file, 0, SEEK_SET) == 0 &&
+        fwrite(&g_header, sizeof(g_header), 1, g_file) == 1 &&
+        fflush(g_file) == 0;
+}
+
+static void load_totals_locked(void) {
+    FILE* f;
+
+    memset(&g_totals_header, 0, sizeof(g_totals_header));
+    memset(g_totals, 0, sizeof(g_totals));
+    f = fopen(TOTALS_PATH, "rb");
+    if (!f) return;
+    if (fread(&g_totals_header, sizeof(g_totals_header), 1, f) != 1 ||
+        g_totals_header.magic != TOTALS_MAGIC ||
+        g_totals_header.version != TOTALS_VERSION ||
+        g_totals_header.count > SESSION_TOTALS_CAPACITY ||
+        fread(g_totals, sizeof(g_totals[0]), g_totals_header.count, f) != g_totals_header.count) {
+        memset(&g_totals_header, 0, sizeof(g_totals_header));
+        memset(g_totals, 0, sizeof(g_totals));
+    }
+    fclose(f);
+}
+
+static bool save_totals_locked(void) {
+    FILE* f;
+    bool ok;
+
+    g_totals_header.magic = TOTALS_MAGIC;
+    g_totals_header.version = TOTALS_VERSION;
+    g_totals_header.count = SESSION_TOTALS_CAPACITY;
+    f = fopen(TOTALS_PATH, "wb");
+    if (!f) return false;
+    ok = fwrite(&g_totals_header, sizeof(g_totals_header), 1, f) == 1 &&
+        fwrite(g_totals, sizeof(g_totals[0]), SESSION_TOTALS_CAPACITY, f) == SESSION_TOTALS_CAPACITY;
+    return fclose(f) == 0 && ok;
+}
+
+static void fold_locked(const SessionRecord* rec, u64 index) {
+    SessionTotal* total = NULL;
+    SessionTotal* oldest = NULL;
+    int i;
+
+    for (i = 0; i < SESSION_TOTALS_CAPACITY; i++) {
+        if (g_totals[i].program_id == rec->program_id) {
+            total = &g_totals[i];
+            break;
+        }
+        if (!oldest || g_totals[i].last_index < oldest->last_index) {
+            oldest = &g_totals[i];
+        }
+    }
+    if (!total) {
+        total = oldest;
+        if (total->program_id != 0) {
+            g_totals_header.other_sessions += total->sessions;
+            g_totals_header.other_sec += total->total_sec;
+        }
+        memset(total, 0, sizeof(*total));
+        total->program_id = rec->program_id;
+    }
+    total->sessions++;
+    total->total_sec += rec->duration_sec;
+    total->docked_sec += rec->docked_sec;
+    total->last_index = index;
+}
+
+// Folds all but the newest SESSION_JOURNAL_KEEP records into the totals and rewrites the
+// journal without them. Totals are saved first and remember how far they reach, so a crash
+// before the journal is replaced only means those records are skipped next time. The old
+// journal is removed before the copy is renamed over it (fsdev will not rename onto an existing
+// file); session_journal_load picks up the copy if a crash falls in between. Returns false if
+// the journal was left as it was.
+static bool compact_locked(void) {
+    SessionRecord chunk[JOURNAL_CHUNK];
+    SessionJournalHeader header = g_header;
+    const u32 fold = g_count - SESSION_JOURNAL_KEEP;
+    FILE* tmp;
+    bool ok;
+    u32 pos;
+    u32 n;
+    u32 i;
+
+    if (g_on_copy) {
+        // Still running on the copy; writing a new copy would truncate the live file.
+        return false;
+    }
+    for (pos = 0; pos < fold; pos += n) {
+        n = fold - pos < JOURNAL_CHUNK ? fold - pos : JOURNAL_CHUNK;
+        if (!read_records_locked(pos, chunk, n)) {
+            LOG_WARN(LogSys_Telemetry, "history: compaction read failed at %u", pos);
+            return false;
+        }
+        for (i = 0; i < n; i++) {
+            const u64 index = g_header.base_index + pos + i + 1;
+            if (index > g_totals_header.folded_through) {
+                fold_locked(&chunk[i], index);
+                g_totals_header.folded_through = index;
+            }
+        }
+    }
+    // Until the totals are on the SD card the records must stay in the journal; folded_through
+    // keeps the retry from counting them twice.
+    if (!save_totals_locked()) {
+        LOG_WARN(LogSys_Telemetry, "history: totals write failed");
+        return false;
+    }
+
+    header.base_index += fold;
+    tmp = fopen(JOURNAL_TMP_PATH, "wb");
+    if (!tmp) {
+        LOG_WARN(LogSys_Telemetry, "history: compaction could not create %s", JOURNAL_TMP_PATH);
+        return false;
+    }
+    ok = fwrite(&header, sizeof(header), 1, tmp) == 1;
+    for (pos = fold; ok && pos < g_count; pos += n) {
+        n = g_count - pos < JOURNAL_CHUNK ? g_count - pos : JOURNAL_CHUNK;
+        ok = read_records_locked(pos, chunk, n) && fwrite(chunk, sizeof(chunk[0]), n, tmp) == n;
+    }
+    ok = fclose(tmp) == 0 && ok;
+    if (!ok) {
+        remove(JOURNAL_TMP_PATH);
+        LOG_WARN(LogSys_Telemetry, "history: compaction write failed");
+        return false;
+    }
+
+    fclose(g_file);
+    g_file = NULL;
+    if (remove(JOURNAL_PATH) != 0) {
+        LOG_WARN(LogSys_Telemetry, "history: compaction could not remove %s", JOURNAL_PATH);
+        remove(JOURNAL_TMP_PATH);
+        g_file = fopen(JOURNAL_PATH, "r+b");
+        return false;
+    }
+    if (rename(JOURNAL_TMP_PATH, JOURNAL_PATH) != 0) {
+        // The copy is complete and now the only one; keep appending to it and let the next
+        // load move it into place.
+        LOG_WARN(LogSys_Telemetry, "history: compaction could not rename %s", JOURNAL_TMP_PATH);
+        g_on_copy = true;
+    }
+    g_file = fopen(g_on_copy ? JOURNAL_TMP_PATH : JOURNAL_PATH, "r+b");
+    g_header = header;
+    g_count -= fold;
+    LOG_INFO(LogSys_Telemetry,
+        "history: compacted %u sessions, base=%llu",
+        fold,
+        (unsigned long long)g_header.base_index
+    );
+    return true;
+}
+
+static void append_locked(const SessionRecord* rec) {
+    const char* path = g_on_copy ? JOURNAL_TMP_PATH : JOURNAL_PATH;
+
+    if (!g_file) {
+        g_file = fopen(path, "r+b");
+    }
+    if (!g_file) {
+        LOG_WARN(LogSys_Telemetry, "history: %s is not open, session dropped", path);
+        return;
+    }
+    if (fseek(g_file, record_offset(g_count), SEEK_SET) != 0 ||
+        fwrite(rec, sizeof(*rec), 1, g_file) != 1 ||
+        fflush(g_file) != 0) {
+        LOG_WARN(LogSys_Telemetry, "history: append failed");
+        return;
+    }
+    g_count++;
+    if (g_count >= g_compact_at) {
+        // A failed compaction is retried after a while rather than on every append.
+        g_compact_at = compact_locked() ? SESSION_JOURNAL_COMPACT_AT : g_count + COMPACT_RETRY_AFTER;
+    }
+}
+
+void session_journal_load(void) {
+    long size;
+
+    mutexLock(&g_lock);
+    load_totals_locked();
+
+    g_on_copy = false;
+    g_compact_at = SESSION_JOURNAL_COMPACT_AT;
+    g_file = fopen(JOURNAL_PATH, "r+b");
+    if (g_file) {
+        // A copy left beside the journal is from a compaction that never got as far as
+        // removing it; the journal itself is still whole.
+        remove(JOURNAL_TMP_PATH);
+    } else if (rename(JOURNAL_TMP_PATH, JOURNAL_PATH) == 0) {
+        // Only the finished copy survived the last compaction.
+        LOG_WARN(LogSys_Telemetry, "history: recovered %s from %s", JOURNAL_PATH, JOURNAL_TMP_PATH);
+        g_file = fopen(JOURNAL_PATH, "r+b");
+    }
+    if (g_file &&
+        (fread(&g_header, sizeof(g_header), 1, g_file) != 1 ||
+         g_header.magic != JOURNAL_MAGIC ||
+         g_header.version != JOURNAL_VERSION ||
+         g_header.record_size != sizeof(SessionRecord))) {
+        LOG_WARN(LogSys_Telemetry, "history: discarding unreadable %s", JOURNAL_PATH);
+        fclose(g_file);
+        g_file = NULL;
+    }
+    if (!g_file) {
+        memset(&g_header, 0, sizeof(g_header));
+        g_header.magic = JOURNAL_MAGIC;
+        g_header.version = JOURNAL_VERSION;
+        g_header.record_size = sizeof(SessionRecord);
+        // Indices stay ahead of anything the surviving totals already hold.
+        g_header.base_index = g_totals_header.folded_through;
+        g_file = fopen(JOURNAL_PATH, "w+b");
+    }
+    if (!g_file) {
+        mutexUnlock(&g_lock);
+        LOG_WARN(LogSys_Telemetry, "history: cannot open %s", JOURNAL_PATH);
+        return;
+    }
+
+    g_count = 0;
+    if (fseek(g_file, 0, SEEK_END) == 0 && (size = ftell(g_file)) > (long)sizeof(g_header)) {
+        g_count = (u32)(((u64)size - sizeof(g_header)) / sizeof(SessionRecord));
+    }
+    g_header.boot++;
+    if (!write_header_locked()) {
+        LOG_WARN(LogSys_Telemetry, "history: header write failed");
+    }
+    mutexUnlock(&g_lock);
+
+    LOG_INFO(LogSys_Telemetry,
+        "history: boot=%u sessions=%u base=%llu",
+        g_header.boot,
+        g_count,
+        (unsigned long long)g_header.base_index
+    );
+}
+
+static void set_docked_locked(u64 now, bool docked) {
+    if (g_open && g_docked && now > g_segment_start) {
+        g_current.docked_sec += (u32)(now - g_segment_start);
+    }
+    g_segment_start = now;
+    g_docked = docked;
+}
+
+static void open_locked(u64 program_id, u64 now, bool docked) {
+    memset(&g_current, 0, sizeof(g_current));
+    g_current.program_id = program_id;
+    g_current.boot = g_header.boot;
+    g_current.start_sec = (u32)now;
+    g_open = program_id != 0;
+    g_segment_start = now;
+    g_docked = docked;
+}
+
+static void close_locked(u64 now, u32 flags) {
+    if (!g_open) return;
+    set_docked_locked(now, g_docked);
+    g_current.duration_sec = now > g_current.start_sec ? (u32)(now - g_current.start_sec) : 0;
+    g_current.flags |= flags;
+    g_open = false;
+    append_locked(&g_current);
+}
+
+void session_journal_poll(TelemetryState* telemetry) {
+    TelemetryEvent events[EVENTS_PER_POLL];
+    bool gap = false;
+    size_t count;
+    size_t i;
+
+    mutexLock(&g_lock);
+    do {
+        count = telemetry_read_events(telemetry, g_event_cursor, events, EVENTS_PER_POLL, &gap);
+        if (gap && g_open) {
+            g_current.flags |= SessionRecordFlag_Gap;
+        }
+        for (i = 0; i < count; i++) {
+            const TelemetryEvent* ev = &events[i];
+            const bool docked = ev->is_docked_valid && ev->is_docked;
+
+            g_event_cursor = ev->seq;
+            if (ev->type == TelemetryEvent_ProgramChanged) {
+                close_locked(ev->time_sec, 0);
+                open_locked(ev->program_id, ev->time_sec, docked);
+            } else if (docked != g_docked) {
+                set_docked_locked(ev->time_sec, docked);
+            }
+        }
+    } while (count == EVENTS_PER_POLL);
+    mutexUnlock(&g_lock);
+}
+
+void session_journal_stop(void) {
+    mutexLock(&g_lock);
+    close_locked(sec_since_boot_now(), SessionRecordFlag_Shutdown);
+    if (g_file) {
+        fclose(g_file);
+        g_file = NULL;
+    }
+    mutexUnlock(&g_lock);
+}
+
+static void json_session(JsonWriter* w, u64 index, const SessionRecord* rec) {
+    json_object_begin(w);
+    json_key(w, "index");
+    json_u64(w, index);
+    json_key(w, "program_id");
+    json_hex(w, rec->program_id, 16);
+    json_key(w, "boot");
+    json_u64(w, rec->boot);
+    json_key(w, "start_sec");
+    json_u64(w, rec->start_sec);
+    json_key(w, "duration_sec");
+    json_u64(w, rec->duration_sec);
+    json_key(w, "docked_sec");
+    json_u64(w, rec->docked_sec);
+    json_key(w, "handheld_sec");
+    json_u64(w, rec->duration_sec - rec->docked_sec);
+    json_key(w, "shutdown");
+    json_bool(w, (rec->flags & SessionRecordFlag_Shutdown) != 0);
+    json_key(w, "gap");
+    json_bool(w, (rec->flags & SessionRecordFlag_Gap) != 0);
+    json_object_end(w);
+}
+
+void session_journal_build_json(u64 since, char* out, size_t out_size) {
+    SessionRecord chunk[JOURNAL_CHUNK];
+    const u64 now = sec_since_boot_now();
+    JsonWriter w;
+    bool full = false;
+    u64 base;
+    u64 end;
+    u64 next;
+    u32 pos;
+    u32 n;
+    u32 i;
+
+    json_writer_init(&w, out, out_size);
+    mutexLock(&g_lock);
+    base = g_header.base_index;
+    end = base + g_count;
+    next = since < base ? base : (since > end ? end : since);
+
+    json_object_begin(&w);
+    json_key(&w, "boot");
+    json_u64(&w, g_header.boot);
+    json_key(&w, "base");
+    json_u64(&w, base);
+    json_key(&w, "end");
+    json_u64(&w, end);
+    // Sessions up to base were compacted away; only their totals remain.
+    json_key(&w, "truncated");
+    json_bool(&w, since < base);
+    json_key(&w, "current");
+    if (g_open) {
+        SessionRecord current = g_current;
+
+        current.duration_sec = now > current.start_sec ? (u32)(now - current.start_sec) : 0;
+        if (g_docked && now > g_segment_start) {
+            current.docked_sec += (u32)(now - g_segment_start);
+        }
+        json_session(&w, 0, &current);
+    } else {
+        json_null(&w);
+    }
+
+    // Seek straight to the first record after since; nothing before it is read.
+    json_key(&w, "sessions");
+    json_array_begin(&w);
+    for (pos = (u32)(next - base); !full && pos < g_count; pos += n) {
+        n = g_count - pos < JOURNAL_CHUNK ? g_count - pos : JOURNAL_CHUNK;
+        if (!read_records_locked(pos, chunk, n)) {
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            const JsonWriterMark mark = json_writer_mark(&w);
+
+            json_session(&w, base + pos + i + 1, &chunk[i]);
+            if (w.overflow || json_writer_room(&w) < HISTORY_TAIL_ROOM) {
+                json_writer_rewind(&w, mark);
+                full = true;
+                break;
+            }
+            next = base + pos + i + 1;
+        }
+    }
+    mutexUnlock(&g_lock);
+    json_array_end(&w);
+    // Pass as since to continue; equal to end once caught up.
+    json_key(&w, "next");
+    json_u64(&w, next);
+    json_object_end(&w);
+    if (!json_writer_finish(&w) && out_size > 0) {
+        out[0] = '\0';
+    }
+}
+
+void session_journal_build_totals_json(char* out, size_t out_size) {
+    SessionTotal totals[SESSION_TOTALS_CAPACITY];
+    SessionTotalsHeader header;
+    JsonWriter w;
+    int count = 0;
+    int i;
+    int j;
+
+    mutexLock(&g_lock);
+    header = g_totals_header;
+    for (i = 0; i < SESSION_TOTALS_CAPACITY; i++) {
+        if (g_totals[i].program_id == 0) continue;
+        // Insertion sort, most played first.
+        for (j = count; j > 0 && totals[j - 1].total_sec < g_totals[i].total_sec; j--) {
+            totals[j] = totals[j - 1];
+        }
+        totals[j] = g_totals[i];
+        count++;
+    }
+    mutexUnlock(&g_lock);
+
+    json_writer_init(&w, out, out_size);
+    json_object_begin(&w);
+    json_key(&w, "folded_through");
+    json_u64(&w, header.folded_through);
+    json_key(&w, "title_count");
+    json_u64(&w, (u64)count);
+    json_key(&w, "other_sessions");
+    json_u64(&w, header.other_sessions);
+    json_key(&w, "other_sec");
+    json_u64(&w, header.other_sec);
+    json_key(&w, "titles");
+    json_array_begin(&w);
+    for (i = 0; i < count; i++) {
+        const JsonWriterMark mark = json_writer_mark(&w);
+
+        json_object_begin(&w);
+        json_key(&w, "program_id");
+        json_hex(&w, totals[i].program_id, 16);
+        json_key(&w, "sessions");
+        json_u64(&w, totals[i].sessions);
+        json_key(&w, "total_sec");
+        json_u64(&w, totals[i].total_sec);
+        json_key(&w, "docked_sec");
+        json_u64(&w, totals[i].docked_sec);
+        json_key(&w, "handheld_sec");
+        json_u64(&w, totals[i].total_sec - totals[i].docked_sec);
+        json_key(&w, "last_index");
+        json_u64(&w, totals[i].last_index);
+        json_object_end(&w);
+        // Keep room for the closing "]}"; title_count tells the client how many were left out.
+        if (w.overflow || json_writer_room(&w) < 2) {
+            json_writer_rewind(&w, mark);
+            break;
+        }
+    }
+    json_array_end(&w);
+    json_object_end(&w);
+    if (!json_writer_finish(&w) && out_size > 0) {
+        out[0] = '\0';
+    }
+}
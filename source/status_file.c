@@ -0,0 +1,137 @@
+#include "status_file.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define STATUS_PATH "sdmc:/switch/switch-dcrpc/status.txt"
+#define STATUS_LIVENESS_FMT "uptime_sec=%-20llu heartbeats=%-20llu\n"
+#define STATUS_LIVENESS_LEN 64 // length of STATUS_LIVENESS_FMT once formatted
+
+static FILE* g_status_file = NULL;
+static StatusRecord g_written; // what the card holds, valid while g_written_valid
+static bool g_written_valid = false;
+static long g_liveness_offset = 0;
+static char g_status_buf[1024];
+
+bool status_file_previous_unclean(void) {
+    FILE* f;
+    char buf[512];
+    size_t n;
+
+    f = fopen(STATUS_PATH, "r");
+    if (!f) return false;
+
+    n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+
+    return strstr(buf, "state=RUNNING") != NULL;
+}
+
+static int status_render_liveness(char* out, size_t size, u64 uptime_sec, u64 heartbeats) {
+    return snprintf(out, size, STATUS_LIVENESS_FMT, (unsigned long long)uptime_sec, (unsigned long long)heartbeats);
+}
+
+// Every field is padded to its widest value, so the size and offsets never change.
+static size_t status_render(const StatusRecord* r, u64 uptime_sec, u64 heartbeats) {
+    int len;
+    int n;
+
+    len = snprintf(g_status_buf, sizeof(g_status_buf), "state=%-7.7s\n", r->state);
+    g_liveness_offset = len;
+    len += status_render_liveness(g_status_buf + len, sizeof(g_status_buf) - (size_t)len, uptime_sec, heartbeats);
+    n = snprintf(
+        g_status_buf + len,
+        sizeof(g_status_buf) - (size_t)len,
+        "session_id=%-20llu\n"
+        "stage=%-*.*s\n"
+        "last_rc=0x%08lX\n"
+        "sm=%d fs=%d setsys=%d applet=%d psm=%d pmshell=%d pminfo=%d nifm=%d socket=%d\n"
+        "detector_started=%d detector_running=%d detector_ns=%d kill_switch=%d\n"
+        "detector_alive=%d detector_last_hb=%-20llu\n"
+        "detector_attempts=%-20llu detector_ok=%-20llu detector_fail=%-20llu detector_streak=%-10u\n"
+        "detector_cooldown_until=%-20llu detector_last_rc=0x%08lX\n",
+        (unsigned long long)r->session_id,
+        STATUS_STAGE_MAX - 1,
+        STATUS_STAGE_MAX - 1,
+        r->stage,
+        (unsigned long)r->last_rc,
+        r->sm,
+        r->fs,
+        r->setsys,
+        r->applet,
+        r->psm,
+        r->pmshell,
+        r->pminfo,
+        r->nifm,
+        r->socket,
+        r->detector_started,
+        r->detector_running,
+        r->detector_ns,
+        r->kill_switch,
+        r->detector_alive,
+        (unsigned long long)r->detector_last_hb,
+        (unsigned long long)r->detector_attempts,
+        (unsigned long long)r->detector_ok,
+        (unsigned long long)r->detector_fail,
+        (unsigned int)r->detector_streak,
+        (unsigned long long)r->detector_cooldown_until,
+        (unsigned long)r->detector_last_rc
+    );
+    if (n < 0 || (size_t)(len + n) >= sizeof(g_status_buf)) {
+        return 0;
+    }
+    return (size_t)(len + n);
+}
+
+static void status_file_fail(void) {
+    fclose(g_status_file);
+    g_status_file = NULL;
+    g_written_valid = false;
+}
+
+void status_file_update(const StatusRecord* record, u64 uptime_sec, u64 heartbeats) {
+    char liveness[STATUS_LIVENESS_LEN + 1];
+    size_t len;
+
+    if (g_written_valid && memcmp(&g_written, record, sizeof(*record)) == 0) {
+        // Unchanged: only the liveness slot moves.
+        if (status_render_liveness(liveness, sizeof(liveness), uptime_sec, heartbeats) != STATUS_LIVENESS_LEN) {
+            return;
+        }
+        if (fseek(g_status_file, g_liveness_offset, SEEK_SET) != 0 ||
+            fwrite(liveness, 1, STATUS_LIVENESS_LEN, g_status_file) != STATUS_LIVENESS_LEN ||
+            fflush(g_status_file) != 0) {
+            status_file_fail();
+        }
+        return;
+    }
+
+    len = status_render(record, uptime_sec, heartbeats);
+    if (len == 0) {
+        return;
+    }
+    // The first write of a session truncates whatever layout the previous one left.
+    if (!g_status_file) {
+        g_status_file = fopen(STATUS_PATH, "w");
+        if (!g_status_file) {
+            return;
+        }
+    }
+    if (fseek(g_status_file, 0, SEEK_SET) != 0 ||
+        fwrite(g_status_buf, 1, len, g_status_file) != len ||
+        fflush(g_status_file) != 0) {
+        status_file_fail();
+        return;
+    }
+    g_written = *record;
+    g_written_valid = true;
+}
+
+void status_file_close(void) {
+    if (g_status_file) {
+        fclose(g_status_file);
+        g_status_file = NULL;
+    }
+    g_written_valid = false;
+}
@@ -1,14 +1,30 @@
 #include "telemetry.h"
 
+#include "json_writer.h"
+#include "power_history.h"
+#include "title_names.h"
+
 #include <stdio.h>
 #include <string.h>
 
-#define PROGRAM_QUERY_INTERVAL_SEC 3
+#define QUERY_INTERVAL_FAST_MS 250
+#define QUERY_INTERVAL_ACTIVE_MAX_MS 2000
+#define QUERY_INTERVAL_IDLE_MAX_MS 30000
+#define POWER_SAMPLE_INTERVAL_MS 2000
+#define CLIENT_ACTIVE_WINDOW_MS 60000
+#define KICK_FAST_QUERIES 4 // a launch can take a few hundred ms to show up in pm
+#define DETECTION_FAIL_EVENT_STREAK 3
+#define SEQLOCK_SPIN_LIMIT 16
+#define SEQLOCK_BACKOFF_NS 50000ULL
 
 static u64 sec_since_boot_now(void) {
     return armTicksToNs(armGetSystemTick()) / 1000000000ULL;
 }
 
+static u64 ms_since_boot_now(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000ULL;
+}
+
 static void copy_utf8_trunc(char* dst, size_t dst_size, const char* src) {
     size_t n = 0;
     if (dst_size == 0) return;
@@ -22,35 +38,207 @@ static void copy_utf8_trunc(char* dst, size_t dst_size, const char* src) {
     dst[n] = '\0';
 }
 
-static void json_escape(const char* in, char* out, size_t out_size) {
-    size_t oi = 0;
-    size_t i;
+// Writer side of the seqlock. Sections are short and never call services, so readers
+// rarely see an odd publish_seq.
+static void telemetry_write_begin(TelemetryState* state) {
+    rmutexLock(&state->lock);
+    __atomic_store_n(&state->publish_seq, state->publish_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
 
-    if (out_size == 0) {
+static void telemetry_write_end(TelemetryState* state) {
+    __atomic_store_n(&state->publish_seq, state->publish_seq + 1, __ATOMIC_RELEASE);
+    rmutexUnlock(&state->lock);
+}
+
+// Spin briefly, then sleep: a reader that outranks a preempted writer on the same core
+// would otherwise never let it finish.
+static void telemetry_read_backoff(u32* attempts) {
+    if (++*attempts > SEQLOCK_SPIN_LIMIT) {
+        svcSleepThread(SEQLOCK_BACKOFF_NS);
+    }
+}
+
+static u32 telemetry_read_begin(const u32* seq, u32* attempts) {
+    u32 start;
+
+    while ((start = __atomic_load_n(seq, __ATOMIC_ACQUIRE)) & 1) {
+        telemetry_read_backoff(attempts);
+    }
+    return start;
+}
+
+// True if nothing was published while the reader was copying.
+static bool telemetry_read_valid(const u32* seq, u32 start) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(seq, __ATOMIC_RELAXED) == start;
+}
+
+// Caller is inside a write section; overwrites the oldest ring entry, never blocks.
+static void telemetry_push_event(TelemetryState* state, u32 type, u64 now) {
+    TelemetryEvent* ev = &state->events[state->event_seq % TELEMETRY_EVENT_RING_SIZE];
+
+    state->event_seq++;
+    ev->seq = state->event_seq;
+    ev->time_sec = now;
+    ev->program_id = state->active_program_id;
+    ev->type = type;
+    ev->detection_fail_streak = state->detection_fail_streak;
+    ev->battery_percent = (u8)state->battery_percent;
+    ev->battery_percent_valid = state->battery_percent_valid;
+    ev->is_charging = state->is_charging;
+    ev->is_charging_valid = state->is_charging_valid;
+    ev->is_docked = state->is_docked;
+    ev->is_docked_valid = state->is_docked_valid;
+}
+
+// Caller is inside a write section. Identity and power changes also move change_seq for long-polls.
+static void telemetry_touch_group(TelemetryState* state, u64* group_seq) {
+    *group_seq = ++state->seq_counter;
+    if (group_seq != &state->detection_seq) {
+        state->change_seq = *group_seq;
+    }
+}
+
+static bool telemetry_client_active(const TelemetryState* state, u64 now_ms) {
+    const u64 last = __atomic_load_n(&state->last_client_ms, __ATOMIC_RELAXED);
+    return last != 0 && now_ms - last < CLIENT_ACTIVE_WINDOW_MS;
+}
+
+// Caller is inside a write section. An unsettled result (change or unconfirmed candidate)
+// or a recent kick polls fast; otherwise back off exponentially, capped lower while clients
+// are watching unless process events already cover changes.
+static void telemetry_schedule_next_query(TelemetryState* state, u64 now_ms, bool unsettled) {
+    const bool watched = telemetry_client_active(state, now_ms) && !state->event_driven;
+    const u32 cap = watched ? QUERY_INTERVAL_ACTIVE_MAX_MS : QUERY_INTERVAL_IDLE_MAX_MS;
+    u32 interval = state->query_interval_ms;
+
+    if (state->fast_queries_left > 0) {
+        state->fast_queries_left--;
+        unsettled = true;
+    }
+    if (unsettled) {
+        interval = QUERY_INTERVAL_FAST_MS;
+    } else {
+        interval = interval < cap / 2 ? interval * 2 : cap;
+    }
+    state->query_interval_ms = interval;
+    state->next_query_ms = now_ms + interval;
+}
+
+static TelemetryPidEntry* pid_cache_slot(TelemetryState* state, u64 pid) {
+    u32 index = (u32)((pid * 0x9E3779B97F4A7C15ULL) >> 32) & (TELEMETRY_PID_CACHE_SIZE - 1);
+
+    // Never full (see pid_cache_compact), so probing always reaches the PID or an empty slot.
+    while (state->pid_cache[index].pid != 0 && state->pid_cache[index].pid != pid) {
+        index = (index + 1) & (TELEMETRY_PID_CACHE_SIZE - 1);
+    }
+    return &state->pid_cache[index];
+}
+
+// Drops PIDs the latest scan did not see once the table is half full. A scan adds at most
+// its process count, so the table stays well below capacity.
+static void pid_cache_compact(TelemetryState* state) {
+    TelemetryPidEntry live[TELEMETRY_PID_CACHE_SIZE / 2];
+    u32 live_count = 0;
+    u32 i;
+
+    if (state->pid_cache_used <= TELEMETRY_PID_CACHE_SIZE / 2) {
         return;
     }
 
-    for (i = 0; in && in[i] != '\0' && oi + 2 < out_size; i++) {
-        const char c = in[i];
-        if (c == '\\' || c == '"') {
-            if (oi + 2 >= out_size) break;
-            out[oi++] = '\\';
-            out[oi++] = c;
-        } else if ((unsigned char)c < 0x20) {
-            out[oi++] = ' ';
-        } else {
-            out[oi++] = c;
+    for (i = 0; i < TELEMETRY_PID_CACHE_SIZE; i++) {
+        const TelemetryPidEntry* entry = &state->pid_cache[i];
+        if (entry->pid != 0 && entry->scan_gen == state->pid_scan_gen && live_count < TELEMETRY_PID_CACHE_SIZE / 2) {
+            live[live_count++] = *entry;
         }
     }
 
-    out[oi] = '\0';
+    memset(state->pid_cache, 0, sizeof(state->pid_cache));
+    for (i = 0; i < live_count; i++) {
+        *pid_cache_slot(state, live[i].pid) = live[i];
+    }
+    state->pid_cache_used = live_count;
+}
+
+// Application candidates only: not a system title, qlaunch or this sysmodule.
+static bool is_application_candidate(u64 program_id) {
+    if ((program_id & 0xFFFF000000000000ULL) != 0x0100000000000000ULL) {
+        return false;
+    }
+    if ((program_id & 0xFFFFFFFFFFFF0000ULL) == 0x0100000000000000ULL) {
+        return false;
+    }
+    if (program_id == 0x0100000000001000ULL) { // qlaunch
+        return false;
+    }
+    if (program_id == 0x00FF0000A1B2C3D4ULL) { // sysmodule title id
+        return false;
+    }
+    return true;
+}
+
+// Returns the cached program id for pid (0 if not a candidate), asking pminfo only for new PIDs.
+// Lookup failures are not cached: a process that just started may not be registered yet.
+static u64 pid_cache_lookup(TelemetryState* state, u64 pid, Result* out_rc) {
+    TelemetryPidEntry* entry;
+    u64 program_id = 0;
+    Result rc;
+
+    *out_rc = 0;
+    if (pid == 0) {
+        return 0;
+    }
+    entry = pid_cache_slot(state, pid);
+    if (entry->pid == pid) {
+        state->pid_cache_hits++;
+        entry->scan_gen = state->pid_scan_gen;
+        return entry->program_id;
+    }
+
+    state->pid_cache_misses++;
+    rc = pminfoGetProgramId(&program_id, pid);
+    *out_rc = rc;
+    if (R_FAILED(rc) || program_id == 0) {
+        return 0;
+    }
+
+    entry->pid = pid;
+    entry->program_id = is_application_candidate(program_id) ? program_id : 0;
+    entry->scan_gen = state->pid_scan_gen;
+    state->pid_cache_used++;
+    return entry->program_id;
+}
+
+// Also run for event pushes that do not move change_seq, so stream subscribers hear of them.
+static void telemetry_notify_change(TelemetryState* state) {
+    mutexLock(&state->change_lock);
+    condvarWakeAll(&state->change_cv);
+    if (state->change_hook) {
+        state->change_hook(state->change_hook_arg);
+    }
+    mutexUnlock(&state->change_lock);
+}
+
+void telemetry_set_change_hook(TelemetryState* state, TelemetryChangeHook hook, void* arg) {
+    mutexLock(&state->change_lock);
+    state->change_hook = hook;
+    state->change_hook_arg = arg;
+    mutexUnlock(&state->change_lock);
 }
 
 void telemetry_init(TelemetryState* state) {
     memset(state, 0, sizeof(*state));
     rmutexInit(&state->lock);
+    mutexInit(&state->change_lock);
+    condvarInit(&state->change_cv);
+    mutexInit(&state->render_lock);
+    mutexInit(&state->kick_lock);
+    condvarInit(&state->kick_cv);
     state->started_sec = sec_since_boot_now();
-    state->next_query_sec = state->started_sec;
+    state->next_query_ms = 0;
+    state->next_power_ms = 0;
+    state->query_interval_ms = QUERY_INTERVAL_FAST_MS;
     state->pending_program_id = 0;
     state->pending_match_count = 0;
     state->detection_mode = false;
@@ -58,14 +246,38 @@ void telemetry_init(TelemetryState* state) {
     snprintf(state->firmware, sizeof(state->firmware), "unknown");
 }
 
+static void telemetry_refresh_response(TelemetryState* state);
+
 void telemetry_set_firmware(TelemetryState* state, const char* firmware) {
-    rmutexLock(&state->lock);
+    telemetry_write_begin(state);
     copy_utf8_trunc(state->firmware, sizeof(state->firmware), firmware ? firmware : "unknown");
-    rmutexUnlock(&state->lock);
+    telemetry_touch_group(state, &state->identity_seq);
+    telemetry_write_end(state);
+    telemetry_refresh_response(state);
+    telemetry_notify_change(state);
 }
 
-void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_battery_query, bool allow_dock_query) {
-    u64 now = sec_since_boot_now();
+// Ignored if the active title changed while the name was being fetched.
+void telemetry_set_active_game(TelemetryState* state, u64 program_id, const char* name) {
+    bool changed = false;
+
+    telemetry_write_begin(state);
+    if (state->active_program_id == program_id && strcmp(state->active_game, name) != 0) {
+        copy_utf8_trunc(state->active_game, sizeof(state->active_game), name);
+        telemetry_touch_group(state, &state->identity_seq);
+        changed = true;
+    }
+    telemetry_write_end(state);
+    if (changed) {
+        telemetry_refresh_response(state);
+        telemetry_notify_change(state);
+    }
+}
+
+// Returns false if nothing was due, in which case the state is untouched.
+static bool telemetry_update_fields(TelemetryState* state, bool allow_pm_query, bool allow_battery_query, bool allow_dock_query) {
+    const u64 now_ms = ms_since_boot_now();
+    const u64 now = now_ms / 1000ULL;
     u64 program_id = 0;
     u64 process_id = 0;
     Result pm_rc = 0;
@@ -87,8 +299,45 @@ void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_bat
     bool is_docked = false;
     u32 dock_detection_source = 0;
     bool should_query_program = false;
+    bool power_due = false;
+    bool first_detection = false;
+    bool unsettled = false;
+    bool changed = false;
+    bool battery_changed = false;
+    bool power_changed = false;
+    bool power_diag_changed = false;
+    bool detection_changed = false;
+    bool detection_event = false;
+    u32 prev_fail_streak = 0;
+    u64 prev_program_id = 0;
     u32 source = 0;
 
+    // Claim whatever is due; a call with nothing due costs no IPC and publishes nothing.
+    rmutexLock(&state->lock);
+    state->query_enabled = allow_pm_query;
+    power_due = now_ms >= state->next_power_ms;
+    if (power_due) {
+        state->next_power_ms = now_ms + POWER_SAMPLE_INTERVAL_MS;
+    }
+    // Consumed even when queries are disallowed so a stale kick cannot keep waking the loop.
+    if (__atomic_exchange_n(&state->query_kick, 0, __ATOMIC_ACQ_REL) != 0 && allow_pm_query) {
+        state->query_interval_ms = QUERY_INTERVAL_FAST_MS;
+        state->next_query_ms = now_ms;
+        state->fast_queries_left = KICK_FAST_QUERIES;
+    }
+    should_query_program = allow_pm_query && now_ms >= state->next_query_ms;
+    if (should_query_program) {
+        state->next_query_ms = now_ms + state->query_interval_ms;
+    }
+    first_detection = allow_pm_query && !state->detection_mode;
+    rmutexUnlock(&state->lock);
+
+    if (!power_due && !should_query_program && !first_detection) {
+        return false;
+    }
+    allow_battery_query = allow_battery_query && power_due;
+    allow_dock_query = allow_dock_query && power_due;
+
     if (allow_battery_query) {
         psm_charge_rc = psmGetBatteryChargePercentage(&battery_percent);
         if (R_SUCCEEDED(psm_charge_rc)) {
@@ -119,10 +368,16 @@ void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_bat
         }
     }
 
-    rmutexLock(&state->lock);
+    telemetry_write_begin(state);
     state->sample_count++;
     state->last_update_sec = now;
     if (allow_battery_query) {
+        battery_changed = battery_percent_valid != state->battery_percent_valid ||
+            (battery_percent_valid && battery_percent != state->battery_percent);
+        power_changed = is_charging_valid != state->is_charging_valid ||
+            (is_charging_valid && (charger_type != PsmChargerType_Unconnected) != state->is_charging);
+        power_diag_changed = psm_charge_rc != state->last_psm_charge_result ||
+            psm_charger_rc != state->last_psm_charger_result;
         state->last_psm_charge_result = psm_charge_rc;
         state->last_psm_charger_result = psm_charger_rc;
         state->battery_percent_valid = battery_percent_valid;
@@ -136,6 +391,12 @@ void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_bat
         }
     }
     if (allow_dock_query) {
+        if (is_docked_valid != state->is_docked_valid || (is_docked_valid && is_docked != state->is_docked)) {
+            power_changed = true;
+        }
+        if (dock_rc != state->last_dock_result || dock_detection_source != state->dock_detection_source) {
+            power_diag_changed = true;
+        }
         state->last_dock_result = dock_rc;
         state->is_docked_valid = is_docked_valid;
         state->dock_detection_source = dock_detection_source;
@@ -144,17 +405,39 @@ void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_bat
         }
     }
 
-    if (allow_pm_query) {
+    if (allow_pm_query && !state->detection_mode) {
         state->detection_mode = true;
+        telemetry_touch_group(state, &state->detection_seq);
     }
-    should_query_program = allow_pm_query && now >= state->next_query_sec;
-    if (should_query_program) {
-        state->next_query_sec = now + PROGRAM_QUERY_INTERVAL_SEC;
+    if (battery_changed) {
+        telemetry_push_event(state, TelemetryEvent_BatteryChanged, now);
     }
-    rmutexUnlock(&state->lock);
-    
+    if (power_changed) {
+        telemetry_push_event(state, TelemetryEvent_PowerChanged, now);
+    }
+    changed = battery_changed || power_changed;
+    if (changed || power_diag_changed) {
+        telemetry_touch_group(state, &state->power_seq);
+    }
+    telemetry_write_end(state);
+
+    if (changed) {
+        telemetry_notify_change(state);
+    }
+    if (allow_battery_query || allow_dock_query) {
+        power_history_add(
+            now,
+            battery_percent_valid,
+            battery_percent,
+            is_charging_valid,
+            charger_type != PsmChargerType_Unconnected,
+            is_docked_valid,
+            is_docked
+        );
+    }
+
     if (!should_query_program) {
-        return;
+        return true;
     }
 
     query_attempted = true;
@@ -177,25 +460,12 @@ void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_bat
         if (R_SUCCEEDED(svc_rc) && out_count > 0) {
             u64 best = 0;
             int i;
+            state->pid_scan_gen++;
             for (i = 0; i < out_count; i++) {
                 u64 pid = pids[i];
-                u64 candidate = 0;
-                Result rc = pminfoGetProgramId(&candidate, pid);
-                if (R_FAILED(rc) || candidate == 0) {
-                    continue;
-                }
-
-                if ((candidate & 0xFFFF000000000000ULL) != 0x0100000000000000ULL) {
-                    continue;
-                }
-                if ((candidate & 0xFFFFFFFFFFFF0000ULL) == 0x0100000000000000ULL) {
-                    continue; 
-                }
-
-                if (candidate == 0x0100000000001000ULL) { // qlaunch
-                    continue;
-                }
-                if (candidate == 0x00FF0000A1B2C3D4ULL) { // sysmodule title id
+                Result rc = 0;
+                u64 candidate = pid_cache_lookup(state, pid, &rc);
+                if (candidate == 0) {
                     continue;
                 }
 
@@ -207,6 +477,7 @@ void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_bat
                 }
             }
 
+            pid_cache_compact(state);
             if (best != 0) {
                 have_program = true;
                 source = 2;
@@ -214,36 +485,66 @@ void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_bat
         }
     }
 
-    rmutexLock(&state->lock);
+    telemetry_write_begin(state);
     if (query_attempted) {
         state->detection_attempt_count++;
         state->detection_last_query_sec = now;
+        detection_changed = pm_rc != state->last_pm_result ||
+            pminfo_rc != state->last_pminfo_result ||
+            ns_rc != state->last_ns_result ||
+            svc_rc != state->last_svc_result ||
+            process_id != state->last_process_id ||
+            source != state->detection_source;
         state->last_pm_result = pm_rc;
         state->last_pminfo_result = pminfo_rc;
         state->last_ns_result = ns_rc;
         state->last_svc_result = svc_rc;
         state->last_process_id = process_id;
         state->detection_source = source;
+        prev_fail_streak = state->detection_fail_streak;
+        if (!have_program || prev_fail_streak != 0) {
+            detection_changed = true;
+        }
 
         if (have_program) {
             state->detection_success_count++;
             state->detection_fail_streak = 0;
             state->detection_last_success_sec = now;
+            if (prev_fail_streak >= DETECTION_FAIL_EVENT_STREAK) {
+                telemetry_push_event(state, TelemetryEvent_DetectionRecovered, now);
+                detection_event = true;
+            }
         } else {
             state->detection_fail_count++;
             if (state->detection_fail_streak < 0xFFFFFFFFU) {
                 state->detection_fail_streak++;
             }
+            if (state->detection_fail_streak == DETECTION_FAIL_EVENT_STREAK) {
+                telemetry_push_event(state, TelemetryEvent_DetectionFailing, now);
+                detection_event = true;
+            }
+        }
+        if (detection_changed) {
+            telemetry_touch_group(state, &state->detection_seq);
         }
     }
 
+    prev_program_id = state->active_program_id;
     if (!have_program) {
         state->pending_program_id = 0;
         state->pending_match_count = 0;
         state->active_program_id = 0;
         copy_utf8_trunc(state->active_game, sizeof(state->active_game), "HOME");
-        rmutexUnlock(&state->lock);
-        return;
+        if (prev_program_id != 0) {
+            telemetry_touch_group(state, &state->identity_seq);
+            telemetry_push_event(state, TelemetryEvent_ProgramChanged, now);
+        }
+        telemetry_schedule_next_query(state, now_ms, prev_program_id != 0);
+        telemetry_write_end(state);
+        if (prev_program_id != 0 || detection_event) {
+            telemetry_notify_change(state);
+        }
+        return true;
     }
 
     if (state->pending_program_id == program_id) {
@@ -253,157 +554,664 @@ void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_bat
         state->pending_match_count = 1;
     }
 
-    if (state->pending_match_count >= 2) {
+    if (state->pending_match_count >= 2 && state->active_program_id != program_id) {
         state->active_program_id = program_id;
-        snprintf(state->active_game, sizeof(state->active_game), "0x%016llX",
-                 (unsigned long long)program_id);
+        // A title seen before is named right away; otherwise the hex id stands in until
+        // telemetry_set_active_game delivers the name fetched from ns.
+        if (!title_names_lookup(program_id, state->active_game, sizeof(state->active_game))) {
+            snprintf(state->active_game, sizeof(state->active_game), "0x%016llX",
+                     (unsigned long long)program_id);
+        }
+    }
+    changed = (state->active_program_id != prev_program_id);
+    if (changed) {
+        telemetry_touch_group(state, &state->identity_seq);
+        telemetry_push_event(state, TelemetryEvent_ProgramChanged, now);
+    }
+    unsettled = changed || state->pending_program_id != state->active_program_id;
+    telemetry_schedule_next_query(state, now_ms, unsettled);
+    telemetry_write_end(state);
+
+    if (changed || detection_event) {
+        telemetry_notify_change(state);
+    }
+    return true;
+}
+
+void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_battery_query, bool allow_dock_query) {
+    if (telemetry_update_fields(state, allow_pm_query, allow_battery_query, allow_dock_query)) {
+        telemetry_refresh_response(state);
+    }
+}
+
+// How long the caller may sleep before telemetry_update has something due.
+u64 telemetry_next_update_delay_ns(TelemetryState* state) {
+    const u64 now_ms = ms_since_boot_now();
+    u64 due_ms;
+
+    rmutexLock(&state->lock);
+    due_ms = state->next_power_ms;
+    if (state->query_enabled) {
+        if (__atomic_load_n(&state->query_kick, __ATOMIC_ACQUIRE) != 0) {
+            due_ms = now_ms;
+        } else if (state->next_query_ms < due_ms) {
+            due_ms = state->next_query_ms;
+        }
     }
     rmutexUnlock(&state->lock);
+
+    return due_ms > now_ms ? (due_ms - now_ms) * 1000000ULL : 0;
 }
 
-void telemetry_build_json(TelemetryState* state, char* out, size_t out_size) {
-    char escaped_game[512];
-    char escaped_firmware[64];
-    u64 started_sec = 0;
-    u64 last_update_sec = 0;
-    u64 sample_count = 0;
-    u64 active_program_id = 0;
-    Result last_pm_result = 0;
-    Result last_pminfo_result = 0;
-    Result last_ns_result = 0;
-    Result last_svc_result = 0;
-    u64 last_process_id = 0;
-    u32 detection_source = 0;
-    bool detection_mode = false;
-    u64 detection_attempt_count = 0;
-    u64 detection_success_count = 0;
-    u64 detection_fail_count = 0;
-    u32 detection_fail_streak = 0;
-    u64 detection_last_query_sec = 0;
-    u64 detection_last_success_sec = 0;
-    u32 battery_percent = 0;
-    bool battery_percent_valid = false;
-    bool is_charging = false;
-    bool is_charging_valid = false;
-    bool is_docked = false;
-    bool is_docked_valid = false;
-    Result last_psm_charge_result = 0;
-    Result last_psm_charger_result = 0;
-    Result last_dock_result = 0;
-    u32 dock_detection_source = 0;
-    char battery_percent_json[16];
-    char is_charging_json[8];
-    char is_docked_json[8];
-    char active_game[sizeof(state->active_game)];
-    char firmware[sizeof(state->firmware)];
+// Called from the HTTP thread on every request; a client returning after the idle
+// window also kicks an immediate query so it does not wait out a long backoff.
+void telemetry_note_client_activity(TelemetryState* state) {
+    const u64 now_ms = ms_since_boot_now();
 
+    if (!telemetry_client_active(state, now_ms)) {
+        telemetry_request_query(state);
+    }
+    __atomic_store_n(&state->last_client_ms, now_ms, __ATOMIC_RELAXED);
+}
+
+// Forces the next telemetry_update to query the program right away at the fast interval.
+void telemetry_request_query(TelemetryState* state) {
+    __atomic_store_n(&state->query_kick, 1, __ATOMIC_RELEASE);
+    mutexLock(&state->kick_lock);
+    condvarWakeAll(&state->kick_cv);
+    mutexUnlock(&state->kick_lock);
+}
+
+// Sleeps up to timeout_ns; returns early (true) when a query was requested.
+bool telemetry_wait_for_kick(TelemetryState* state, u64 timeout_ns) {
+    bool kicked;
+
+    mutexLock(&state->kick_lock);
+    kicked = __atomic_load_n(&state->query_kick, __ATOMIC_ACQUIRE) != 0;
+    if (!kicked) {
+        condvarWaitTimeout(&state->kick_cv, &state->kick_lock, timeout_ns);
+        kicked = __atomic_load_n(&state->query_kick, __ATOMIC_ACQUIRE) != 0;
+    }
+    mutexUnlock(&state->kick_lock);
+    return kicked;
+}
+
+void telemetry_set_event_driven(TelemetryState* state, bool event_driven) {
     rmutexLock(&state->lock);
-    started_sec = state->started_sec;
-    last_update_sec = state->last_update_sec;
-    sample_count = state->sample_count;
-    active_program_id = state->active_program_id;
-    last_pm_result = state->last_pm_result;
-    last_pminfo_result = state->last_pminfo_result;
-    last_ns_result = state->last_ns_result;
-    last_svc_result = state->last_svc_result;
-    last_process_id = state->last_process_id;
-    detection_source = state->detection_source;
-    detection_mode = state->detection_mode;
-    detection_attempt_count = state->detection_attempt_count;
-    detection_success_count = state->detection_success_count;
-    detection_fail_count = state->detection_fail_count;
-    detection_fail_streak = state->detection_fail_streak;
-    detection_last_query_sec = state->detection_last_query_sec;
-    detection_last_success_sec = state->detection_last_success_sec;
-    battery_percent = state->battery_percent;
-    battery_percent_valid = state->battery_percent_valid;
-    is_charging = state->is_charging;
-    is_charging_valid = state->is_charging_valid;
-    is_docked = state->is_docked;
-    is_docked_valid = state->is_docked_valid;
-    last_psm_charge_result = state->last_psm_charge_result;
-    last_psm_charger_result = state->last_psm_charger_result;
-    last_dock_result = state->last_dock_result;
-    dock_detection_source = state->dock_detection_source;
-    copy_utf8_trunc(active_game, sizeof(active_game), state->active_game);
-    copy_utf8_trunc(firmware, sizeof(firmware), state->firmware);
+    state->event_driven = event_driven;
     rmutexUnlock(&state->lock);
+}
 
-    json_escape(active_game, escaped_game, sizeof(escaped_game));
-    json_escape(firmware, escaped_firmware, sizeof(escaped_firmware));
-    if (battery_percent_valid) {
-        snprintf(battery_percent_json, sizeof(battery_percent_json), "%u", (unsigned int)battery_percent);
-    } else {
-        snprintf(battery_percent_json, sizeof(battery_percent_json), "null");
+u64 telemetry_get_event_seq(TelemetryState* state) {
+    u32 attempts = 0;
+    u32 start;
+    u64 seq;
+
+    for (;; telemetry_read_backoff(&attempts)) {
+        start = telemetry_read_begin(&state->publish_seq, &attempts);
+        seq = state->event_seq;
+        if (telemetry_read_valid(&state->publish_seq, start)) {
+            return seq;
+        }
     }
-    if (is_charging_valid) {
-        snprintf(is_charging_json, sizeof(is_charging_json), "%s", is_charging ? "true" : "false");
-    } else {
-        snprintf(is_charging_json, sizeof(is_charging_json), "null");
+}
+
+void telemetry_get_active_program(TelemetryState* state, u64* out_program_id, char* out_game, size_t game_size, Result* out_ns_result) {
+    u32 attempts = 0;
+    u32 start;
+
+    for (;; telemetry_read_backoff(&attempts)) {
+        start = telemetry_read_begin(&state->publish_seq, &attempts);
+        if (out_program_id) *out_program_id = state->active_program_id;
+        if (out_game) copy_utf8_trunc(out_game, game_size, state->active_game);
+        if (out_ns_result) *out_ns_result = state->last_ns_result;
+        if (telemetry_read_valid(&state->publish_seq, start)) {
+            return;
+        }
+    }
+}
+
+// Copies events newer than after_seq, oldest first. *out_gap is set when some were already overwritten.
+size_t telemetry_read_events(TelemetryState* state, u64 after_seq, TelemetryEvent* out, size_t max_events, bool* out_gap) {
+    u32 attempts = 0;
+    u32 start;
+    size_t count;
+    u64 event_seq;
+    u64 first_seq;
+    u64 cursor;
+    bool gap;
+
+    for (;; telemetry_read_backoff(&attempts)) {
+        start = telemetry_read_begin(&state->publish_seq, &attempts);
+        count = 0;
+        cursor = after_seq;
+        event_seq = state->event_seq;
+        first_seq = (event_seq > TELEMETRY_EVENT_RING_SIZE) ? event_seq - TELEMETRY_EVENT_RING_SIZE + 1 : 1;
+        // A cursor ahead of the ring (e.g. Last-Event-ID from a previous boot) is a gap too.
+        gap = cursor + 1 < first_seq || cursor > event_seq;
+        if (gap) {
+            cursor = first_seq - 1;
+        }
+        while (cursor < event_seq && count < max_events) {
+            cursor++;
+            out[count++] = state->events[(cursor - 1) % TELEMETRY_EVENT_RING_SIZE];
+        }
+        if (telemetry_read_valid(&state->publish_seq, start)) {
+            break;
+        }
+    }
+
+    if (out_gap) *out_gap = gap;
+    return count;
+}
+
+const char* telemetry_event_name(u32 type) {
+    switch (type) {
+        case TelemetryEvent_ProgramChanged: return "program";
+        case TelemetryEvent_BatteryChanged: return "battery";
+        case TelemetryEvent_PowerChanged: return "power";
+        case TelemetryEvent_DetectionFailing: return "detection_failing";
+        case TelemetryEvent_DetectionRecovered: return "detection_recovered";
+        default: return "unknown";
+    }
+}
+
+// A since_seq ahead of seq_counter comes from a previous sysmodule run and counts as changed.
+bool telemetry_changed_since(TelemetryState* state, u64 since_seq) {
+    u32 attempts = 0;
+    u32 start;
+    bool changed;
+
+    for (;; telemetry_read_backoff(&attempts)) {
+        start = telemetry_read_begin(&state->publish_seq, &attempts);
+        changed = state->change_seq > since_seq || since_seq > state->seq_counter;
+        if (telemetry_read_valid(&state->publish_seq, start)) {
+            return changed;
+        }
+    }
+}
+
+// Returns true once identity or power changed after since_seq, false on timeout.
+// Writers only take change_lock after leaving their write section.
+bool telemetry_wait_for_change(TelemetryState* state, u64 since_seq, u64 timeout_ns) {
+    const u64 deadline_ns = armTicksToNs(armGetSystemTick()) + timeout_ns;
+    bool changed;
+
+    mutexLock(&state->change_lock);
+    while (!(changed = telemetry_changed_since(state, since_seq))) {
+        const u64 now_ns = armTicksToNs(armGetSystemTick());
+        if (now_ns >= deadline_ns) {
+            break;
+        }
+        condvarWaitTimeout(&state->change_cv, &state->change_lock, deadline_ns - now_ns);
+    }
+    mutexUnlock(&state->change_lock);
+    return changed;
+}
+
+// Everything /state renders, copied out under the lock so formatting happens unlocked.
+typedef struct {
+    u64 seq_counter;
+    u64 change_seq;
+    u64 identity_seq;
+    u64 power_seq;
+    u64 detection_seq;
+    u64 started_sec;
+    u64 counters[TELEMETRY_COUNTER_SLOTS]; // same order as k_counter_keys
+    char firmware[32];
+    u64 active_program_id;
+    char active_game[256];
+    u32 battery_percent;
+    bool battery_percent_valid;
+    bool is_charging;
+    bool is_charging_valid;
+    bool is_docked;
+    bool is_docked_valid;
+    u32 dock_detection_source;
+    Result last_psm_charge_result;
+    Result last_psm_charger_result;
+    Result last_dock_result;
+    Result last_pm_result;
+    Result last_pminfo_result;
+    Result last_ns_result;
+    Result last_svc_result;
+    u64 last_process_id;
+    u32 detection_source;
+    bool detection_mode;
+    u32 detection_fail_streak;
+} TelemetryJsonView;
+
+// Per-sample counters; not covered by the group seqs and patched in place in the cached response.
+static const char* const k_counter_keys[TELEMETRY_COUNTER_SLOTS] = {
+    "\"last_update_sec\":",
+    "\"sample_count\":",
+    "\"detection_attempt_count\":",
+    "\"detection_success_count\":",
+    "\"detection_fail_count\":",
+    "\"detection_last_query_sec\":",
+    "\"detection_last_success_sec\":",
+};
+
+#define COUNTER_SLOT_WIDTH 20
+
+// Caller holds state->lock or validates the copy against publish_seq.
+static void telemetry_read_counters(const TelemetryState* state, u64* counters) {
+    counters[0] = state->last_update_sec;
+    counters[1] = state->sample_count;
+    counters[2] = state->detection_attempt_count;
+    counters[3] = state->detection_success_count;
+    counters[4] = state->detection_fail_count;
+    counters[5] = state->detection_last_query_sec;
+    counters[6] = state->detection_last_success_sec;
+}
+
+// Caller holds state->lock or validates the copy against publish_seq.
+static void telemetry_capture_view(const TelemetryState* state, TelemetryJsonView* view) {
+    view->seq_counter = state->seq_counter;
+    view->change_seq = state->change_seq;
+    view->identity_seq = state->identity_seq;
+    view->power_seq = state->power_seq;
+    view->detection_seq = state->detection_seq;
+    view->started_sec = state->started_sec;
+    telemetry_read_counters(state, view->counters);
+    copy_utf8_trunc(view->firmware, sizeof(view->firmware), state->firmware);
+    view->active_program_id = state->active_program_id;
+    copy_utf8_trunc(view->active_game, sizeof(view->active_game), state->active_game);
+    view->battery_percent = state->battery_percent;
+    view->battery_percent_valid = state->battery_percent_valid;
+    view->is_charging = state->is_charging;
+    view->is_charging_valid = state->is_charging_valid;
+    view->is_docked = state->is_docked;
+    view->is_docked_valid = state->is_docked_valid;
+    view->dock_detection_source = state->dock_detection_source;
+    view->last_psm_charge_result = state->last_psm_charge_result;
+    view->last_psm_charger_result = state->last_psm_charger_result;
+    view->last_dock_result = state->last_dock_result;
+    view->last_pm_result = state->last_pm_result;
+    view->last_pminfo_result = state->last_pminfo_result;
+    view->last_ns_result = state->last_ns_result;
+    view->last_svc_result = state->last_svc_result;
+    view->last_process_id = state->last_process_id;
+    view->detection_source = state->detection_source;
+    view->detection_mode = state->detection_mode;
+    view->detection_fail_streak = state->detection_fail_streak;
+}
+
+static void telemetry_snapshot_view(TelemetryState* state, TelemetryJsonView* view) {
+    u32 attempts = 0;
+    u32 start;
+
+    for (;; telemetry_read_backoff(&attempts)) {
+        start = telemetry_read_begin(&state->publish_seq, &attempts);
+        telemetry_capture_view(state, view);
+        if (telemetry_read_valid(&state->publish_seq, start)) {
+            return;
+        }
     }
-    if (is_docked_valid) {
-        snprintf(is_docked_json, sizeof(is_docked_json), "%s", is_docked ? "true" : "false");
+}
+
+static void json_counter(JsonWriter* w, const char* key, u64 value, u32 counter_width) {
+    json_key(w, key);
+    if (counter_width > 0) {
+        json_u64_padded(w, value, counter_width);
     } else {
-        snprintf(is_docked_json, sizeof(is_docked_json), "null");
-    }
-
-    snprintf(
-        out,
-        out_size,
-        "{"
-        "\"service\":\"RichNX\","
-        "\"firmware\":\"%s\","
-        "\"active_program_id\":\"0x%016llX\","
-        "\"active_game\":\"%s\","
-        "\"started_sec\":%llu,"
-        "\"last_update_sec\":%llu,"
-        "\"sample_count\":%llu,"
-        "\"last_pm_result\":\"0x%08lX\","
-        "\"last_pminfo_result\":\"0x%08lX\","
-        "\"last_ns_result\":\"0x%08lX\","
-        "\"last_svc_result\":\"0x%08lX\","
-        "\"last_process_id\":\"0x%016llX\","
-        "\"detection_source\":%u,"
-        "\"detection_mode\":%s,"
-        "\"detection_attempt_count\":%llu,"
-        "\"detection_success_count\":%llu,"
-        "\"detection_fail_count\":%llu,"
-        "\"detection_fail_streak\":%u,"
-        "\"detection_last_query_sec\":%llu,"
-        "\"detection_last_success_sec\":%llu,"
-        "\"battery_percent\":%s,"
-        "\"is_charging\":%s,"
-        "\"is_docked\":%s,"
-        "\"dock_detection_source\":%u,"
-        "\"last_psm_charge_result\":\"0x%08lX\","
-        "\"last_psm_charger_result\":\"0x%08lX\","
-        "\"last_dock_result\":\"0x%08lX\""
-        "}",
-        escaped_firmware,
-        (unsigned long long)active_program_id,
-        escaped_game,
-        (unsigned long long)started_sec,
-        (unsigned long long)last_update_sec,
-        (unsigned long long)sample_count,
-        (unsigned long)last_pm_result,
-        (unsigned long)last_pminfo_result,
-        (unsigned long)last_ns_result,
-        (unsigned long)last_svc_result,
-        (unsigned long long)last_process_id,
-        (unsigned int)detection_source,
-        detection_mode ? "true" : "false",
-        (unsigned long long)detection_attempt_count,
-        (unsigned long long)detection_success_count,
-        (unsigned long long)detection_fail_count,
-        (unsigned int)detection_fail_streak,
-        (unsigned long long)detection_last_query_sec,
-        (unsigned long long)detection_last_success_sec,
-        battery_percent_json,
-        is_charging_json,
-        is_docked_json,
-        (unsigned int)dock_detection_source,
-        (unsigned long)last_psm_charge_result,
-        (unsigned long)last_psm_charger_result,
-        (unsigned long)last_dock_result
-    );
+        json_u64(w, value);
+    }
+}
+
+// Renders the groups whose seq is newer than since_seq (all of them for 0).
+// counter_width > 0 right-aligns the per-sample counters in space-padded slots of that width.
+// Returns the length, or 0 with out empty if the JSON did not fit.
+static size_t telemetry_render_json(
+    const TelemetryJsonView* snap,
+    u64 since_seq,
+    u32 counter_width,
+    char* out,
+    size_t out_size
+) {
+    JsonWriter w;
+
+    json_writer_init(&w, out, out_size);
+    json_object_begin(&w);
+    json_key(&w, "service");
+    json_string(&w, "RichNX");
+    json_key(&w, "seq");
+    json_u64(&w, snap->seq_counter);
+    json_key(&w, "change_seq");
+    json_u64(&w, snap->change_seq);
+    json_key(&w, "identity_seq");
+    json_u64(&w, snap->identity_seq);
+    json_key(&w, "power_seq");
+    json_u64(&w, snap->power_seq);
+    json_key(&w, "detection_seq");
+    json_u64(&w, snap->detection_seq);
+    json_key(&w, "started_sec");
+    json_u64(&w, snap->started_sec);
+    json_counter(&w, "last_update_sec", snap->counters[0], counter_width);
+    json_counter(&w, "sample_count", snap->counters[1], counter_width);
+    json_counter(&w, "detection_attempt_count", snap->counters[2], counter_width);
+    json_counter(&w, "detection_success_count", snap->counters[3], counter_width);
+    json_counter(&w, "detection_fail_count", snap->counters[4], counter_width);
+    json_counter(&w, "detection_last_query_sec", snap->counters[5], counter_width);
+    json_counter(&w, "detection_last_success_sec", snap->counters[6], counter_width);
+
+    if (since_seq == 0 || snap->identity_seq > since_seq) {
+        json_key(&w, "firmware");
+        json_string(&w, snap->firmware);
+        json_key(&w, "active_program_id");
+        json_hex(&w, snap->active_program_id, 16);
+        json_key(&w, "active_game");
+        json_string(&w, snap->active_game);
+    }
+
+    if (since_seq == 0 || snap->power_seq > since_seq) {
+        json_key(&w, "battery_percent");
+        if (snap->battery_percent_valid) {
+            json_u64(&w, snap->battery_percent);
+        } else {
+            json_null(&w);
+        }
+        json_key(&w, "is_charging");
+        json_tristate(&w, snap->is_charging_valid, snap->is_charging);
+        json_key(&w, "is_docked");
+        json_tristate(&w, snap->is_docked_valid, snap->is_docked);
+        json_key(&w, "dock_detection_source");
+        json_u64(&w, snap->dock_detection_source);
+        json_key(&w, "last_psm_charge_result");
+        json_hex(&w, snap->last_psm_charge_result, 8);
+        json_key(&w, "last_psm_charger_result");
+        json_hex(&w, snap->last_psm_charger_result, 8);
+        json_key(&w, "last_dock_result");
+        json_hex(&w, snap->last_dock_result, 8);
+    }
+
+    if (since_seq == 0 || snap->detection_seq > since_seq) {
+        json_key(&w, "last_pm_result");
+        json_hex(&w, snap->last_pm_result, 8);
+        json_key(&w, "last_pminfo_result");
+        json_hex(&w, snap->last_pminfo_result, 8);
+        json_key(&w, "last_ns_result");
+        json_hex(&w, snap->last_ns_result, 8);
+        json_key(&w, "last_svc_result");
+        json_hex(&w, snap->last_svc_result, 8);
+        json_key(&w, "last_process_id");
+        json_hex(&w, snap->last_process_id, 16);
+        json_key(&w, "detection_source");
+        json_u64(&w, snap->detection_source);
+        json_key(&w, "detection_mode");
+        json_bool(&w, snap->detection_mode);
+        json_key(&w, "detection_fail_streak");
+        json_u64(&w, snap->detection_fail_streak);
+    }
+
+    json_object_end(&w);
+    if (!json_writer_finish(&w)) {
+        if (out_size > 0) {
+            out[0] = '\0';
+        }
+        return 0;
+    }
+    return w.len;
+}
+
+// Stand-in when the full document does not fit: still valid JSON, and clients can tell.
+static void telemetry_render_truncated(u64 seq_counter, char* out, size_t out_size) {
+    JsonWriter w;
+
+    json_writer_init(&w, out, out_size);
+    json_object_begin(&w);
+    json_key(&w, "service");
+    json_string(&w, "RichNX");
+    json_key(&w, "seq");
+    json_u64(&w, seq_counter);
+    json_key(&w, "truncated");
+    json_bool(&w, true);
+    json_object_end(&w);
+    if (!json_writer_finish(&w) && out_size > 0) {
+        out[0] = '\0';
+    }
+}
+
+void telemetry_build_json(TelemetryState* state, char* out, size_t out_size) {
+    telemetry_build_json_since(state, 0, out, out_size, NULL);
+}
+
+// A since_seq from an earlier run (ahead of seq_counter) renders everything.
+void telemetry_build_json_since(TelemetryState* state, u64 since_seq, char* out, size_t out_size, u64* out_etag_seq) {
+    TelemetryJsonView view;
+
+    if (out_size == 0) {
+        return;
+    }
+
+    telemetry_snapshot_view(state, &view);
+
+    if (since_seq > view.seq_counter) {
+        since_seq = 0;
+    }
+    if (out_etag_seq) {
+        *out_etag_seq = view.seq_counter;
+    }
+    if (telemetry_render_json(&view, since_seq, 0, out, out_size) == 0) {
+        telemetry_render_truncated(view.seq_counter, out, out_size);
+    }
+}
+
+static void patch_counter_slot(char* slot, u64 value) {
+    char* p = slot + COUNTER_SLOT_WIDTH;
+
+    do {
+        *--p = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value != 0 && p > slot);
+    while (p > slot) {
+        *--p = ' ';
+    }
+}
+
+static void telemetry_response_write_begin(TelemetryState* state, u32 buffer) {
+    __atomic_store_n(&state->response_gen[buffer], state->response_gen[buffer] + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void telemetry_response_write_end(TelemetryState* state, u32 buffer) {
+    __atomic_store_n(&state->response_gen[buffer], state->response_gen[buffer] + 1, __ATOMIC_RELEASE);
+}
+
+// Caller holds state->lock.
+static void telemetry_patch_response_counters(TelemetryState* state) {
+    const u32 front = state->response_front;
+    u64 counters[TELEMETRY_COUNTER_SLOTS];
+    int i;
+
+    if (state->response_len[front] == 0) {
+        return;
+    }
+
+    telemetry_read_counters(state, counters);
+    telemetry_response_write_begin(state, front);
+    for (i = 0; i < TELEMETRY_COUNTER_SLOTS; i++) {
+        patch_counter_slot(state->response[front] + state->response_counter_offsets[front][i], counters[i]);
+    }
+    telemetry_response_write_end(state, front);
+}
+
+// Re-renders the cached /state response when a group seq moved, otherwise only patches counters.
+static void telemetry_refresh_response(TelemetryState* state) {
+    TelemetryJsonView view;
+    char* out;
+    u32 back;
+    size_t head_len;
+    size_t body_len;
+    bool cached;
+    int i;
+
+    mutexLock(&state->render_lock);
+
+    rmutexLock(&state->lock);
+    if (state->response_len[state->response_front] != 0 &&
+        state->response_seq[state->response_front] == state->seq_counter) {
+        telemetry_patch_response_counters(state);
+        rmutexUnlock(&state->lock);
+        mutexUnlock(&state->render_lock);
+        return;
+    }
+    telemetry_capture_view(state, &view);
+    rmutexUnlock(&state->lock);
+
+    // Only this thread writes the back buffer while render_lock is held; readers that still
+    // hold it from before the last flip see its generation move and retry.
+    back = state->response_front ^ 1;
+    out = state->response[back];
+    telemetry_response_write_begin(state, back);
+
+    // Content-Length is known up front because the counters render at a fixed width.
+    {
+        char* body = out + 512;
+        JsonWriter head;
+
+        body_len = telemetry_render_json(&view, 0, COUNTER_SLOT_WIDTH, body, sizeof(state->response[back]) - 512);
+        json_writer_init(&head, out, 512);
+        json_raw(&head, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nETag: W/\"");
+        json_raw_u64(&head, view.started_sec);
+        json_raw(&head, "-");
+        json_raw_u64(&head, view.seq_counter);
+        json_raw(&head, "-0\"\r\nAccess-Control-Allow-Origin: *\r\nContent-Length: ");
+        json_raw_u64(&head, body_len);
+        json_raw(&head, "\r\n");
+        cached = body_len != 0 && json_writer_finish(&head);
+        head_len = cached ? head.len : 0;
+        if (cached) {
+            memmove(out + head_len, body, body_len);
+        }
+    }
+
+    for (i = 0; cached && i < TELEMETRY_COUNTER_SLOTS; i++) {
+        const char* key = strstr(out + head_len, k_counter_keys[i]);
+        cached = key != NULL;
+        state->response_counter_offsets[back][i] = key ? (u16)(key - out + strlen(k_counter_keys[i])) : 0;
+    }
+    // Anything that did not render leaves the cache empty; readers then build /state themselves.
+    state->response_head_len[back] = cached ? (u32)head_len : 0;
+    state->response_len[back] = cached ? (u32)(head_len + body_len) : 0;
+    state->response_seq[back] = view.seq_counter;
+    telemetry_response_write_end(state, back);
+
+    rmutexLock(&state->lock);
+    __atomic_store_n(&state->response_front, back, __ATOMIC_RELEASE);
+    // Counters may have ticked since the view was captured.
+    telemetry_patch_response_counters(state);
+    rmutexUnlock(&state->lock);
+
+    mutexUnlock(&state->render_lock);
+}
+
+// Copies the cached full /state response with connection_headers spliced in before the blank line.
+// Lock-free memcpy; returns 0 if nothing is cached yet or out is too small.
+size_t telemetry_copy_state_response(
+    TelemetryState* state,
+    const char* connection_headers,
+    char* out,
+    size_t out_size,
+    u64* out_seq
+) {
+    const size_t conn_len = strlen(connection_headers);
+    u32 attempts = 0;
+    u32 start;
+    u32 front;
+    size_t head_len;
+    size_t total_len;
+    size_t body_len;
+    u64 seq;
+
+    for (;; telemetry_read_backoff(&attempts)) {
+        front = __atomic_load_n(&state->response_front, __ATOMIC_ACQUIRE);
+        start = telemetry_read_begin(&state->response_gen[front], &attempts);
+        head_len = state->response_head_len[front];
+        total_len = state->response_len[front];
+        seq = state->response_seq[front];
+        if (total_len == 0 || head_len > total_len || total_len + conn_len + 2 > out_size) {
+            if (!telemetry_read_valid(&state->response_gen[front], start)) {
+                continue;
+            }
+            return 0;
+        }
+
+        body_len = total_len - head_len;
+        memcpy(out, state->response[front], head_len);
+        memcpy(out + head_len, connection_headers, conn_len);
+        memcpy(out + head_len + conn_len, "\r\n", 2);
+        memcpy(out + head_len + conn_len + 2, state->response[front] + head_len, body_len);
+        if (telemetry_read_valid(&state->response_gen[front], start)) {
+            break;
+        }
+    }
+
+    if (out_seq) {
+        *out_seq = seq;
+    }
+    return total_len + conn_len + 2;
+}
+
+static u8* frame_put_le(u8* p, u64 value, int bytes) {
+    int i;
+    for (i = 0; i < bytes; i++) {
+        *p++ = (u8)(value >> (8 * i));
+    }
+    return p;
+}
+
+static u8* frame_put_string(u8* p, const char* text) {
+    const size_t len = strlen(text);
+    *p++ = (u8)len;
+    memcpy(p, text, len);
+    return p + len;
+}
+
+// Returns the frame length, or 0 if out is smaller than TELEMETRY_FRAME_MAX.
+size_t telemetry_build_frame(TelemetryState* state, u8* out, size_t out_size) {
+    TelemetryJsonView view;
+    u8* p = out;
+    u8 flags = 0;
+    size_t len;
+
+    if (out_size < TELEMETRY_FRAME_MAX) {
+        return 0;
+    }
+
+    telemetry_snapshot_view(state, &view);
+
+    if (view.battery_percent_valid) flags |= TelemetryFrameFlag_BatteryValid;
+    if (view.is_charging_valid) flags |= TelemetryFrameFlag_ChargingValid;
+    if (view.is_charging) flags |= TelemetryFrameFlag_Charging;
+    if (view.is_docked_valid) flags |= TelemetryFrameFlag_DockedValid;
+    if (view.is_docked) flags |= TelemetryFrameFlag_Docked;
+    if (view.detection_mode) flags |= TelemetryFrameFlag_DetectionMode;
+
+    p = frame_put_le(p, TELEMETRY_FRAME_MAGIC, 4);
+    p = frame_put_le(p, TELEMETRY_FRAME_SCHEMA_ID, 2);
+    p += 2; // frame length, filled in below
+    p = frame_put_le(p, view.seq_counter, 8);
+    p = frame_put_le(p, view.change_seq, 8);
+    p = frame_put_le(p, view.started_sec, 8);
+    p = frame_put_le(p, view.counters[0], 8);
+    p = frame_put_le(p, view.active_program_id, 8);
+    *p++ = view.battery_percent_valid ? (u8)view.battery_percent : 0xFF;
+    *p++ = flags;
+    *p++ = (u8)view.dock_detection_source;
+    *p++ = (u8)view.detection_source;
+    p = frame_put_le(p, view.detection_fail_streak, 4);
+    p = frame_put_le(p, (u32)view.last_psm_charge_result, 4);
+    p = frame_put_le(p, (u32)view.last_psm_charger_result, 4);
+    p = frame_put_le(p, (u32)view.last_dock_result, 4);
+    p = frame_put_le(p, (u32)view.last_pm_result, 4);
+    p = frame_put_le(p, (u32)view.last_pminfo_result, 4);
+    p = frame_put_le(p, (u32)view.last_ns_result, 4);
+    p = frame_put_le(p, (u32)view.last_svc_result, 4);
+    p = frame_put_string(p, view.firmware);
+    p = frame_put_string(p, view.active_game);
+
+    len = (size_t)(p - out);
+    frame_put_le(out + 6, len, 2);
+    return len;
 }
@@ -0,0 +1,358 @@
+#include "title_icons.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define TITLE_ICONS_DIR "sdmc:/switch/switch-dcrpc/icons"
+#define TITLE_ICONS_INDEX_PATH TITLE_ICONS_DIR "/index.bin"
+#define TITLE_ICONS_MAGIC 0x43584E52u // "RNXC"
+#define TITLE_ICONS_VERSION 1
+#define TITLE_ICONS_EXTRACT_GAP_MS 250 // between ns control data fetches for /icon
+#define NS_RESULT_MODULE 16 // ns itself answered (e.g. not installed), rather than IPC failing
+
+// index.bin: a TitleIconsFileHeader followed by count TitleIconEntry records, native layout.
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 count;
+} TitleIconsFileHeader;
+
+typedef struct {
+    u64 program_id; // 0 = empty slot
+    u64 hash;
+    u32 size;       // 0 = the title has no icon; hash is unused
+    u32 reserved;
+} TitleIconEntry;
+
+static Mutex g_lock;
+static TitleIconEntry g_entries[TITLE_ICONS_CAPACITY];
+static u32 g_next_slot = 0; // replaced next once every slot is taken
+static bool g_dirty = false; // index.bin is behind g_entries; title_icons_service saves it
+static Mutex g_save_lock; // serializes index.bin writes; taken before g_lock, never inside it
+static TitleIconEntry g_save_entries[TITLE_ICONS_CAPACITY]; // guarded by g_save_lock
+static u64 g_pending[TITLE_ICONS_PENDING]; // 0 = free
+static u64 g_last_extract_ms = 0;
+static volatile bool g_ns_ready = false;
+static u64 g_hits = 0;
+static u64 g_extractions = 0;
+
+static u64 ms_since_boot_now(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000ULL;
+}
+
+static u64 fnv1a64(const u8* data, size_t size) {
+    u64 hash = 0xCBF29CE484222325ULL;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static void icon_path(u64 hash, char* out, size_t out_size) {
+    snprintf(out, out_size, TITLE_ICONS_DIR "/%016llx.jpg", (unsigned long long)hash);
+}
+
+static TitleIconEntry* find_entry(u64 program_id) {
+    int i;
+
+    for (i = 0; i < TITLE_ICONS_CAPACITY; i++) {
+        if (g_entries[i].program_id == program_id) {
+            return &g_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static bool hash_in_use(u64 hash) {
+    int i;
+
+    for (i = 0; i < TITLE_ICONS_CAPACITY; i++) {
+        if (g_entries[i].program_id != 0 && g_entries[i].size != 0 && g_entries[i].hash == hash) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Rewritten only when an icon is added or dropped. The entries are copied under g_lock and
+// written after releasing it, so title_icons_get on the HTTP thread never waits on the card.
+static void save(void) {
+    TitleIconsFileHeader header;
+    FILE* f;
+    int i;
+
+    mutexLock(&g_save_lock);
+    mutexLock(&g_lock);
+    memcpy(g_save_entries, g_entries, sizeof(g_save_entries));
+    g_dirty = false;
+    mutexUnlock(&g_lock);
+
+    header.magic = TITLE_ICONS_MAGIC;
+    header.version = TITLE_ICONS_VERSION;
+    header.count = 0;
+    for (i = 0; i < TITLE_ICONS_CAPACITY; i++) {
+        if (g_save_entries[i].program_id != 0) header.count = (u16)(i + 1);
+    }
+
+    f = fopen(TITLE_ICONS_INDEX_PATH, "wb");
+    if (f) {
+        fwrite(&header, sizeof(header), 1, f);
+        fwrite(g_save_entries, sizeof(g_save_entries[0]), header.count, f);
+        fclose(f);
+    }
+    mutexUnlock(&g_save_lock);
+}
+
+void title_icons_load(void) {
+    TitleIconsFileHeader header;
+    FILE* f;
+
+    mkdir(TITLE_ICONS_DIR, 0777);
+    f = fopen(TITLE_ICONS_INDEX_PATH, "rb");
+    if (!f) return;
+
+    mutexLock(&g_lock);
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        header.magic != TITLE_ICONS_MAGIC ||
+        header.version != TITLE_ICONS_VERSION ||
+        header.count > TITLE_ICONS_CAPACITY ||
+        fread(g_entries, sizeof(g_entries[0]), header.count, f) != header.count) {
+        memset(g_entries, 0, sizeof(g_entries));
+    } else {
+        g_next_slot = header.count % TITLE_ICONS_CAPACITY;
+    }
+    mutexUnlock(&g_lock);
+    fclose(f);
+}
+
+void title_icons_set_ns_ready(bool ready) {
+    g_ns_ready = ready;
+}
+
+static bool write_icon_file(const char* path, const u8* jpeg, size_t size) {
+    struct stat st;
+    FILE* f;
+    bool ok;
+
+    // Same hash, same size: the bytes are already on the card (another title shares them).
+    if (stat(path, &st) == 0 && (size_t)st.st_size == size) {
+        return true;
+    }
+    f = fopen(path, "wb");
+    if (!f) return false;
+    ok = fwrite(jpeg, 1, size, f) == size;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        remove(path);
+    }
+    return ok;
+}
+
+// A free slot, else a "no icon" entry, else (for a real icon, hash) the next slot round-robin,
+// so unknown ids can never push real icons out of the index. NULL if nothing may be taken.
+// *out_orphan is set to the hash of an evicted icon no entry uses any more (else 0); the
+// caller removes its file after releasing g_lock.
+static TitleIconEntry* claim_slot_locked(bool has_icon, u64 hash, u64* out_orphan) {
+    TitleIconEntry* entry = find_entry(0);
+    int i;
+
+    for (i = 0; !entry && i < TITLE_ICONS_CAPACITY; i++) {
+        if (g_entries[i].size == 0) entry = &g_entries[i];
+    }
+    *out_orphan = 0;
+    if (!entry && has_icon) {
+        const u64 old_hash = g_entries[g_next_slot].hash;
+
+        entry = &g_entries[g_next_slot];
+        g_next_slot = (g_next_slot + 1) % TITLE_ICONS_CAPACITY;
+        entry->program_id = 0;
+        if (old_hash != hash && !hash_in_use(old_hash)) {
+            *out_orphan = old_hash;
+        }
+    }
+    return entry;
+}
+
+// The JPEG is on the card before the entry points at it; g_lock is only held to update entries.
+void title_icons_store(u64 program_id, const u8* jpeg, size_t size) {
+    char path[TITLE_ICON_PATH_MAX];
+    TitleIconEntry* entry;
+    u64 orphan = 0;
+    u64 hash;
+    bool known;
+
+    if (program_id == 0 || size == 0) return;
+
+    hash = fnv1a64(jpeg, size);
+    icon_path(hash, path, sizeof(path));
+
+    mutexLock(&g_lock);
+    entry = find_entry(program_id);
+    known = entry && entry->hash == hash && entry->size == size;
+    mutexUnlock(&g_lock);
+    if (known || !write_icon_file(path, jpeg, size)) {
+        return;
+    }
+
+    mutexLock(&g_lock);
+    entry = find_entry(program_id);
+    if (!entry) {
+        entry = claim_slot_locked(true, hash, &orphan);
+    }
+    entry->program_id = program_id;
+    entry->hash = hash;
+    entry->size = (u32)size;
+    mutexUnlock(&g_lock);
+
+    if (orphan != 0) {
+        icon_path(orphan, path, sizeof(path));
+        remove(path);
+    }
+    save();
+}
+
+// Remembers that program_id has no icon, unless that would cost a real icon its slot.
+static void store_missing(u64 program_id) {
+    TitleIconEntry* entry;
+    u64 orphan;
+    bool added = false;
+
+    mutexLock(&g_lock);
+    entry = find_entry(program_id);
+    if (!entry) {
+        entry = claim_slot_locked(false, 0, &orphan);
+        if (entry) {
+            entry->program_id = program_id;
+            entry->hash = 0;
+            entry->size = 0;
+            added = true;
+        }
+    }
+    mutexUnlock(&g_lock);
+    if (added) {
+        save();
+    }
+}
+
+static void extract_icon(u64 program_id) {
+    NsApplicationControlData* data;
+    u64 actual_size = 0;
+    Result rc;
+
+    data = (NsApplicationControlData*)malloc(sizeof(*data));
+    if (!data) return;
+    rc = nsGetApplicationControlData(NsApplicationControlSource_Storage, program_id, data, sizeof(*data), &actual_size);
+    if (R_SUCCEEDED(rc) && actual_size > sizeof(data->nacp) && actual_size <= sizeof(*data)) {
+        title_icons_store(program_id, data->icon, (size_t)(actual_size - sizeof(data->nacp)));
+        mutexLock(&g_lock);
+        g_extractions++;
+        mutexUnlock(&g_lock);
+    } else if (R_SUCCEEDED(rc) || R_MODULE(rc) == NS_RESULT_MODULE) {
+        // Not installed, or installed without an icon; title_icons_store replaces this if
+        // the title is launched later and its control data turns up after all.
+        store_missing(program_id);
+    }
+    free(data);
+}
+
+// Called with g_lock held.
+static TitleIconStatus queue_locked(u64 program_id) {
+    u64* free_slot = NULL;
+    int i;
+
+    for (i = 0; i < TITLE_ICONS_PENDING; i++) {
+        if (g_pending[i] == program_id) return TitleIconStatus_Pending;
+        if (g_pending[i] == 0 && !free_slot) free_slot = &g_pending[i];
+    }
+    if (!free_slot) return TitleIconStatus_Pending;
+    *free_slot = program_id;
+    return TitleIconStatus_Queued;
+}
+
+TitleIconStatus title_icons_get(u64 program_id, TitleIcon* out) {
+    TitleIconStatus status = TitleIconStatus_Missing;
+    TitleIconEntry* entry;
+
+    if (program_id == 0) return TitleIconStatus_Missing;
+
+    mutexLock(&g_lock);
+    entry = find_entry(program_id);
+    if (entry && entry->size != 0) {
+        out->hash = entry->hash;
+        out->size = entry->size;
+        icon_path(entry->hash, out->path, sizeof(out->path));
+        g_hits++;
+        status = TitleIconStatus_Found;
+    } else if (!entry && g_ns_ready) {
+        status = queue_locked(program_id);
+    }
+    mutexUnlock(&g_lock);
+    return status;
+}
+
+FILE* title_icons_open(u64 program_id, const TitleIcon* icon) {
+    TitleIconEntry* entry;
+    FILE* f;
+
+    f = fopen(icon->path, "rb");
+    if (f) return f;
+
+    // Deleted from the card behind our back: forget it and extract again. This runs on the
+    // HTTP thread, so index.bin is left for title_icons_service to rewrite.
+    mutexLock(&g_lock);
+    entry = find_entry(program_id);
+    if (entry) {
+        entry->program_id = 0;
+        g_dirty = true;
+    }
+    if (g_ns_ready) {
+        queue_locked(program_id);
+    }
+    mutexUnlock(&g_lock);
+    return NULL;
+}
+
+void title_icons_service(void) {
+    const u64 now_ms = ms_since_boot_now();
+    u64 program_id = 0;
+    bool dirty;
+    int i;
+
+    mutexLock(&g_lock);
+    dirty = g_dirty;
+    mutexUnlock(&g_lock);
+    if (dirty) {
+        save();
+    }
+    if (!g_ns_ready) return;
+
+    mutexLock(&g_lock);
+    if (g_last_extract_ms == 0 || now_ms - g_last_extract_ms >= TITLE_ICONS_EXTRACT_GAP_MS) {
+        for (i = 0; i < TITLE_ICONS_PENDING && program_id == 0; i++) {
+            program_id = g_pending[i];
+        }
+    }
+    mutexUnlock(&g_lock);
+    if (program_id == 0) return;
+
+    // Left queued until done, so requests in the meantime do not queue it again.
+    extract_icon(program_id);
+
+    mutexLock(&g_lock);
+    for (i = 0; i < TITLE_ICONS_PENDING; i++) {
+        if (g_pending[i] == program_id) g_pending[i] = 0;
+    }
+    g_last_extract_ms = ms_since_boot_now();
+    mutexUnlock(&g_lock);
+}
+
+void title_icons_get_stats(u64* out_hits, u64* out_extractions) {
+    mutexLock(&g_lock);
+    *out_hits = g_hits;
+    *out_extractions = g_extractions;
+    mutexUnlock(&g_lock);
+}
@@ -0,0 +1,262 @@
+#include "title_names.h"
+
+#include "title_icons.h"
+#include "titledb_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TITLE_NAMES_PATH "sdmc:/switch/switch-dcrpc/title_names.bin"
+#define TITLEDB_INDEX_PATH "sdmc:/switch/switch-dcrpc/titledb.bin"
+#define TITLE_NAMES_MAGIC 0x54584E52u // "RNXT"
+#define TITLE_NAMES_VERSION 1
+#define TITLE_NAMES_NO_NAME MAKERESULT(Module_Libnx, LibnxError_NotFound)
+
+// title_names.bin: a TitleNamesFileHeader followed by count TitleNameEntry records, native
+// layout. Only this module reads it back, so it is rewritten whole whenever a name is added.
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 count;
+} TitleNamesFileHeader;
+
+typedef struct {
+    u64 program_id; // 0 = empty slot
+    u32 last_use; // g_use_clock at the last hit; the smallest is evicted first
+    char name[TITLE_NAME_MAX];
+} TitleNameEntry;
+
+static Mutex g_lock;
+static TitleNameEntry g_entries[TITLE_NAMES_CAPACITY];
+static Mutex g_save_lock; // serializes title_names.bin writes; taken before g_lock, never inside it
+static TitleNameEntry g_save_entries[TITLE_NAMES_CAPACITY]; // guarded by g_save_lock
+static u32 g_use_clock = 0;
+static u64 g_hits = 0;
+static u64 g_misses = 0;
+static u64 g_fetches = 0;
+static u64 g_index_hits = 0;
+
+// Truncates at a character boundary so a cut name is still valid UTF-8.
+static void copy_name(char* dst, size_t dst_size, const char* src, size_t src_max) {
+    size_t n;
+
+    if (dst_size == 0) return;
+    n = strnlen(src, src_max);
+    if (n >= dst_size) {
+        n = dst_size - 1;
+        while (n > 0 && ((u8)src[n] & 0xC0) == 0x80) {
+            n--;
+        }
+    }
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+static TitleNameEntry* find_entry(u64 program_id) {
+    int i;
+
+    for (i = 0; i < TITLE_NAMES_CAPACITY; i++) {
+        if (g_entries[i].program_id == program_id) {
+            return &g_entries[i];
+        }
+    }
+    return NULL;
+}
+
+// An empty slot if there is one, otherwise the least recently used entry.
+static TitleNameEntry* victim_entry(void) {
+    TitleNameEntry* victim = &g_entries[0];
+    int i;
+
+    for (i = 0; i < TITLE_NAMES_CAPACITY; i++) {
+        if (g_entries[i].program_id == 0) {
+            return &g_entries[i];
+        }
+        if (g_entries[i].last_use < victim->last_use) {
+            victim = &g_entries[i];
+        }
+    }
+    return victim;
+}
+
+void title_names_load(void) {
+    TitleNamesFileHeader header;
+    TitleNameEntry entries[TITLE_NAMES_CAPACITY];
+    FILE* f;
+    int i;
+
+    f = fopen(TITLE_NAMES_PATH, "rb");
+    if (!f) return;
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        header.magic != TITLE_NAMES_MAGIC ||
+        header.version != TITLE_NAMES_VERSION ||
+        header.count > TITLE_NAMES_CAPACITY ||
+        fread(entries, sizeof(entries[0]), header.count, f) != header.count) {
+        fclose(f);
+        return;
+    }
+    fclose(f);
+
+    mutexLock(&g_lock);
+    memset(g_entries, 0, sizeof(g_entries));
+    g_use_clock = 0;
+    for (i = 0; i < header.count; i++) {
+        if (entries[i].program_id == 0) continue;
+        g_entries[i] = entries[i];
+        g_entries[i].name[TITLE_NAME_MAX - 1] = '\0';
+        if (entries[i].last_use > g_use_clock) {
+            g_use_clock = entries[i].last_use;
+        }
+    }
+    mutexUnlock(&g_lock);
+}
+
+// A few KiB, written only when a title is seen for the first time. The entries are copied
+// under g_lock and written after releasing it: title_names_lookup runs inside a telemetry
+// write section and must never wait on the SD card.
+static void save(void) {
+    TitleNamesFileHeader header;
+    FILE* f;
+    int i;
+
+    mutexLock(&g_save_lock);
+    mutexLock(&g_lock);
+    memcpy(g_save_entries, g_entries, sizeof(g_save_entries));
+    mutexUnlock(&g_lock);
+
+    header.magic = TITLE_NAMES_MAGIC;
+    header.version = TITLE_NAMES_VERSION;
+    header.count = 0;
+    for (i = 0; i < TITLE_NAMES_CAPACITY; i++) {
+        if (g_save_entries[i].program_id != 0) header.count = (u16)(i + 1);
+    }
+
+    f = fopen(TITLE_NAMES_PATH, "wb");
+    if (f) {
+        fwrite(&header, sizeof(header), 1, f);
+        fwrite(g_save_entries, sizeof(g_save_entries[0]), header.count, f);
+        fclose(f);
+    }
+    mutexUnlock(&g_save_lock);
+}
+
+bool title_names_lookup(u64 program_id, char* out, size_t out_size) {
+    TitleNameEntry* entry;
+
+    if (program_id == 0) return false;
+
+    mutexLock(&g_lock);
+    entry = find_entry(program_id);
+    if (entry) {
+        entry->last_use = ++g_use_clock;
+        copy_name(out, out_size, entry->name, sizeof(entry->name));
+        g_hits++;
+    } else {
+        g_misses++;
+    }
+    mutexUnlock(&g_lock);
+    return entry != NULL;
+}
+
+// The title's NACP name, in the system language where it has one.
+static Result fetch_nacp_name(u64 program_id, char* out, size_t out_size) {
+    NsApplicationControlData* data;
+    NacpLanguageEntry* lang = NULL;
+    u64 actual_size = 0;
+    Result rc;
+
+    // ~144 KiB, mostly icon; only borrowed from the heap for the rare first sighting.
+    data = (NsApplicationControlData*)malloc(sizeof(*data));
+    if (!data) {
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+    rc = nsGetApplicationControlData(NsApplicationControlSource_Storage, program_id, data, sizeof(*data), &actual_size);
+    if (R_SUCCEEDED(rc) && actual_size < sizeof(data->nacp)) {
+        rc = TITLE_NAMES_NO_NAME;
+    }
+    if (R_SUCCEEDED(rc)) {
+        rc = nacpGetLanguageEntry(&data->nacp, &lang);
+    }
+    if (R_SUCCEEDED(rc) && (!lang || lang->name[0] == '\0')) {
+        rc = TITLE_NAMES_NO_NAME;
+    }
+    if (R_SUCCEEDED(rc)) {
+        copy_name(out, out_size, lang->name, sizeof(lang->name));
+        // The icon came along in the same buffer; keeping it saves /icon a second ns call.
+        if (actual_size > sizeof(data->nacp) && actual_size <= sizeof(*data)) {
+            title_icons_store(program_id, data->icon, (size_t)(actual_size - sizeof(data->nacp)));
+        }
+    }
+    free(data);
+    return rc;
+}
+
+// Covers titles ns has no control data for, and consoles where ns is unavailable.
+static bool find_in_titledb(u64 program_id, char* out, size_t out_size) {
+    TitleDbIndex index;
+    bool found;
+
+    if (!titledb_index_open(&index, TITLEDB_INDEX_PATH)) {
+        return false;
+    }
+    found = titledb_index_find(&index, program_id, out, out_size, NULL, 0);
+    titledb_index_close(&index);
+    return found;
+}
+
+bool title_names_fetch(u64 program_id, bool use_ns, char* out, size_t out_size, Result* out_rc) {
+    char name[TITLE_NAME_MAX];
+    TitleNameEntry* entry;
+    bool from_index = false;
+    Result rc = TITLE_NAMES_NO_NAME;
+
+    *out_rc = 0;
+    if (program_id == 0) return false;
+
+    mutexLock(&g_lock);
+    entry = find_entry(program_id);
+    if (entry) {
+        copy_name(out, out_size, entry->name, sizeof(entry->name));
+    } else {
+        g_fetches++;
+    }
+    mutexUnlock(&g_lock);
+    if (entry) return true;
+
+    if (use_ns) {
+        rc = fetch_nacp_name(program_id, name, sizeof(name));
+    }
+    if (R_FAILED(rc)) {
+        from_index = find_in_titledb(program_id, name, sizeof(name));
+    }
+    *out_rc = rc;
+    if (R_FAILED(rc) && !from_index) {
+        return false;
+    }
+
+    mutexLock(&g_lock);
+    if (from_index) {
+        g_index_hits++;
+    }
+    entry = find_entry(program_id);
+    if (!entry) {
+        entry = victim_entry();
+        entry->program_id = program_id;
+    }
+    entry->last_use = ++g_use_clock;
+    copy_name(entry->name, sizeof(entry->name), name, sizeof(name));
+    copy_name(out, out_size, entry->name, sizeof(entry->name));
+    mutexUnlock(&g_lock);
+    save();
+    return true;
+}
+
+void title_names_get_stats(u64* out_hits, u64* out_misses, u64* out_fetches, u64* out_index_hits) {
+    mutexLock(&g_lock);
+    *out_hits = g_hits;
+    *out_misses = g_misses;
+    *out_fetches = g_fetches;
+    *out_index_hits = g_index_hits;
+    mutexUnlock(&g_lock);
+}
@@ -0,0 +1,95 @@
+#include "titledb_index.h"
+
+#include <string.h>
+
+bool titledb_index_open(TitleDbIndex* index, const char* path) {
+    TitleDbIndexHeader* h = &index->header;
+    long size;
+
+    index->file = fopen(path, "rb");
+    if (!index->file) return false;
+
+    if (fread(h, sizeof(*h), 1, index->file) != 1 ||
+        h->magic != TITLEDB_INDEX_MAGIC ||
+        h->version != TITLEDB_INDEX_VERSION ||
+        h->record_size < sizeof(TitleDbIndexRecord) ||
+        h->strings_offset < sizeof(*h) + (u64)h->count * h->record_size ||
+        fseek(index->file, 0, SEEK_END) != 0 ||
+        (size = ftell(index->file)) < 0 ||
+        (u64)size < (u64)h->strings_offset + h->strings_size) {
+        titledb_index_close(index);
+        return false;
+    }
+    return true;
+}
+
+void titledb_index_close(TitleDbIndex* index) {
+    if (index->file) {
+        fclose(index->file);
+        index->file = NULL;
+    }
+}
+
+static bool read_record(TitleDbIndex* index, u32 i, TitleDbIndexRecord* out) {
+    const long offset = (long)(sizeof(TitleDbIndexHeader) + (u64)i * index->header.record_size);
+
+    return fseek(index->file, offset, SEEK_SET) == 0 && fread(out, sizeof(*out), 1, index->file) == 1;
+}
+
+static bool read_string(TitleDbIndex* index, u32 offset, u16 len, char* out, size_t out_size) {
+    // When truncating, one byte past the cut is read too, to see whether the cut splits a
+    // UTF-8 sequence.
+    size_t n = len < out_size ? len : out_size;
+
+    if (out_size == 0) return true;
+    if ((u64)offset + len > index->header.strings_size) {
+        out[0] = '\0';
+        return false;
+    }
+    if (n > 0 &&
+        (fseek(index->file, (long)(index->header.strings_offset + offset), SEEK_SET) != 0 ||
+         fread(out, 1, n, index->file) != n)) {
+        out[0] = '\0';
+        return false;
+    }
+    if (len >= out_size) {
+        n = out_size - 1;
+        while (n > 0 && ((u8)out[n] & 0xC0) == 0x80) {
+            n--;
+        }
+    }
+    out[n] = '\0';
+    return true;
+}
+
+bool titledb_index_find(TitleDbIndex* index, u64 title_id, char* name, size_t name_size, char* icon_url, size_t icon_size) {
+    TitleDbIndexRecord record;
+    u32 lo = 0;
+    u32 hi;
+
+    if (!index->file) return false;
+
+    hi = index->header.count;
+    while (lo < hi) {
+        const u32 mid = lo + (hi - lo) / 2;
+
+        if (!read_record(index, mid, &record)) {
+            return false;
+        }
+        if (record.title_id == title_id) {
+            if (!read_string(index, record.name_offset, record.name_len, name, name_size)) {
+                return false;
+            }
+            if (icon_url && !read_string(index, record.icon_offset, record.icon_len, icon_url, icon_size)) {
+                return false;
+            }
+            return true;
+        }
+        if (record.title_id < title_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,204 @@
+#include "udp_sender.h"
+
+#include "logger.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define UDP_STACK_SIZE (16 * 1024)
+#define UDP_THREAD_PRIO 0x2C
+#define UDP_THREAD_CPUID -2
+#define UDP_KEEPALIVE_MS 5000
+#define UDP_WAIT_SLICE_MS 1000 // bounds how long udp_sender_stop waits for the thread
+
+static u8 g_udp_thread_stack[UDP_STACK_SIZE] __attribute__((aligned(0x1000)));
+
+static u64 ms_since_boot_now(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000ULL;
+}
+
+static u64 frame_read_u64(const u8* p) {
+    u64 value = 0;
+    int i;
+    for (i = 7; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static bool udp_parse_target(const char* target, u32* out_addr, unsigned short* out_port) {
+    char host[64];
+    const char* colon;
+    size_t host_len;
+    struct in_addr addr;
+
+    while (*target == ' ' || *target == '\t') {
+        target++;
+    }
+
+    colon = strchr(target, ':');
+    host_len = colon ? (size_t)(colon - target) : strcspn(target, " \t\r\n");
+    if (host_len == 0 || host_len >= sizeof(host)) {
+        return false;
+    }
+    memcpy(host, target, host_len);
+    host[host_len] = '\0';
+
+    *out_port = UDP_SENDER_DEFAULT_PORT;
+    if (colon) {
+        const unsigned long port = strtoul(colon + 1, NULL, 10);
+        if (port == 0 || port > 65535) {
+            return false;
+        }
+        *out_port = (unsigned short)port;
+    }
+
+    if (strcmp(host, "broadcast") == 0) {
+        *out_addr = htonl(INADDR_BROADCAST);
+        return true;
+    }
+    if (inet_aton(host, &addr) == 0) {
+        return false;
+    }
+    *out_addr = addr.s_addr;
+    return true;
+}
+
+static void udp_send_frame(UdpSender* sender, const u8* frame, size_t frame_len) {
+    struct sockaddr_in dest;
+
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(sender->port);
+    dest.sin_addr.s_addr = sender->target_addr;
+
+    if (sendto(sender->fd, frame, frame_len, 0, (struct sockaddr*)&dest, sizeof(dest)) < 0) {
+        sender->last_errno = errno;
+        if (sender->send_error_count++ == 0) {
+            LOG_WARN(LogSys_Udp, "udp: sendto failed errno=%d", errno);
+        }
+    }
+}
+
+static void udp_sender_thread(void* arg) {
+    UdpSender* sender = (UdpSender*)arg;
+    u8 frame[TELEMETRY_FRAME_MAX];
+    u64 sent_change_seq = 0;
+    u64 last_send_ms = 0;
+
+    while (sender->running) {
+        const bool changed = telemetry_wait_for_change(
+            sender->telemetry,
+            sent_change_seq,
+            UDP_WAIT_SLICE_MS * 1000000ULL
+        );
+        const u64 now_ms = ms_since_boot_now();
+        size_t frame_len;
+
+        if (!sender->running) {
+            break;
+        }
+        if (!changed && last_send_ms != 0 && now_ms - last_send_ms < UDP_KEEPALIVE_MS) {
+            continue;
+        }
+
+        frame_len = telemetry_build_frame(sender->telemetry, frame, sizeof(frame));
+        if (frame_len == 0) {
+            continue;
+        }
+        // change_seq sits at offset 16 of the frame; resume waiting from what was actually sent.
+        sent_change_seq = frame_read_u64(frame + 16);
+
+        udp_send_frame(sender, frame, frame_len);
+        if (changed) {
+            sender->change_count++;
+        } else {
+            sender->keepalive_count++;
+        }
+        last_send_ms = now_ms;
+    }
+}
+
+bool udp_sender_start(UdpSender* sender, TelemetryState* telemetry, const char* target) {
+    const int enable = 1;
+    Result rc;
+
+    memset(sender, 0, sizeof(*sender));
+    sender->telemetry = telemetry;
+    sender->fd = -1;
+
+    if (!udp_parse_target(target, &sender->target_addr, &sender->port)) {
+        LOG_ERROR(LogSys_Udp, "udp: invalid target '%s'", target);
+        return false;
+    }
+
+    sender->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sender->fd < 0) {
+        sender->last_errno = errno;
+        LOG_ERROR(LogSys_Udp, "udp: socket failed errno=%d", errno);
+        return false;
+    }
+    // Without the netmask a subnet broadcast such as 192.168.1.255 looks like any unicast
+    // address, and sending to it fails with EACCES unless SO_BROADCAST is set. The option
+    // changes nothing for unicast, so it is always set.
+    if (setsockopt(sender->fd, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable)) < 0) {
+        sender->last_errno = errno;
+        if (sender->target_addr == htonl(INADDR_BROADCAST)) {
+            LOG_ERROR(LogSys_Udp, "udp: SO_BROADCAST failed errno=%d", errno);
+            close(sender->fd);
+            sender->fd = -1;
+            return false;
+        }
+        LOG_WARN(LogSys_Udp, "udp: SO_BROADCAST failed errno=%d, only unicast will work", errno);
+    }
+
+    sender->running = true;
+    rc = threadCreate(
+        &sender->thread,
+        udp_sender_thread,
+        sender,
+        g_udp_thread_stack,
+        UDP_STACK_SIZE,
+        UDP_THREAD_PRIO,
+        UDP_THREAD_CPUID
+    );
+    if (R_FAILED(rc)) {
+        LOG_ERROR(LogSys_Udp, "udp: threadCreate failed rc=0x%08lX", (unsigned long)rc);
+        sender->running = false;
+        close(sender->fd);
+        sender->fd = -1;
+        return false;
+    }
+
+    rc = threadStart(&sender->thread);
+    if (R_FAILED(rc)) {
+        LOG_ERROR(LogSys_Udp, "udp: threadStart failed rc=0x%08lX", (unsigned long)rc);
+        threadClose(&sender->thread);
+        sender->running = false;
+        close(sender->fd);
+        sender->fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+void udp_sender_stop(UdpSender* sender) {
+    if (!sender->running) {
+        return;
+    }
+
+    sender->running = false;
+    threadWaitForExit(&sender->thread);
+    threadClose(&sender->thread);
+    if (sender->fd >= 0) {
+        close(sender->fd);
+        sender->fd = -1;
+    }
+}
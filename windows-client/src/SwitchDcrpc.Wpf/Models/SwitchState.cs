@@ -1,3 +1,5 @@
+using System.Buffers.Binary;
+using System.Text;
 using System.Text.Json.Serialization;
 
 namespace SwitchDcrpc.Wpf.Models;
@@ -19,6 +21,18 @@ public sealed class SwitchState
     [JsonPropertyName("last_update_sec")]
     public ulong LastUpdateSec { get; set; }
 
+    [JsonPropertyName("seq")]
+    public ulong? Seq { get; set; }
+
+    [JsonPropertyName("change_seq")]
+    public ulong? ChangeSeq { get; set; }
+
+    [JsonPropertyName("identity_seq")]
+    public ulong? IdentitySeq { get; set; }
+
+    [JsonPropertyName("power_seq")]
+    public ulong? PowerSeq { get; set; }
+
     [JsonPropertyName("battery_percent")]
     public int? BatteryPercent { get; set; }
 
@@ -27,4 +41,83 @@ public sealed class SwitchState
 
     [JsonPropertyName("is_docked")]
     public bool? IsDocked { get; set; }
+
+    private const uint FrameMagic = 0x53584E52; // "RNXS"
+    private const ushort FrameSchemaId = 1;
+    private const int FrameFixedSize = 84;
+
+    // Decodes a /state.bin frame (layout documented in include/telemetry.h); null if it is not schema 1.
+    public static SwitchState? FromFrame(ReadOnlySpan<byte> frame)
+    {
+        if (frame.Length < FrameFixedSize + 2 ||
+            BinaryPrimitives.ReadUInt32LittleEndian(frame) != FrameMagic ||
+            BinaryPrimitives.ReadUInt16LittleEndian(frame[4..]) != FrameSchemaId ||
+            BinaryPrimitives.ReadUInt16LittleEndian(frame[6..]) > frame.Length)
+        {
+            return null;
+        }
+
+        var battery = frame[48];
+        var flags = frame[49];
+        var offset = FrameFixedSize;
+        var firmware = ReadString(frame, ref offset);
+        var activeGame = ReadString(frame, ref offset);
+        if (firmware is null || activeGame is null)
+        {
+            return null;
+        }
+
+        return new SwitchState
+        {
+            Seq = BinaryPrimitives.ReadUInt64LittleEndian(frame[8..]),
+            ChangeSeq = BinaryPrimitives.ReadUInt64LittleEndian(frame[16..]),
+            StartedSec = BinaryPrimitives.ReadUInt64LittleEndian(frame[24..]),
+            LastUpdateSec = BinaryPrimitives.ReadUInt64LittleEndian(frame[32..]),
+            ActiveProgramId = $"0x{BinaryPrimitives.ReadUInt64LittleEndian(frame[40..]):X16}",
+            BatteryPercent = (flags & 0x01) != 0 && battery != 0xFF ? battery : null,
+            IsCharging = (flags & 0x02) != 0 ? (flags & 0x04) != 0 : null,
+            IsDocked = (flags & 0x08) != 0 ? (flags & 0x10) != 0 : null,
+            Firmware = firmware,
+            ActiveGame = activeGame
+        };
+    }
+
+    private static string? ReadString(ReadOnlySpan<byte> frame, ref int offset)
+    {
+        if (offset >= frame.Length || offset + 1 + frame[offset] > frame.Length)
+        {
+            return null;
+        }
+
+        var length = frame[offset];
+        var text = Encoding.UTF8.GetString(frame.Slice(offset + 1, length));
+        offset += 1 + length;
+        return text;
+    }
+
+    // /state?since=N omits groups unchanged since N; fill them from the previous full view.
+    public SwitchState MergeUnchangedGroups(SwitchState previous, ulong since)
+    {
+        var sameRun = Seq is not null && Seq >= since && StartedSec == previous.StartedSec;
+        if (!sameRun)
+        {
+            return this;
+        }
+
+        if (IdentitySeq is not null && IdentitySeq <= since)
+        {
+            Firmware = previous.Firmware;
+            ActiveProgramId = previous.ActiveProgramId;
+            ActiveGame = previous.ActiveGame;
+        }
+
+        if (PowerSeq is not null && PowerSeq <= since)
+        {
+            BatteryPercent = previous.BatteryPercent;
+            IsCharging = previous.IsCharging;
+            IsDocked = previous.IsDocked;
+        }
+
+        return this;
+    }
 }
@@ -1,3 +1,4 @@
+using System.Net;
 using System.Net.Http;
 using System.Net.Http.Json;
 using SwitchDcrpc.Wpf.Models;
@@ -7,21 +8,57 @@ namespace SwitchDcrpc.Wpf.Services;
 public sealed class SwitchStateClient
 {
     private readonly HttpClient _httpClient;
+    private readonly int _timeoutMs;
+    private bool _binaryUnsupported;
 
     public SwitchStateClient(int timeoutMs)
     {
+        _timeoutMs = timeoutMs;
         _httpClient = new HttpClient
         {
-            Timeout = TimeSpan.FromMilliseconds(timeoutMs)
+            // Per-request timeouts below, so long-polls can outlive the base timeout.
+            Timeout = Timeout.InfiniteTimeSpan
         };
     }
 
-    public async Task<SwitchState?> FetchStateAsync(string switchIp, int port, CancellationToken cancellationToken)
+    public Task<SwitchState?> FetchStateAsync(string switchIp, int port, CancellationToken cancellationToken)
+    {
+        return FetchStateAsync(switchIp, port, null, 0, cancellationToken);
+    }
+
+    public async Task<SwitchState?> FetchStateAsync(
+        string switchIp,
+        int port,
+        ulong? sinceChangeSeq,
+        int waitMs,
+        CancellationToken cancellationToken)
     {
         try
         {
-            var url = new Uri($"http://{switchIp}:{port}/state");
-            return await _httpClient.GetFromJsonAsync<SwitchState>(url, cancellationToken);
+            var query = sinceChangeSeq is null ? string.Empty : $"?since={sinceChangeSeq.Value}&wait={waitMs}";
+
+            using var timeoutCts = CancellationTokenSource.CreateLinkedTokenSource(cancellationToken);
+            timeoutCts.CancelAfter(_timeoutMs + (sinceChangeSeq is null ? 0 : waitMs));
+
+            // The packed frame is a full snapshot, so no delta merge is needed.
+            // Older sysmodules answer /state.bin with JSON (prefix match) or 404; fall back to JSON for good.
+            if (!_binaryUnsupported)
+            {
+                var binaryUrl = new Uri($"http://{switchIp}:{port}/state.bin{query}");
+                using var response = await _httpClient.GetAsync(binaryUrl, timeoutCts.Token);
+                if (response.StatusCode != HttpStatusCode.NotFound &&
+                    response.Content.Headers.ContentType?.MediaType != "application/json")
+                {
+                    response.EnsureSuccessStatusCode();
+                    var frame = await response.Content.ReadAsByteArrayAsync(timeoutCts.Token);
+                    return SwitchState.FromFrame(frame);
+                }
+
+                _binaryUnsupported = true;
+            }
+
+            var url = new Uri($"http://{switchIp}:{port}/state{query}");
+            return await _httpClient.GetFromJsonAsync<SwitchState>(url, timeoutCts.Token);
         }
         catch
         {
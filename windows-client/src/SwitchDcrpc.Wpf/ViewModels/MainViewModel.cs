@@ -19,6 +19,7 @@ public sealed class MainViewModel : ObservableObject
     private const string GithubRepoUrl = "https://github.com/Cracky0001/RichNX";
     private const string GithubButtonLabel = "Download from GitHub";
     private static readonly TimeSpan StateUnreachableClearDelay = TimeSpan.FromSeconds(10);
+    private const int StateLongPollWaitMs = 25000;
     private string _switchIp = DefaultSwitchIp;
     private string _port = DefaultPort;
     private string _discordAppId = HardcodedDiscordAppId;
@@ -221,6 +222,8 @@ public sealed class MainViewModel : ObservableObject
         _presenceSessionKey = null;
         _presenceSessionStartUnix = 0;
         _titlesTask = _titles.LoadAsync(_cts.Token);
+        ulong? lastChangeSeq = null;
+        SwitchState? lastState = null;
 
         Ui(() =>
         {
@@ -255,9 +258,17 @@ public sealed class MainViewModel : ObservableObject
                 {
                     await _discord.EnsureConnectedAsync(_cts.Token);
 
-                    var state = await stateClient.FetchStateAsync(SwitchIp.Trim(), port, _cts.Token);
+                    var state = await stateClient.FetchStateAsync(
+                        SwitchIp.Trim(),
+                        port,
+                        lastChangeSeq,
+                        StateLongPollWaitMs,
+                        _cts.Token
+                    );
                     if (state is null)
                 {
+                    lastChangeSeq = null;
+                    lastState = null;
                     var nowUtc = DateTimeOffset.UtcNow;
                     _stateUnreachableSinceUtc ??= nowUtc;
                     var unreachableFor = nowUtc - _stateUnreachableSinceUtc.Value;
@@ -288,6 +299,20 @@ public sealed class MainViewModel : ObservableObject
                     _stateUnreachableSinceUtc = null;
                     _rpcClearedWhileUnreachable = false;
 
+                    if (lastChangeSeq is not null && lastState is not null)
+                    {
+                        if (state.StartedSec != lastState.StartedSec)
+                        {
+                            // Sysmodule restarted: the delta is relative to a foreign seq, refetch in full.
+                            lastChangeSeq = null;
+                            lastState = null;
+                            continue;
+                        }
+
+                        state = state.MergeUnchangedGroups(lastState, lastChangeSeq.Value);
+                    }
+                    lastState = state;
+
                     var resolved = await ResolveGameAsync(state, _cts.Token);
                     Ui(() =>
                     {
@@ -304,7 +329,12 @@ public sealed class MainViewModel : ObservableObject
                     Ui(() => AppendLog($"RPC -> {activity.Details} | {activity.State}"));
                 }
 
-                await Task.Delay(pollMs, _cts.Token);
+                // Sysmodules exposing change_seq park /state until something changes; older ones are polled.
+                lastChangeSeq = state.ChangeSeq;
+                if (lastChangeSeq is null)
+                {
+                    await Task.Delay(pollMs, _cts.Token);
+                }
             }
         }
         catch (OperationCanceledException)